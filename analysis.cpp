@@ -0,0 +1,353 @@
+#include "analysis.hpp"
+#include "constantfolding.hpp"
+
+#include <typeinfo>
+
+MethodScope::MethodScope(ClassTable* classTable, std::string className, std::string methodName)
+  : classTable(classTable), className(className), methodName(methodName) {
+  method = classTable->find(className)->second.methods->find(methodName)->second;
+}
+
+bool MethodScope::isLocal(std::string name) {
+  return method.variables->find(name) != method.variables->end();
+}
+
+CompoundType MethodScope::typeOf(std::string name) {
+  if (isLocal(name))
+    return method.variables->find(name)->second.type;
+  VariableInfo info;
+  findMember(classTable, className, name, &info, NULL, NULL);
+  return info.type;
+}
+
+int MethodScope::memberOffset(std::string objectClass, std::string member) {
+  int offset = 0;
+  findMember(classTable, objectClass, member, NULL, NULL, &offset);
+  return offset & ~3;
+}
+
+int MethodScope::memberOffset(std::string member) {
+  return memberOffset(className, member);
+}
+
+std::string MethodScope::callTarget(MethodCallNode* node) {
+  std::string objectClass = className;
+  std::string name = node->identifier_1->name;
+  if (node->identifier_2) {
+    objectClass = typeOf(node->identifier_1->name).objectClassName;
+    name = node->identifier_2->name;
+  }
+  std::string declaringClass;
+  findMethod(classTable, objectClass, name, NULL, &declaringClass);
+  return declaringClass + "_" + name;
+}
+
+void MethodScope::addLocal(std::string name, CompoundType type) {
+  MethodInfo& info = classTable->find(className)->second.methods->find(methodName)->second;
+  VariableInfo variable;
+  variable.type = type;
+  variable.size = 4;
+  variable.offset = -(info.localsSize + 4);
+  info.localsSize += 4;
+  (*info.variables)[name] = variable;
+  method.localsSize = info.localsSize;
+}
+
+std::vector<ExpressionNode**> children(ExpressionNode* node) {
+  std::vector<ExpressionNode**> slots;
+  std::list<ExpressionNode*>* list = NULL;
+  if (PlusNode* n = dynamic_cast<PlusNode*>(node)) {
+    slots.push_back(&n->expression_1);
+    slots.push_back(&n->expression_2);
+  } else if (MinusNode* n = dynamic_cast<MinusNode*>(node)) {
+    slots.push_back(&n->expression_1);
+    slots.push_back(&n->expression_2);
+  } else if (TimesNode* n = dynamic_cast<TimesNode*>(node)) {
+    slots.push_back(&n->expression_1);
+    slots.push_back(&n->expression_2);
+  } else if (DivideNode* n = dynamic_cast<DivideNode*>(node)) {
+    slots.push_back(&n->expression_1);
+    slots.push_back(&n->expression_2);
+  } else if (GreaterNode* n = dynamic_cast<GreaterNode*>(node)) {
+    slots.push_back(&n->expression_1);
+    slots.push_back(&n->expression_2);
+  } else if (GreaterEqualNode* n = dynamic_cast<GreaterEqualNode*>(node)) {
+    slots.push_back(&n->expression_1);
+    slots.push_back(&n->expression_2);
+  } else if (EqualNode* n = dynamic_cast<EqualNode*>(node)) {
+    slots.push_back(&n->expression_1);
+    slots.push_back(&n->expression_2);
+  } else if (AndNode* n = dynamic_cast<AndNode*>(node)) {
+    slots.push_back(&n->expression_1);
+    slots.push_back(&n->expression_2);
+  } else if (OrNode* n = dynamic_cast<OrNode*>(node)) {
+    slots.push_back(&n->expression_1);
+    slots.push_back(&n->expression_2);
+  } else if (NotNode* n = dynamic_cast<NotNode*>(node)) {
+    slots.push_back(&n->expression);
+  } else if (NegationNode* n = dynamic_cast<NegationNode*>(node)) {
+    slots.push_back(&n->expression);
+  } else if (MethodCallNode* n = dynamic_cast<MethodCallNode*>(node)) {
+    list = n->expression_list;
+  } else if (NewNode* n = dynamic_cast<NewNode*>(node)) {
+    list = n->expression_list;
+  } else if (SpawnNode* n = dynamic_cast<SpawnNode*>(node)) {
+    list = n->methodcall->expression_list;
+  } else if (JoinNode* n = dynamic_cast<JoinNode*>(node)) {
+    slots.push_back(&n->expression);
+  }
+  if (list) {
+    for (std::list<ExpressionNode*>::iterator it = list->begin(); it != list->end(); it++)
+      slots.push_back(&*it);
+  }
+  return slots;
+}
+
+// Replaces a variable with the expression it was defined as, if it
+// is one of the given definitions
+static ExpressionNode* expand(ExpressionNode* node, std::map<std::string, ExpressionNode*>* definitions) {
+  while (VariableNode* n = dynamic_cast<VariableNode*>(node)) {
+    std::map<std::string, ExpressionNode*>::iterator definition = definitions->find(n->identifier->name);
+    if (definition == definitions->end())
+      break;
+    node = definition->second;
+  }
+  return node;
+}
+
+bool sameExpression(ExpressionNode* a, ExpressionNode* b, std::map<std::string, ExpressionNode*>* definitions) {
+  if (definitions) {
+    a = expand(a, definitions);
+    b = expand(b, definitions);
+  }
+  if (typeid(*a) != typeid(*b))
+    return false;
+
+  if (VariableNode* n = dynamic_cast<VariableNode*>(a))
+    return n->identifier->name == ((VariableNode*)b)->identifier->name;
+  if (IntegerLiteralNode* n = dynamic_cast<IntegerLiteralNode*>(a))
+    return n->integer->value == ((IntegerLiteralNode*)b)->integer->value;
+  if (BooleanLiteralNode* n = dynamic_cast<BooleanLiteralNode*>(a))
+    return n->integer->value == ((BooleanLiteralNode*)b)->integer->value;
+  if (MemberAccessNode* n = dynamic_cast<MemberAccessNode*>(a)) {
+    MemberAccessNode* m = (MemberAccessNode*)b;
+    return n->identifier_1->name == m->identifier_1->name && n->identifier_2->name == m->identifier_2->name;
+  }
+  if (MethodCallNode* n = dynamic_cast<MethodCallNode*>(a)) {
+    MethodCallNode* m = (MethodCallNode*)b;
+    if (n->identifier_1->name != m->identifier_1->name || !n->identifier_2 != !m->identifier_2)
+      return false;
+    if (n->identifier_2 && n->identifier_2->name != m->identifier_2->name)
+      return false;
+  }
+  // Every "new" makes a different object, every spawn a different
+  // task, and a task is joined once
+  if (dynamic_cast<NewNode*>(a) || dynamic_cast<SpawnNode*>(a) || dynamic_cast<JoinNode*>(a))
+    return false;
+
+  std::vector<ExpressionNode**> x = children(a);
+  std::vector<ExpressionNode**> y = children(b);
+  if (x.size() != y.size())
+    return false;
+  for (unsigned i = 0; i < x.size(); i++) {
+    if (!sameExpression(*x[i], *y[i], definitions))
+      return false;
+  }
+  return true;
+}
+
+bool canTrap(ExpressionNode* node) {
+  if (DivideNode* n = dynamic_cast<DivideNode*>(node)) {
+    int divisor;
+    if (!isLiteral(n->expression_2, &divisor) || divisor == 0 || divisor == -1)
+      return true;
+  }
+  // The object may not have been assigned yet, and a call may trap
+  // or not return (as may the task a join waits for)
+  if (dynamic_cast<MemberAccessNode*>(node) || dynamic_cast<MethodCallNode*>(node) ||
+      dynamic_cast<SpawnNode*>(node) || dynamic_cast<JoinNode*>(node))
+    return true;
+
+  std::vector<ExpressionNode**> slots = children(node);
+  for (std::vector<ExpressionNode**>::iterator it = slots.begin(); it != slots.end(); it++) {
+    if (canTrap(**it))
+      return true;
+  }
+  return false;
+}
+
+ExpressionNode* variable(std::string name, CompoundType type) {
+  VariableNode* node = new VariableNode(new IdentifierNode(name));
+  node->basetype = type.baseType;
+  node->objectClassName = type.objectClassName;
+  return node;
+}
+
+ExpressionNode* integerLiteral(int value) {
+  IntegerLiteralNode* node = new IntegerLiteralNode(new IntegerNode(value));
+  node->basetype = bt_integer;
+  return node;
+}
+
+StatementNode* assignment(std::string name, ExpressionNode* expression) {
+  AssignmentNode* node = new AssignmentNode(new IdentifierNode(name), NULL, expression);
+  node->basetype = expression->basetype;
+  node->objectClassName = expression->objectClassName;
+  return node;
+}
+
+bool isPure(Effects& effects) {
+  return effects.writes.empty() && !effects.prints && !effects.allocates;
+}
+
+// Effects are first collected for each method body alone, then the
+// effects of callees are added in until nothing changes, so that
+// recursive methods are handled.
+EffectsTable computeEffects(ProgramNode* program, ClassTable* classTable) {
+  EffectsTable table;
+  std::map<std::string, std::set<std::string> > callees;
+
+  for (std::list<ClassNode*>::iterator c = program->class_list->begin(); c != program->class_list->end(); c++) {
+    std::string className = (*c)->identifier_1->name;
+    for (std::list<MethodNode*>::iterator m = (*c)->method_list->begin(); m != (*c)->method_list->end(); m++) {
+      MethodScope scope(classTable, className, (*m)->identifier->name);
+      EffectsCollector collector(&scope, NULL);
+      (*m)->methodbody->accept(&collector);
+      std::string label = className + "_" + (*m)->identifier->name;
+      table[label] = collector.effects;
+      callees[label] = collector.callees;
+      callees[JOINED_TASKS].insert(collector.spawned.begin(), collector.spawned.end());
+    }
+  }
+  table[JOINED_TASKS] = EffectsCollector(NULL, NULL).effects;
+
+  bool changed = true;
+  while (changed) {
+    changed = false;
+    for (EffectsTable::iterator it = table.begin(); it != table.end(); it++) {
+      Effects& effects = it->second;
+      std::set<std::string>& calls = callees[it->first];
+      for (std::set<std::string>::iterator callee = calls.begin(); callee != calls.end(); callee++) {
+        Effects& other = table[*callee];
+        unsigned writes = effects.writes.size();
+        effects.writes.insert(other.writes.begin(), other.writes.end());
+        if (effects.writes.size() != writes ||
+            (other.readsMemory && !effects.readsMemory) ||
+            (other.prints && !effects.prints) ||
+            (other.allocates && !effects.allocates)) {
+          effects.readsMemory |= other.readsMemory;
+          effects.prints |= other.prints;
+          effects.allocates |= other.allocates;
+          changed = true;
+        }
+      }
+    }
+  }
+  return table;
+}
+
+// EffectsCollector Visitor Functions
+
+EffectsCollector::EffectsCollector(MethodScope* scope, EffectsTable* table)
+  : scope(scope), table(table) {
+  effects.readsMemory = false;
+  effects.prints = false;
+  effects.allocates = false;
+}
+
+void EffectsCollector::collect(std::list<StatementNode*>* statements) {
+  visitStatements(statements);
+}
+
+void EffectsCollector::collect(ExpressionNode* expression) {
+  rewrite(expression);
+}
+
+void EffectsCollector::visitAssignmentNode(AssignmentNode* node) {
+  ExpressionRewriter::visitAssignmentNode(node);
+  std::string name = node->identifier_1->name;
+  if (node->identifier_2) {
+    if (!scope->isLocal(name))
+      effects.readsMemory = true;
+    effects.writes.insert(scope->memberOffset(scope->typeOf(name).objectClassName, node->identifier_2->name));
+  } else if (scope->isLocal(name)) {
+    assignedLocals.insert(name);
+  } else {
+    effects.writes.insert(scope->memberOffset(name));
+  }
+}
+
+void EffectsCollector::visitCallNode(CallNode* node) {
+  node->methodcall->accept(this);
+}
+
+void EffectsCollector::visitPrintNode(PrintNode* node) {
+  ExpressionRewriter::visitPrintNode(node);
+  effects.prints = true;
+}
+
+void EffectsCollector::visitMethodCallNode(MethodCallNode* node) {
+  ExpressionRewriter::visitMethodCallNode(node);
+  if (node->identifier_2 && !scope->isLocal(node->identifier_1->name))
+    effects.readsMemory = true;
+
+  std::string target = scope->callTarget(node);
+  callees.insert(target);
+  if (table) {
+    Effects& callee = (*table)[target];
+    effects.writes.insert(callee.writes.begin(), callee.writes.end());
+    effects.readsMemory |= callee.readsMemory;
+    effects.prints |= callee.prints;
+    effects.allocates |= callee.allocates;
+  }
+}
+
+void EffectsCollector::visitMemberAccessNode(MemberAccessNode* node) {
+  ExpressionRewriter::visitMemberAccessNode(node);
+  effects.readsMemory = true;
+}
+
+void EffectsCollector::visitVariableNode(VariableNode* node) {
+  ExpressionRewriter::visitVariableNode(node);
+  if (!scope->isLocal(node->identifier->name))
+    effects.readsMemory = true;
+}
+
+void EffectsCollector::visitNewNode(NewNode* node) {
+  ExpressionRewriter::visitNewNode(node);
+  effects.allocates = true;
+
+  std::string className = node->identifier->name;
+  std::string declaringClass;
+  if (findMethod(scope->classTable, className, className, NULL, &declaringClass)) {
+    std::string target = declaringClass + "_" + className;
+    callees.insert(target);
+    if (table) {
+      Effects& callee = (*table)[target];
+      effects.writes.insert(callee.writes.begin(), callee.writes.end());
+      effects.readsMemory |= callee.readsMemory;
+      effects.prints |= callee.prints;
+    }
+  }
+}
+
+// A task is allocated, so a spawn is never pure, and its call is
+// collected as any other
+void EffectsCollector::visitSpawnNode(SpawnNode* node) {
+  ExpressionRewriter::visitSpawnNode(node);
+  effects.allocates = true;
+  spawned.insert(scope->callTarget(node->methodcall));
+}
+
+// A join frees its task, so it is never pure either
+void EffectsCollector::visitJoinNode(JoinNode* node) {
+  ExpressionRewriter::visitJoinNode(node);
+  effects.allocates = true;
+  callees.insert(JOINED_TASKS);
+  if (table) {
+    Effects& joined = (*table)[JOINED_TASKS];
+    effects.writes.insert(joined.writes.begin(), joined.writes.end());
+    effects.readsMemory |= joined.readsMemory;
+    effects.prints |= joined.prints;
+  }
+}
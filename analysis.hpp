@@ -0,0 +1,126 @@
+#ifndef __ANALYSIS_HPP
+#define __ANALYSIS_HPP
+
+#include "ast.hpp"
+#include "typecheck.hpp"
+#include "passmanager.hpp"
+
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+// This file has helpers shared by the optimization passes: name
+// resolution inside a method, access to the children of any
+// expression, and a summary of what code reads and writes.
+
+// Resolves the names used in the body of one method.
+class MethodScope {
+public:
+  ClassTable* classTable;
+  std::string className;
+  std::string methodName;
+  MethodInfo method;
+
+  MethodScope() : classTable(NULL) {}
+  MethodScope(ClassTable* classTable, std::string className, std::string methodName);
+
+  // True if a name is a parameter or local of the method; any
+  // other name is a member of "this"
+  bool isLocal(std::string name);
+  CompoundType typeOf(std::string name);
+
+  // The offset of the word holding a member in an object of the
+  // given class (booleans packed by --pack-objects share a word, so
+  // they are the same memory to the passes)
+  int memberOffset(std::string objectClass, std::string member);
+  // The offset of a member of "this"
+  int memberOffset(std::string member);
+
+  // The label (DeclaringClass_method) that a call jumps to
+  std::string callTarget(MethodCallNode* node);
+
+  // Adds a new local variable to the method (and to the class
+  // table), growing the frame by one word
+  void addLocal(std::string name, CompoundType type);
+};
+
+// Returns pointers to the slots holding the expression children of
+// a node (operands, call arguments), so they can be replaced.
+std::vector<ExpressionNode**> children(ExpressionNode* node);
+
+// True if two expressions are the same tree: the same operators,
+// literals and variable names. Variables that are keys of the
+// definitions map (if given) stand for the expression they map to.
+bool sameExpression(ExpressionNode* a, ExpressionNode* b,
+                    std::map<std::string, ExpressionNode*>* definitions = NULL);
+
+// True if evaluating an expression may trap or not terminate:
+// division by a value that may be 0 (or -1, for INT_MIN / -1),
+// member access through a variable (which may not have been
+// assigned yet), calls, spawns and joins.
+bool canTrap(ExpressionNode* node);
+
+// Makes new typed nodes, for passes that build code.
+ExpressionNode* variable(std::string name, CompoundType type);
+ExpressionNode* integerLiteral(int value);
+StatementNode* assignment(std::string name, ExpressionNode* expression);
+
+// Defines what a piece of code (or a method, including everything
+// it calls) may do. Memory is tracked by member offset rather than
+// by name, since the type checker lets an object variable hold an
+// object of any class, so members of different classes at the same
+// offset may be the same memory.
+typedef struct effects {
+  std::set<int> writes;
+  bool readsMemory;
+  bool prints;
+  bool allocates;
+} Effects;
+
+// A method is pure if calling it can only compute its result: it
+// stores nothing, prints nothing and allocates nothing.
+bool isPure(Effects& effects);
+
+// Effects of every method, by label. A spawned call may run at any
+// time until its task is joined, and what it did is only known to
+// have happened after the join, so a join is taken as a call to
+// JOINED_TASKS, which has the effects of every method that is spawned.
+#define JOINED_TASKS "<joined tasks>"
+typedef std::map<std::string, Effects> EffectsTable;
+EffectsTable computeEffects(ProgramNode* program, ClassTable* classTable);
+
+// This visitor collects what a list of statements (or an
+// expression) does. Calls add in the effects of the callee, if an
+// effects table is given.
+class EffectsCollector : public ExpressionRewriter {
+private:
+  MethodScope* scope;
+  EffectsTable* table;
+
+public:
+  Effects effects;
+  // Locals and parameters that are assigned
+  std::set<std::string> assignedLocals;
+  // Labels of every method called (constructors included), and
+  // of those spawned
+  std::set<std::string> callees;
+  std::set<std::string> spawned;
+
+  EffectsCollector(MethodScope* scope, EffectsTable* table);
+
+  void collect(std::list<StatementNode*>* statements);
+  void collect(ExpressionNode* expression);
+
+  virtual void visitAssignmentNode(AssignmentNode* node);
+  virtual void visitCallNode(CallNode* node);
+  virtual void visitPrintNode(PrintNode* node);
+  virtual void visitMethodCallNode(MethodCallNode* node);
+  virtual void visitMemberAccessNode(MemberAccessNode* node);
+  virtual void visitVariableNode(VariableNode* node);
+  virtual void visitNewNode(NewNode* node);
+  virtual void visitSpawnNode(SpawnNode* node);
+  virtual void visitJoinNode(JoinNode* node);
+};
+
+#endif
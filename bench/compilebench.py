@@ -0,0 +1,158 @@
+import argparse
+import json
+import os
+import tempfile
+import time
+from subprocess import Popen, PIPE
+
+import genprog
+
+# Measures how fast ./lang compiles the synthetic programs made by
+# genprog.py. Each workload is compiled several times with --stats=json
+# and the fastest run is kept. Throughput is reported in source lines
+# per second for every phase, and each run of the benchmark is appended
+# to a history file tagged with the current git commit so results can
+# be compared across commits.
+
+# (shape, size) pairs that make up the default suite
+workloads = [
+    ("deep", 1000),
+    ("wide", 2000),
+    ("long", 20000),
+    ("nest", 1000),
+    ("calls", 20000),
+    ("mixed", 5000),
+]
+
+benchdir = os.path.dirname(os.path.abspath(__file__))
+historyfile = os.path.join(benchdir, "history.jsonl")
+
+def gitCommit():
+    p = Popen(["git", "rev-parse", "--short", "HEAD"], stdout=PIPE, stderr=PIPE)
+    (out, err) = p.communicate()
+    if (p.returncode != 0):
+        return "unknown"
+    commit = out.decode("utf-8").strip()
+    p = Popen(["git", "status", "--porcelain", "--untracked-files=no"], stdout=PIPE, stderr=PIPE)
+    (out, err) = p.communicate()
+    if (out.strip()):
+        commit = commit + "-dirty"
+    return commit
+
+def compileOnce(lang, source):
+    with open(source, "r") as infile:
+        start = time.time()
+        p = Popen([lang, "--stats=json"], stdin=infile, stdout=PIPE, stderr=PIPE)
+        (out, err) = p.communicate()
+        total = time.time() - start
+    if (p.returncode != 0):
+        return None
+    # Any diagnostics come before the JSON report on stderr
+    text = err.decode("utf-8")
+    report = json.loads(text[text.index("{"):])
+    report["total_ms"] = total * 1000
+    return report
+
+def runWorkload(lang, shape, size, repeat, tmpdir):
+    source = os.path.join(tmpdir, shape + "_" + str(size) + ".lang")
+    with open(source, "w") as out:
+        genprog.generate(shape, size, out)
+    with open(source, "r") as infile:
+        lines = sum(1 for line in infile)
+
+    best = None
+    for i in range(repeat):
+        report = compileOnce(lang, source)
+        if (report is None):
+            return None
+        if (best is None or report["total_ms"] < best["total_ms"]):
+            best = report
+
+    result = {"shape": shape, "size": size, "lines": lines, "total_ms": round(best["total_ms"], 3), "phases": {}}
+    for phase in best["phases"]:
+        ms = phase["ms"]
+        result["phases"][phase["name"]] = {
+            "ms": ms,
+            "lines_per_sec": round(lines / (ms / 1000.0)) if ms > 0 else None,
+            "peak_rss_kb": phase["peak_rss_kb"],
+        }
+    result["counters"] = best["counters"]
+    return result
+
+def lastRecord():
+    if (not os.path.isfile(historyfile)):
+        return None
+    last = None
+    with open(historyfile, "r") as history:
+        for line in history:
+            if (line.strip()):
+                last = json.loads(line)
+    return last
+
+def printResults(results, previous, threshold):
+    oldresults = {}
+    if (previous):
+        for r in previous["results"]:
+            oldresults[(r["shape"], r["size"])] = r
+
+    regressions = []
+    print("%-14s %8s  %-10s %10s %14s %10s" % ("workload", "lines", "phase", "ms", "lines/sec", "change"))
+    for r in results:
+        name = r["shape"] + "/" + str(r["size"])
+        old = oldresults.get((r["shape"], r["size"]))
+        for phase, data in r["phases"].items():
+            change = ""
+            if (old and phase in old["phases"] and old["phases"][phase]["ms"] > 0):
+                delta = (data["ms"] - old["phases"][phase]["ms"]) / old["phases"][phase]["ms"] * 100
+                change = "%+.1f%%" % delta
+                # Ignore noise on phases too short to time reliably
+                if (delta > threshold and data["ms"] > 1.0):
+                    regressions.append((name, phase, delta))
+            lps = data["lines_per_sec"] if data["lines_per_sec"] is not None else 0
+            print("%-14s %8d  %-10s %10.3f %14d %10s" % (name, r["lines"], phase, data["ms"], lps, change))
+    if (previous):
+        print("\nCompared against " + previous["commit"] + " (" + previous["date"] + ")")
+    if (regressions):
+        print("\nRegressions over " + str(threshold) + "%:")
+        for name, phase, delta in regressions:
+            print("  %s %s %+.1f%%" % (name, phase, delta))
+    return regressions
+
+def main():
+    parser = argparse.ArgumentParser(description="Benchmark compiler throughput on synthetic programs.")
+    parser.add_argument("--lang", metavar="path", type=str, default="./lang", help="Compiler to benchmark")
+    parser.add_argument("-r", metavar="repeat", type=int, default=5, help="Runs per workload (fastest is kept)")
+    parser.add_argument("-s", metavar="scale", type=float, default=1.0, help="Multiply all workload sizes by this factor")
+    parser.add_argument("-t", metavar="percent", type=float, default=10.0, help="Slowdown that counts as a regression")
+    parser.add_argument("--no-record", action="store_true", help="Do not append the results to the history file")
+    args = parser.parse_args()
+
+    if (not os.path.isfile(args.lang)):
+        print("No `lang` executable.")
+        exit(1)
+
+    results = []
+    with tempfile.TemporaryDirectory() as tmpdir:
+        for shape, size in workloads:
+            size = max(1, int(size * args.s))
+            result = runWorkload(args.lang, shape, size, args.r, tmpdir)
+            if (result is None):
+                print(shape + "/" + str(size) + ": compilation failed.")
+                continue
+            results.append(result)
+
+    record = {"commit": gitCommit(), "date": time.strftime("%Y-%m-%d %H:%M:%S"), "scale": args.s, "results": results}
+    previous = lastRecord()
+    if (previous and previous.get("scale") != args.s):
+        previous = None
+    regressions = printResults(results, previous, args.t)
+
+    if (not args.no_record):
+        with open(historyfile, "a") as history:
+            history.write(json.dumps(record) + "\n")
+
+    if (regressions):
+        exit(1)
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,220 @@
+import argparse
+import random
+from sys import stdout
+
+# Generates synthetic programs that stress a particular part of the
+# compiler. Every program type checks and ends with a Main class, so
+# the output can be fed straight into ./lang.
+#
+# Shapes:
+#   deep  - a long chain of classes, each extending the previous one
+#   wide  - one class with many members and many methods
+#   long  - methods with very long bodies of simple statements
+#   nest  - expressions with deeply nested operators and parentheses
+#   calls - many call sites to methods spread over several classes
+#   mixed - a bit of everything, scaled together
+#
+# NOTE: The bison parser uses right recursive rules for statement,
+# method and class lists, so a single list longer than a few thousand
+# entries exhausts its stack. Sizes are split into chunks to stay
+# below that limit.
+
+CHUNK = 1000
+
+# File writing wrapper function
+def writeline(out, line=""):
+    out.write(line + "\n")
+
+def chunks(n, size=CHUNK):
+    while n > 0:
+        yield min(n, size)
+        n -= size
+
+def expression(rng, depth, names):
+    if depth <= 0:
+        if names and rng.random() < 0.5:
+            return rng.choice(names)
+        return str(rng.randint(1, 99))
+    op = rng.choice(["+", "-", "*"])
+    return "(" + expression(rng, depth - 1, names) + " " + op + " " + expression(rng, depth - 1, names) + ")"
+
+def genDeep(out, rng, size):
+    # Class i adds one member and one method; calls from Main go
+    # through the whole superclass chain to reach C0's methods.
+    for i in range(size):
+        extends = "" if i == 0 else " extends C" + str(i - 1)
+        writeline(out, "C" + str(i) + extends + " {")
+        writeline(out, "    integer m" + str(i) + ";")
+        writeline(out, "    get" + str(i) + "() -> integer {")
+        writeline(out, "        return m" + str(i) + ";")
+        writeline(out, "    }")
+        writeline(out, "    set" + str(i) + "(integer v) -> none {")
+        writeline(out, "        m" + str(i) + " = v + m0;")
+        writeline(out, "    }")
+        writeline(out, "    C" + str(i) + "() -> none {")
+        writeline(out, "        m" + str(i) + " = " + str(i) + ";")
+        writeline(out, "    }")
+        writeline(out, "}")
+        writeline(out)
+    last = "C" + str(size - 1)
+    writeline(out, "Main {")
+    writeline(out, "    main() -> none {")
+    writeline(out, "        " + last + " c;")
+    writeline(out, "        c = new " + last + "();")
+    for i in range(0, size, max(1, size // 50)):
+        writeline(out, "        c.set" + str(i) + "(" + str(i) + ");")
+        writeline(out, "        print c.get" + str(i) + "();")
+    writeline(out, "    }")
+    writeline(out, "}")
+
+def genWide(out, rng, size):
+    writeline(out, "Wide {")
+    for i in range(size):
+        writeline(out, "    integer m" + str(i) + ";")
+    for i in range(size):
+        writeline(out, "    f" + str(i) + "(integer a, integer b) -> integer {")
+        writeline(out, "        m" + str(i) + " = a + m" + str(rng.randrange(size)) + ";")
+        writeline(out, "        return m" + str(i) + " * b;")
+        writeline(out, "    }")
+    writeline(out, "    Wide() -> none {")
+    writeline(out, "        m0 = 0;")
+    writeline(out, "    }")
+    writeline(out, "}")
+    writeline(out)
+    writeline(out, "Main {")
+    writeline(out, "    main() -> none {")
+    writeline(out, "        Wide w;")
+    writeline(out, "        w = new Wide();")
+    for i in range(0, size, max(1, size // 100)):
+        writeline(out, "        print w.f" + str(i) + "(" + str(i) + ", 2);")
+    writeline(out, "    }")
+    writeline(out, "}")
+
+def genLong(out, rng, size):
+    writeline(out, "Main {")
+    for n, count in enumerate(chunks(size)):
+        writeline(out, "    body" + str(n) + "() -> none {")
+        writeline(out, "        integer a, b, c, i;")
+        writeline(out, "        a = 1;")
+        writeline(out, "        b = 2;")
+        writeline(out, "        c = 3;")
+        for s in range(count):
+            kind = s % 4
+            if kind == 0:
+                writeline(out, "        a = b + c * " + str(s % 97) + ";")
+            elif kind == 1:
+                writeline(out, "        b = a - c;")
+            elif kind == 2:
+                writeline(out, "        if a > b { c = c + 1; } else { c = c - 1; }")
+            else:
+                writeline(out, "        i = 0; while 3 > i { i = i + 1; }")
+        writeline(out, "        print a + b + c;")
+        writeline(out, "    }")
+    writeline(out, "    main() -> none {")
+    for n, count in enumerate(chunks(size)):
+        writeline(out, "        body" + str(n) + "();")
+    writeline(out, "    }")
+    writeline(out, "}")
+
+def genNest(out, rng, size):
+    # Each statement is a balanced expression tree of depth 8 (255
+    # operators); size is the number of such statements.
+    writeline(out, "Main {")
+    for n, count in enumerate(chunks(size, CHUNK // 4)):
+        writeline(out, "    nest" + str(n) + "(integer x, integer y) -> integer {")
+        writeline(out, "        integer z;")
+        writeline(out, "        z = 0;")
+        for s in range(count):
+            writeline(out, "        z = " + expression(rng, 8, ["x", "y", "z"]) + ";")
+        writeline(out, "        return z;")
+        writeline(out, "    }")
+    writeline(out, "    main() -> none {")
+    for n, count in enumerate(chunks(size, CHUNK // 4)):
+        writeline(out, "        print nest" + str(n) + "(1, 2);")
+    writeline(out, "    }")
+    writeline(out, "}")
+
+def genCalls(out, rng, size):
+    classes = 8
+    for c in range(classes):
+        extends = "" if c == 0 else " extends K" + str(c - 1)
+        writeline(out, "K" + str(c) + extends + " {")
+        writeline(out, "    integer k" + str(c) + ";")
+        writeline(out, "    op" + str(c) + "(integer a, boolean b, integer d) -> integer {")
+        writeline(out, "        if b { k" + str(c) + " = a; } else { k" + str(c) + " = d; }")
+        writeline(out, "        return k" + str(c) + ";")
+        writeline(out, "    }")
+        writeline(out, "    K" + str(c) + "() -> none {")
+        writeline(out, "        k" + str(c) + " = " + str(c) + ";")
+        writeline(out, "    }")
+        writeline(out, "}")
+        writeline(out)
+    last = "K" + str(classes - 1)
+    writeline(out, "Main {")
+    for n, count in enumerate(chunks(size)):
+        writeline(out, "    calls" + str(n) + "(" + last + " k) -> integer {")
+        writeline(out, "        integer t;")
+        writeline(out, "        t = 0;")
+        for s in range(count):
+            c = rng.randrange(classes)
+            writeline(out, "        t = t + k.op" + str(c) + "(t, " + rng.choice(["true", "false"]) + ", " + str(s) + ");")
+        writeline(out, "        return t;")
+        writeline(out, "    }")
+    writeline(out, "    main() -> none {")
+    writeline(out, "        " + last + " k;")
+    writeline(out, "        k = new " + last + "();")
+    for n, count in enumerate(chunks(size)):
+        writeline(out, "        print calls" + str(n) + "(k);")
+    writeline(out, "    }")
+    writeline(out, "}")
+
+def genMixed(out, rng, size):
+    # The other generators all end with a Main class, so the pieces
+    # are emitted into one Main by renaming their entry points.
+    import io
+    parts = []
+    for name, gen, scale in [("deep", genDeep, 0.05), ("wide", genWide, 0.2), ("long", genLong, 1.0), ("nest", genNest, 0.1), ("calls", genCalls, 1.0)]:
+        buf = io.StringIO()
+        gen(buf, rng, max(1, int(size * scale)))
+        parts.append((name, buf.getvalue()))
+    mains = []
+    for name, text in parts:
+        head, sep, tail = text.rpartition("Main {")
+        # Prefix class names so the pieces do not collide
+        if name == "deep":
+            head = head.replace("C", "D")
+            tail = tail.replace("C", "D")
+        out.write(head)
+        body = tail.strip()[:-1].replace("main() -> none", name + "Main() -> none")
+        mains.append((name, body))
+    writeline(out, "Main {")
+    for name, body in mains:
+        writeline(out, body)
+    writeline(out, "    main() -> none {")
+    for name, body in mains:
+        writeline(out, "        " + name + "Main();")
+    writeline(out, "    }")
+    writeline(out, "}")
+
+shapes = {
+    "deep": genDeep,
+    "wide": genWide,
+    "long": genLong,
+    "nest": genNest,
+    "calls": genCalls,
+    "mixed": genMixed,
+}
+
+def generate(shape, size, out, seed=160):
+    shapes[shape](out, random.Random(seed), size)
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description="Generate a synthetic program for compiler benchmarking.")
+    parser.add_argument("shape", choices=sorted(shapes.keys()), help="Kind of program to generate")
+    parser.add_argument("-n", metavar="size", type=int, default=1000, help="Scale of the program (classes, members, statements or call sites)")
+    parser.add_argument("-s", metavar="seed", type=int, default=160, help="Random seed")
+    parser.add_argument("-o", metavar="file", type=str, default=None, help="Output file (default: stdout)")
+    args = parser.parse_args()
+
+    out = open(args.o, "w") if args.o else stdout
+    generate(args.shape, args.n, out, args.s)
@@ -0,0 +1,165 @@
+import argparse
+import json
+import os
+import shutil
+import tempfile
+import time
+from subprocess import Popen, PIPE
+from sys import platform
+
+# Measures the speed of the code that ./lang generates. Every program
+# in bench/programs is compiled with each configuration of compiler
+# flags, linked with tester.c and run a few times after warming up.
+# The output of every configuration must match the first one, so an
+# optimization that changes behaviour is reported instead of timed.
+# When `perf` is available, hardware counters are collected as well.
+
+benchdir = os.path.dirname(os.path.abspath(__file__))
+rootdir = os.path.dirname(benchdir)
+
+perfevents = ["cycles", "instructions", "branches", "branch-misses", "cache-misses"]
+
+def run(args, infile=None, outfile=PIPE):
+    p = Popen(args, stdin=infile if infile else PIPE, stdout=outfile, stderr=PIPE)
+    (out, err) = p.communicate()
+    return (p.returncode, out, err)
+
+def build(lang, flags, source, tmpdir, label):
+    name = os.path.splitext(os.path.basename(source))[0]
+    asm = os.path.join(tmpdir, name + "." + label + ".s")
+    exe = os.path.join(tmpdir, name + "." + label)
+    with open(source, "r") as infile, open(asm, "w") as outfile:
+        (code, out, err) = run([lang] + flags, infile, outfile)
+    if (code != 0 or err):
+        return (None, "compilation failed: " + err.decode("utf-8").strip())
+
+    args = []
+    if (platform == "darwin"):
+        args = ["-Wl,-no_pie"]
+    (code, out, err) = run(["gcc"] + args + ["-m32", "-pthread", "-o", exe, os.path.join(rootdir, "tester.c"), asm])
+    if (code != 0):
+        return (None, "assembling and linking failed: " + err.decode("utf-8").strip())
+    return (exe, None)
+
+def timeRuns(exe, warmup, repeat):
+    output = None
+    for i in range(warmup):
+        (code, output, err) = run([exe])
+        if (code != 0):
+            return (None, None)
+    times = []
+    for i in range(repeat):
+        start = time.perf_counter()
+        (code, output, err) = run([exe])
+        times.append(time.perf_counter() - start)
+        if (code != 0):
+            return (None, None)
+    return (times, output)
+
+def perfStat(exe, tmpdir):
+    report = os.path.join(tmpdir, "perf.csv")
+    (code, out, err) = run(["perf", "stat", "-x", ",", "-o", report, "-e", ",".join(perfevents), exe])
+    if (code != 0 or not os.path.isfile(report)):
+        return None
+    counters = {}
+    with open(report, "r") as csv:
+        for line in csv:
+            fields = line.strip().split(",")
+            if (len(fields) < 3 or line.startswith("#")):
+                continue
+            try:
+                counters[fields[2]] = int(fields[0])
+            except ValueError:
+                # "<not supported>" or "<not counted>"
+                pass
+    return counters
+
+def median(values):
+    values = sorted(values)
+    middle = len(values) // 2
+    if (len(values) % 2):
+        return values[middle]
+    return (values[middle - 1] + values[middle]) / 2
+
+def parseConfig(text):
+    # A configuration is "label=flags", or just flags (used as the label)
+    label, sep, flags = text.partition("=")
+    if (not sep):
+        flags = label
+    return (label or "default", flags.split())
+
+def main():
+    parser = argparse.ArgumentParser(description="Benchmark the run time of generated code.")
+    parser.add_argument("programs", nargs="*", help="Programs to benchmark (default: bench/programs/*.lang)")
+    parser.add_argument("--lang", metavar="path", type=str, default="./lang", help="Compiler to use")
+    parser.add_argument("-c", metavar="config", action="append", help="Compiler flags to compare, as label=flags (repeatable)")
+    parser.add_argument("-r", metavar="repeat", type=int, default=5, help="Timed runs per program")
+    parser.add_argument("-w", metavar="warmup", type=int, default=1, help="Untimed warmup runs per program")
+    parser.add_argument("--no-perf", action="store_true", help="Do not collect perf stat counters")
+    parser.add_argument("--json", metavar="file", type=str, help="Also write the results to this file as JSON")
+    args = parser.parse_args()
+
+    if (not os.path.isfile(args.lang)):
+        print("No `lang` executable.")
+        exit(1)
+
+    programs = args.programs
+    if (not programs):
+        programdir = os.path.join(benchdir, "programs")
+        programs = sorted([os.path.join(programdir, f) for f in os.listdir(programdir) if f.endswith(".lang")])
+    configs = [parseConfig(c) for c in (args.c or ["O0=-O0", "O1=-O1", "O2=-O2"])]
+    useperf = not args.no_perf and shutil.which("perf") is not None
+
+    results = []
+    failed = False
+    with tempfile.TemporaryDirectory() as tmpdir:
+        for source in programs:
+            name = os.path.splitext(os.path.basename(source))[0]
+            reference = None
+            for label, flags in configs:
+                result = {"program": name, "config": label, "flags": " ".join(flags)}
+                results.append(result)
+                (exe, error) = build(args.lang, flags, source, tmpdir, label)
+                if (exe is None):
+                    result["error"] = error
+                    failed = True
+                    continue
+                (times, output) = timeRuns(exe, args.w, args.r)
+                if (times is None):
+                    result["error"] = "exited with an error"
+                    failed = True
+                    continue
+                if (reference is None):
+                    reference = output
+                elif (output != reference):
+                    result["error"] = "output differs from " + configs[0][0]
+                    failed = True
+                    continue
+                result["min_ms"] = min(times) * 1000
+                result["median_ms"] = median(times) * 1000
+                if (useperf):
+                    result["perf"] = perfStat(exe, tmpdir)
+
+    print("%-12s %-10s %12s %12s %10s" % ("program", "config", "min ms", "median ms", "speedup"))
+    baseline = {}
+    for r in results:
+        if ("error" in r):
+            print("%-12s %-10s %s" % (r["program"], r["config"], r["error"]))
+            continue
+        if (r["program"] not in baseline):
+            baseline[r["program"]] = r["median_ms"]
+        speedup = baseline[r["program"]] / r["median_ms"] if r["median_ms"] > 0 else 0
+        print("%-12s %-10s %12.2f %12.2f %9.2fx" % (r["program"], r["config"], r["min_ms"], r["median_ms"], speedup))
+        if (r.get("perf")):
+            perf = r["perf"]
+            print("%-23s " % "" + "  ".join(e + "=" + str(perf[e]) for e in perfevents if e in perf))
+
+    if (args.json):
+        with open(args.json, "w") as out:
+            json.dump(results, out, indent=2)
+
+    if (failed):
+        exit(1)
+
+if __name__ == "__main__":
+    main()
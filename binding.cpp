@@ -0,0 +1,102 @@
+#include "binding.hpp"
+
+void bind(ProgramNode* program, ClassTable* classTable) {
+  Binder binder;
+  binder.bind(program, classTable);
+}
+
+void bind(ClassNode* node, ClassTable* classTable) {
+  Binder binder;
+  binder.bind(node, classTable);
+}
+
+void Binder::bind(ProgramNode* program, ClassTable* classTable) {
+  for (std::list<ClassNode*>::iterator c = program->class_list->begin(); c != program->class_list->end(); c++)
+    bind(*c, classTable);
+}
+
+void Binder::bind(ClassNode* node, ClassTable* classTable) {
+  for (std::list<MethodNode*>::iterator m = node->method_list->begin(); m != node->method_list->end(); m++) {
+    scope = MethodScope(classTable, node->identifier_1->name, (*m)->identifier->name);
+    Binding& method = (*m)->identifier->binding;
+    method.kind = binding_method;
+    method.label = scope.className + "_" + scope.methodName;
+    method.size = scope.method.localsSize;
+
+    visitStatements((*m)->methodbody->statement_list);
+    if ((*m)->methodbody->returnstatement)
+      rewrite((*m)->methodbody->returnstatement->expression);
+  }
+}
+
+// A name that is not a local is a member of "this"
+void Binder::bindVariable(IdentifierNode* name) {
+  if (scope.isLocal(name->name)) {
+    name->binding.kind = binding_local;
+    name->binding.offset = scope.method.variables->find(name->name)->second.offset;
+    name->binding.size = 4;
+  } else {
+    bindMember(name, scope.className);
+  }
+}
+
+void Binder::bindMember(IdentifierNode* name, std::string objectClass) {
+  VariableInfo info;
+  int offset = 0;
+  findMember(scope.classTable, objectClass, name->name, &info, NULL, &offset);
+  name->binding.kind = binding_member;
+  name->binding.offset = offset;
+  name->binding.size = info.size;
+}
+
+void Binder::bindMethod(IdentifierNode* name, std::string objectClass) {
+  std::string declaringClass;
+  findMethod(scope.classTable, objectClass, name->name, NULL, &declaringClass);
+  name->binding.kind = binding_method;
+  name->binding.label = declaringClass + "_" + name->name;
+}
+
+void Binder::visitAssignmentNode(AssignmentNode* node) {
+  bindVariable(node->identifier_1);
+  if (node->identifier_2)
+    bindMember(node->identifier_2, scope.typeOf(node->identifier_1->name).objectClassName);
+  node->expression = rewrite(node->expression);
+}
+
+void Binder::visitCallNode(CallNode* node) {
+  visitMethodCallNode(node->methodcall);
+}
+
+void Binder::visitMethodCallNode(MethodCallNode* node) {
+  if (node->identifier_2) {
+    bindVariable(node->identifier_1);
+    bindMethod(node->identifier_2, scope.typeOf(node->identifier_1->name).objectClassName);
+  } else {
+    bindMethod(node->identifier_1, scope.className);
+  }
+  rewrite(node->expression_list);
+  result = node;
+}
+
+void Binder::visitMemberAccessNode(MemberAccessNode* node) {
+  bindVariable(node->identifier_1);
+  bindMember(node->identifier_2, scope.typeOf(node->identifier_1->name).objectClassName);
+  result = node;
+}
+
+void Binder::visitVariableNode(VariableNode* node) {
+  bindVariable(node->identifier);
+  result = node;
+}
+
+void Binder::visitNewNode(NewNode* node) {
+  std::string className = node->identifier->name;
+  std::string declaringClass;
+  node->identifier->binding.kind = binding_class;
+  node->identifier->binding.size = objectSize(scope.classTable, className);
+  node->identifier->binding.label = "";
+  if (findMethod(scope.classTable, className, className, NULL, &declaringClass))
+    node->identifier->binding.label = declaringClass + "_" + className;
+  rewrite(node->expression_list);
+  result = node;
+}
@@ -0,0 +1,41 @@
+#ifndef __BINDING_HPP
+#define __BINDING_HPP
+
+#include "analysis.hpp"
+
+// This visitor writes the binding (see ast.hpp) of every name that
+// the CodeGenerator uses: variables, the objects and members of
+// member accesses and assignments, called methods, the classes of
+// new expressions, and the names of method declarations. It
+// resolves them the same way the TypeCheck visitor does: a local or
+// parameter first, then a member of "this" or of its superclasses.
+class Binder : public ExpressionRewriter {
+private:
+  MethodScope scope;
+
+  void bindVariable(IdentifierNode* name);
+  void bindMember(IdentifierNode* name, std::string objectClass);
+  void bindMethod(IdentifierNode* name, std::string objectClass);
+
+public:
+  void bind(ProgramNode* program, ClassTable* classTable);
+  void bind(ClassNode* node, ClassTable* classTable);
+
+  virtual void visitAssignmentNode(AssignmentNode* node);
+  virtual void visitCallNode(CallNode* node);
+  virtual void visitMethodCallNode(MethodCallNode* node);
+  virtual void visitMemberAccessNode(MemberAccessNode* node);
+  virtual void visitVariableNode(VariableNode* node);
+  virtual void visitNewNode(NewNode* node);
+};
+
+// Writes the bindings of a whole program. The type checker does
+// this once its tables are complete, and the pass manager does it
+// again after the passes, which move locals and members around and
+// add code.
+void bind(ProgramNode* program, ClassTable* classTable);
+// Writes the bindings of one class, for a program checked one class
+// at a time
+void bind(ClassNode* node, ClassTable* classTable);
+
+#endif
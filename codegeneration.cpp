@@ -1,149 +1,1252 @@
 #include "codegeneration.hpp"
+#include "profile.hpp"
+#include <climits>
 
 // CodeGenerator Visitor Functions: These are the functions
-// you will complete to generate the x86 assembly code. Not
-// all functions must have code, many may be left empty.
+// that generate the x86 assembly code.
+//
+// The code is generated for a simple stack machine: every
+// expression leaves its value pushed on the stack, and
+// statements pop the values they use. Methods follow the cdecl
+// calling convention, with "this" passed as the first argument
+// (at 8(%ebp)) and the remaining arguments above it, starting at
+// 12(%ebp). Methods are called statically, by the label of the
+// class that declares them (Class_method). From -O1 up, expressions
+// are generated by the instruction selector at the end of this file
+// instead, which computes them into %eax.
+//
+// A spawn hands the words of its call (arguments, and "this") to the
+// task runtime linked with the program (tester.c), with the task
+// entry of the method, a function generated after the method that
+// spawns it, which pushes them back and makes the call on whichever
+// thread runs the task. A join waits for the task and returns what
+// the call returned.
 
+// Rough costs, in cycles, that the instruction selector compares.
+// Moves, loads, ALU instructions, lea, shifts, pushes and pops take
+// one cycle each.
+#define COST_MULTIPLY 3
+#define COST_DIVIDE 26
+#define COST_CALL 10
+
+// How an expression can be the source operand of an instruction
+// without being computed into a register first. Members need their
+// object in a register, and bytes (see --pack-objects) a movzbl.
+typedef enum {operand_none, operand_immediate, operand_local, operand_member} OperandKind;
+
+static bool constantValue(ExpressionNode* node, int* value) {
+    if (node->kind == kind_integerliteral) {
+        *value = static_cast<IntegerLiteralNode*>(node)->integer->value;
+        return true;
+    }
+    if (node->kind == kind_booleanliteral) {
+        *value = static_cast<BooleanLiteralNode*>(node)->integer->value;
+        return true;
+    }
+    return false;
+}
+
+static OperandKind operandKind(ExpressionNode* node) {
+    if (node->kind == kind_integerliteral || node->kind == kind_booleanliteral)
+        return operand_immediate;
+    if (node->kind == kind_variable) {
+        Binding& variable = static_cast<VariableNode*>(node)->identifier->binding;
+        if (variable.kind == binding_local)
+            return operand_local;
+        return variable.size == 4 ? operand_member : operand_none;
+    }
+    if (node->kind == kind_memberaccess) {
+        MemberAccessNode* access = static_cast<MemberAccessNode*>(node);
+        if (access->identifier_1->binding.kind == binding_local && access->identifier_2->binding.size == 4)
+            return operand_member;
+    }
+    return operand_none;
+}
+
+// What an operand costs on top of the instruction that uses it
+static int operandCost(ExpressionNode* node) {
+    return operandKind(node) == operand_member ? 1 : 0;
+}
+
+template <class Binary>
+static bool operandsOf(ExpressionNode* node, ExpressionNode** left, ExpressionNode** right) {
+    *left = static_cast<Binary*>(node)->expression_1;
+    *right = static_cast<Binary*>(node)->expression_2;
+    return true;
+}
+
+static bool binaryOperands(ExpressionNode* node, ExpressionNode** left, ExpressionNode** right) {
+    switch (node->kind) {
+    case kind_plus: return operandsOf<PlusNode>(node, left, right);
+    case kind_minus: return operandsOf<MinusNode>(node, left, right);
+    case kind_times: return operandsOf<TimesNode>(node, left, right);
+    case kind_divide: return operandsOf<DivideNode>(node, left, right);
+    case kind_greater: return operandsOf<GreaterNode>(node, left, right);
+    case kind_greaterequal: return operandsOf<GreaterEqualNode>(node, left, right);
+    case kind_equal: return operandsOf<EqualNode>(node, left, right);
+    case kind_and: return operandsOf<AndNode>(node, left, right);
+    case kind_or: return operandsOf<OrNode>(node, left, right);
+    default: return false;
+    }
+}
+
+// The exponent of a power of two, or -1
+static int log2Exact(int value) {
+    if (value <= 0 || (value & (value - 1)) != 0)
+        return -1;
+    int exponent = 0;
+    while ((1 << exponent) != value)
+        exponent++;
+    return exponent;
+}
+
+// Matches index * scale (or scale * index) for a scale of 2, 4 or 8
+static bool scaledIndex(ExpressionNode* node, ExpressionNode** index, int* scale) {
+    ExpressionNode *left, *right;
+    if (node->kind != kind_times || !binaryOperands(node, &left, &right))
+        return false;
+    if (constantValue(right, scale) && (*scale == 2 || *scale == 4 || *scale == 8)) {
+        *index = left;
+        return true;
+    }
+    if (constantValue(left, scale) && (*scale == 2 || *scale == 4 || *scale == 8)) {
+        *index = right;
+        return true;
+    }
+    return false;
+}
+
+// Matches a sum that lea can compute from two registers: base +
+// index * scale, either way around, or base + index. The operands
+// are returned in the order they are evaluated.
+static bool address(ExpressionNode* node, ExpressionNode** first, ExpressionNode** second, bool* indexFirst,
+                    int* scale) {
+    ExpressionNode *left, *right, *index;
+    if (node->kind != kind_plus || !binaryOperands(node, &left, &right))
+        return false;
+    *scale = 1;
+    *indexFirst = false;
+    *first = left;
+    *second = right;
+    if (scaledIndex(right, &index, scale)) {
+        *second = index;
+    } else if (scaledIndex(left, &index, scale)) {
+        *first = index;
+        *indexFirst = true;
+    }
+    return true;
+}
+
+// The multiplier and shift that divide by a constant (whose absolute
+// value is at least 2) as a signed multiplication, from Hacker's
+// Delight (10-1)
+static void magicNumber(int divisor, int* multiplier, int* shift) {
+    const unsigned two31 = 0x80000000u;
+    unsigned absolute = divisor < 0 ? -(unsigned)divisor : divisor;
+    unsigned t = two31 + ((unsigned)divisor >> 31);
+    unsigned absoluteNc = t - 1 - t % absolute;
+    int p = 31;
+    unsigned q1 = two31 / absoluteNc, r1 = two31 - q1 * absoluteNc;
+    unsigned q2 = two31 / absolute, r2 = two31 - q2 * absolute;
+    unsigned delta;
+    do {
+        p++;
+        q1 *= 2;
+        r1 *= 2;
+        if (r1 >= absoluteNc) {
+            q1++;
+            r1 -= absoluteNc;
+        }
+        q2 *= 2;
+        r2 *= 2;
+        if (r2 >= absolute) {
+            q2++;
+            r2 -= absolute;
+        }
+        delta = absolute - r2;
+    } while (q1 < delta || (q1 == delta && r1 == 0));
+    *multiplier = q2 + 1;
+    if (divisor < 0)
+        *multiplier = -*multiplier;
+    *shift = p - 32;
+}
+
+static std::string negatedCondition(std::string condition) {
+    if (condition == "g")
+        return "le";
+    if (condition == "ge")
+        return "l";
+    return "ne";
+}
+
+void CodeGenerator::emit(std::string instruction) {
+    *out << "    " << instruction << "\n";
+    instructionsEmitted++;
+}
+
+void CodeGenerator::label(std::string name) {
+    *out << name << ":\n";
+}
+
+void CodeGenerator::directive(std::string text) {
+    *out << "    " << text << "\n";
+}
+
+void CodeGenerator::loadVariable(IdentifierNode* name, std::string reg) {
+    if (name->binding.kind == binding_local) {
+        emit("mov " + std::to_string(name->binding.offset) + "(%ebp), " + reg);
+    } else {
+        emit("mov 8(%ebp), " + reg);
+        loadMember(name, reg, reg);
+    }
+}
+
+std::string CodeGenerator::memberAddress(IdentifierNode* member, std::string base) {
+    return std::to_string(member->binding.offset) + "(" + base + ")";
+}
+
+void CodeGenerator::loadMember(IdentifierNode* member, std::string base, std::string reg) {
+    emit((member->binding.size == 1 ? "movzbl " : "mov ") + memberAddress(member, base) + ", " + reg);
+}
+
+void CodeGenerator::storeMember(IdentifierNode* member, std::string base) {
+    emit((member->binding.size == 1 ? "movb %al, " : "mov %eax, ") + memberAddress(member, base));
+}
+
+int CodeGenerator::pushArguments(std::list<ExpressionNode*>* arguments) {
+    int count = 0;
+    if (arguments) {
+        for (std::list<ExpressionNode*>::reverse_iterator it = arguments->rbegin(); it != arguments->rend(); it++) {
+            if (selectInstructions)
+                pushValue(*it);
+            else
+                visit(*it);
+            count++;
+        }
+    }
+    return count;
+}
+
+void CodeGenerator::visitStatements(std::list<StatementNode*>* statements) {
+    if (statements) {
+        for (std::list<StatementNode*>::iterator it = statements->begin(); it != statements->end(); it++)
+            visit(*it);
+    }
+}
+
+// Every function gets a symbol type and size, a frame pointer, and
+// call frame information (so that debuggers and profilers like perf
+// can name it and unwind through it). The canonical frame address is
+// %esp + 4 at entry, %esp + 8 once %ebp is pushed, and %ebp + 8 once
+// it is set up.
+void CodeGenerator::beginFunction(std::string name, SourceLocation where) {
+    lastLocation = 0;
+    directive(".type " + name + ", @function");
+    label(name);
+    location(where);
+    directive(".cfi_startproc");
+    emit("push %ebp");
+    directive(".cfi_def_cfa_offset 8");
+    directive(".cfi_offset %ebp, -8");
+    emit("mov %esp, %ebp");
+    directive(".cfi_def_cfa_register %ebp");
+}
+
+void CodeGenerator::leaveFrame() {
+    emit("mov %ebp, %esp");
+    emit("pop %ebp");
+    directive(".cfi_def_cfa %esp, 4");
+}
+
+void CodeGenerator::endFunction(std::string name) {
+    directive(".cfi_endproc");
+    directive(".size " + name + ", .-" + name);
+}
+
+// With -g, each statement is marked with its source line and column,
+// which the assembler turns into DWARF line information
+void CodeGenerator::location(SourceLocation where) {
+    if (debugInfo && where != 0 && where != lastLocation) {
+        directive(".loc 1 " + std::to_string(locationLine(where)) + " " + std::to_string(locationColumn(where)));
+        lastLocation = where;
+    }
+}
+
+// Instrumented programs keep the profile in .data exactly as it is
+// written to the file: the header, then the counters.
+void CodeGenerator::countSite(ASTNode* node, int which) {
+    int counter = profile.counter(node);
+    if (instrument && counter >= 0)
+        emit("incl __lang_counters+" + std::to_string(4 * (counter + which)));
+}
+
+void CodeGenerator::profileDump() {
+    beginFunction("__lang_profile_dump", 0);
+    emit("push $__lang_profile_mode");
+    emit("push $__lang_profile_name");
+    emit("call fopen");
+    emit("add $8, %esp");
+    emit("test %eax, %eax");
+    emit("jz .Lprofile_done");
+    emit("push %eax");
+    emit("push %eax");
+    emit("push $" + std::to_string(4 + profile.counterCount));
+    emit("push $4");
+    emit("push $__lang_profile");
+    emit("call fwrite");
+    emit("add $16, %esp");
+    emit("call fclose");
+    emit("add $4, %esp");
+    label(".Lprofile_done");
+    leaveFrame();
+    emit("ret");
+    endFunction("__lang_profile_dump");
+}
+
+// A program made of several files keeps its profile in the file of
+// the Main class, where the other files find the counters.
 void CodeGenerator::visitProgramNode(ProgramNode* node) {
-    // WRITEME: Replace with code if necessary
+    bool hasMain = false;
+    for (std::list<ClassNode*>::iterator it = node->class_list->begin(); it != node->class_list->end(); it++)
+        hasMain = hasMain || (*it)->identifier_1->name == "Main";
+
+    beginProgram(hasMain);
+    visitChildren(node);
+    endProgram(hasMain);
+}
+
+void CodeGenerator::beginProgram(bool hasMain) {
+    if (debugInfo)
+        directive(".file 1 \"" + sourceName + "\"");
+    directive(".data");
+    label("printstr");
+    directive(".asciz \"%d\\n\"");
+    if (instrument && hasMain) {
+        if (globalSymbols)
+            directive(".globl __lang_counters");
+        directive(".p2align 2");
+        label("__lang_profile");
+        directive(".ascii \"" PROFILE_MAGIC "\"");
+        directive(".long " + std::to_string(PROFILE_VERSION));
+        directive(".long " + std::to_string(profile.checksum));
+        directive(".long " + std::to_string(profile.counterCount));
+        label("__lang_counters");
+        directive(".zero " + std::to_string(4 * profile.counterCount));
+        label("__lang_profile_name");
+        directive(".asciz \"lang.profile\"");
+        label("__lang_profile_mode");
+        directive(".asciz \"wb\"");
+    }
+    directive(".text");
+    directive(".globl Main_main");
+}
+
+void CodeGenerator::endProgram(bool hasMain) {
+    if (instrument && hasMain)
+        profileDump();
 }
 
 void CodeGenerator::visitClassNode(ClassNode* node) {
-    // WRITEME: Replace with code if necessary
+    currentClassName = node->identifier_1->name;
+    if (node->method_list) {
+        for (std::list<MethodNode*>::iterator it = node->method_list->begin(); it != node->method_list->end(); it++)
+            visit(*it);
+    }
 }
 
 void CodeGenerator::visitMethodNode(MethodNode* node) {
-    // WRITEME: Replace with code if necessary
-}
+    currentMethodName = node->identifier->name;
+    currentParameterCount = node->parameter_list->size();
+    selections.clear();
 
-void CodeGenerator::visitMethodBodyNode(MethodBodyNode* node) {
-    // WRITEME: Replace with code if necessary
+    // Methods that never ran in the profile go to a separate
+    // section, which the linker places after the hot code
+    unsigned count;
+    bool cold = profile.count(node, 0, &count) && count == 0;
+    if (cold)
+        directive(".section .text.unlikely,\"ax\",@progbits");
+
+    std::string name = currentClassName + "_" + currentMethodName;
+    if (globalSymbols)
+        directive(".globl " + name);
+    beginFunction(name, node->identifier->location);
+    int localsSize = node->identifier->binding.size;
+    if (localsSize > 0)
+        emit("sub $" + std::to_string(localsSize) + ", %esp");
+    if (instrument && currentClassName == "Main" && currentMethodName == "main") {
+        emit("push $__lang_profile_dump");
+        emit("call atexit");
+        emit("add $4, %esp");
+    }
+    if (tailCalls)
+        label(".L" + currentClassName + "_" + currentMethodName + "_body");
+    countSite(node, 0);
+
+    endedWithTailCall = false;
+    visit(node->methodbody);
+
+    endFunction(name);
+    if (cold)
+        directive(".text");
+
+    for (std::map<std::string, int>::iterator it = spawnedMethods.begin(); it != spawnedMethods.end(); it++) {
+        if (taskEntries.insert(it->first).second)
+            taskEntry(it->first, it->second);
+    }
+    spawnedMethods.clear();
 }
 
-void CodeGenerator::visitParameterNode(ParameterNode* node) {
-    // WRITEME: Replace with code if necessary
+// The runtime calls a task entry with the address of the words of the
+// call, "this" first, and takes the result from %eax. Task entries are
+// local to each file of a program, like the labels inside methods.
+void CodeGenerator::taskEntry(std::string label, int words) {
+    std::string name = "__lang_task_" + label;
+    beginFunction(name, 0);
+    emit("mov 8(%ebp), %ecx");
+    for (int i = words - 1; i >= 0; i--)
+        emit("push " + std::to_string(4 * i) + "(%ecx)");
+    emit("call " + label);
+    leaveFrame();
+    emit("ret");
+    endFunction(name);
 }
 
-void CodeGenerator::visitDeclarationNode(DeclarationNode* node) {
-    // WRITEME: Replace with code if necessary
+void CodeGenerator::visitMethodBodyNode(MethodBodyNode* node) {
+    visitStatements(node->statement_list);
+    if (node->returnstatement)
+        visit(node->returnstatement);
+
+    if (!endedWithTailCall) {
+        leaveFrame();
+        emit("ret");
+    }
 }
 
+void CodeGenerator::visitParameterNode(ParameterNode* node) {}
+
+void CodeGenerator::visitDeclarationNode(DeclarationNode* node) {}
+
 void CodeGenerator::visitReturnStatementNode(ReturnStatementNode* node) {
-    // WRITEME: Replace with code if necessary
+    location(node->location);
+    MethodCallNode* call = dynamic_cast<MethodCallNode*>(node->expression);
+    if (tailCalls && call && tailCall(call)) {
+        endedWithTailCall = true;
+        return;
+    }
+    if (selectInstructions) {
+        evaluate(node->expression);
+    } else {
+        visit(node->expression);
+        emit("pop %eax");
+    }
 }
 
 void CodeGenerator::visitAssignmentNode(AssignmentNode* node) {
-    // WRITEME: Replace with code if necessary
+    location(node->location);
+    if (selectInstructions) {
+        if (assignInPlace(node))
+            return;
+        evaluate(node->expression);
+    } else {
+        visit(node->expression);
+        emit("pop %eax");
+    }
+
+    if (node->identifier_2) {
+        loadVariable(node->identifier_1, "%ecx");
+        storeMember(node->identifier_2, "%ecx");
+    } else if (node->identifier_1->binding.kind == binding_local) {
+        emit("mov %eax, " + std::to_string(node->identifier_1->binding.offset) + "(%ebp)");
+    } else {
+        emit("mov 8(%ebp), %ecx");
+        storeMember(node->identifier_1, "%ecx");
+    }
 }
 
 void CodeGenerator::visitCallNode(CallNode* node) {
-    // WRITEME: Replace with code if necessary
+    location(node->location);
+    if (selectInstructions) {
+        callMethod(node->methodcall);
+    } else {
+        // The call always pushes a value, which is not used here
+        visit(node->methodcall);
+        emit("add $4, %esp");
+    }
 }
 
+// With a profile, the branch that ran more often is placed right
+// after the test, so that it is reached without a taken jump.
 void CodeGenerator::visitIfElseNode(IfElseNode* node) {
-    // WRITEME: Replace with code if necessary
+    location(node->expression->location);
+    int id = nextLabel();
+    std::string elseLabel = ".Lelse" + std::to_string(id);
+    std::string endLabel = ".Lendif" + std::to_string(id);
+
+    unsigned thenCount, elseCount;
+    bool elseFirst = profile.count(node, 0, &thenCount) && profile.count(node, 1, &elseCount) &&
+                     elseCount > thenCount;
+
+    if (elseFirst) {
+        std::string thenLabel = ".Lthen" + std::to_string(id);
+        jumpIf(node->expression, thenLabel, true);
+        countSite(node, 1);
+        visitStatements(node->statement_list_2);
+        emit("jmp " + endLabel);
+        label(thenLabel);
+        countSite(node, 0);
+        visitStatements(node->statement_list_1);
+    } else {
+        jumpIf(node->expression, elseLabel, false);
+        countSite(node, 0);
+        visitStatements(node->statement_list_1);
+        emit("jmp " + endLabel);
+        label(elseLabel);
+        countSite(node, 1);
+        visitStatements(node->statement_list_2);
+    }
+    label(endLabel);
+}
+
+// Loops are laid out with the test at the bottom, so each iteration
+// takes a single conditional branch. The top of the loop body is
+// the target of the back edge, so it is aligned to 16 bytes (when
+// that takes at most 10 bytes of padding, as GCC does for loops),
+// unless the profile shows that the body never ran.
+
+void CodeGenerator::alignLoop(ASTNode* node) {
+    unsigned count;
+    if (!profile.count(node, 0, &count) || count > 0)
+        directive(".p2align 4,,10");
+}
+
+void CodeGenerator::jumpIf(ExpressionNode* condition, std::string target, bool whenTrue) {
+    if (selectInstructions) {
+        // A comparison sets the flags for the jump itself
+        int value;
+        if (constantValue(condition, &value)) {
+            if ((value != 0) == whenTrue)
+                emit("jmp " + target);
+            return;
+        }
+        if (condition->kind == kind_not) {
+            jumpIf(static_cast<NotNode*>(condition)->expression, target, !whenTrue);
+            return;
+        }
+        if (condition->kind == kind_greater || condition->kind == kind_greaterequal || condition->kind == kind_equal) {
+            std::string holds = compare(condition);
+            emit("j" + (whenTrue ? holds : negatedCondition(holds)) + " " + target);
+            return;
+        }
+        evaluate(condition);
+    } else {
+        visit(condition);
+        emit("pop %eax");
+    }
+    emit("test %eax, %eax");
+    emit((whenTrue ? "jnz " : "jz ") + target);
 }
 
 void CodeGenerator::visitWhileNode(WhileNode* node) {
-    // WRITEME: Replace with code if necessary
+    int id = nextLabel();
+    std::string bodyLabel = ".Lloop" + std::to_string(id);
+    std::string testLabel = ".Ltest" + std::to_string(id);
+
+    location(node->expression->location);
+    emit("jmp " + testLabel);
+    alignLoop(node);
+    label(bodyLabel);
+    countSite(node, 0);
+    visitStatements(node->statement_list);
+    label(testLabel);
+    location(node->expression->location);
+    jumpIf(node->expression, bodyLabel, true);
 }
 
 void CodeGenerator::visitPrintNode(PrintNode* node) {
-    // WRITEME: Replace with code if necessary
+    location(node->location);
+    if (selectInstructions)
+        pushValue(node->expression);
+    else
+        visit(node->expression);
+    emit("push $printstr");
+    emit("call printf");
+    emit("add $8, %esp");
 }
 
 void CodeGenerator::visitDoWhileNode(DoWhileNode* node) {
-    // WRITEME: Replace with code if necessary
+    std::string bodyLabel = ".Lloop" + std::to_string(nextLabel());
+
+    alignLoop(node);
+    label(bodyLabel);
+    countSite(node, 0);
+    visitStatements(node->statement_list);
+    location(node->expression->location);
+    jumpIf(node->expression, bodyLabel, true);
 }
 
+// Binary operators evaluate the left operand, then the right one,
+// and leave them in %eax and %ecx.
+
 void CodeGenerator::visitPlusNode(PlusNode* node) {
-    // WRITEME: Replace with code if necessary
+    visitChildren(node);
+    emit("pop %ecx");
+    emit("pop %eax");
+    emit("add %ecx, %eax");
+    emit("push %eax");
 }
 
 void CodeGenerator::visitMinusNode(MinusNode* node) {
-    // WRITEME: Replace with code if necessary
+    visitChildren(node);
+    emit("pop %ecx");
+    emit("pop %eax");
+    emit("sub %ecx, %eax");
+    emit("push %eax");
 }
 
 void CodeGenerator::visitTimesNode(TimesNode* node) {
-    // WRITEME: Replace with code if necessary
+    visitChildren(node);
+    emit("pop %ecx");
+    emit("pop %eax");
+    emit("imul %ecx, %eax");
+    emit("push %eax");
 }
 
 void CodeGenerator::visitDivideNode(DivideNode* node) {
-    // WRITEME: Replace with code if necessary
+    visitChildren(node);
+    emit("pop %ecx");
+    emit("pop %eax");
+    emit("cdq");
+    emit("idiv %ecx");
+    emit("push %eax");
 }
 
 void CodeGenerator::visitGreaterNode(GreaterNode* node) {
-    // WRITEME: Replace with code if necessary
+    visitChildren(node);
+    emit("pop %ecx");
+    emit("pop %eax");
+    emit("cmp %ecx, %eax");
+    emit("setg %al");
+    emit("movzbl %al, %eax");
+    emit("push %eax");
 }
 
 void CodeGenerator::visitGreaterEqualNode(GreaterEqualNode* node) {
-    // WRITEME: Replace with code if necessary
+    visitChildren(node);
+    emit("pop %ecx");
+    emit("pop %eax");
+    emit("cmp %ecx, %eax");
+    emit("setge %al");
+    emit("movzbl %al, %eax");
+    emit("push %eax");
 }
 
 void CodeGenerator::visitEqualNode(EqualNode* node) {
-    // WRITEME: Replace with code if necessary
+    visitChildren(node);
+    emit("pop %ecx");
+    emit("pop %eax");
+    emit("cmp %ecx, %eax");
+    emit("sete %al");
+    emit("movzbl %al, %eax");
+    emit("push %eax");
 }
 
 void CodeGenerator::visitAndNode(AndNode* node) {
-    // WRITEME: Replace with code if necessary
+    visitChildren(node);
+    emit("pop %ecx");
+    emit("pop %eax");
+    emit("and %ecx, %eax");
+    emit("push %eax");
 }
 
 void CodeGenerator::visitOrNode(OrNode* node) {
-    // WRITEME: Replace with code if necessary
+    visitChildren(node);
+    emit("pop %ecx");
+    emit("pop %eax");
+    emit("or %ecx, %eax");
+    emit("push %eax");
 }
 
 void CodeGenerator::visitNotNode(NotNode* node) {
-    // WRITEME: Replace with code if necessary
+    visitChildren(node);
+    emit("pop %eax");
+    emit("xor $1, %eax");
+    emit("push %eax");
 }
 
 void CodeGenerator::visitNegationNode(NegationNode* node) {
-    // WRITEME: Replace with code if necessary
+    visitChildren(node);
+    emit("pop %eax");
+    emit("neg %eax");
+    emit("push %eax");
 }
 
 void CodeGenerator::visitMethodCallNode(MethodCallNode* node) {
-    // WRITEME: Replace with code if necessary
+    callMethod(node);
+    emit("push %eax");
+}
+
+void CodeGenerator::callMethod(MethodCallNode* node) {
+    int count = pushArguments(node->expression_list);
+
+    IdentifierNode* method = node->identifier_1;
+    if (node->identifier_2) {
+        loadVariable(node->identifier_1, "%eax");
+        method = node->identifier_2;
+        emit("push %eax");
+    } else {
+        emit("push 8(%ebp)");
+    }
+
+    emit("call " + method->binding.label);
+    emit("add $" + std::to_string(4 * (count + 1)) + ", %esp");
+}
+
+// A call in a return statement can return straight to our caller.
+// Its arguments (and "this") are evaluated as for any call, then
+// popped into our own argument slots, from 8(%ebp) up, which the
+// caller will remove after we return, as cdecl has the caller pop
+// the arguments. So the callee may take at most as many words as
+// we did; Main_main is called with none at all. A call to the
+// method itself jumps back past the prologue, keeping the frame;
+// any other call first tears the frame down.
+bool CodeGenerator::tailCall(MethodCallNode* node) {
+    std::string label = (node->identifier_2 ? node->identifier_2 : node->identifier_1)->binding.label;
+
+    // The type checker made sure there is an argument per parameter
+    int words = (node->expression_list ? node->expression_list->size() : 0) + 1;
+    int available = currentParameterCount + 1;
+    if (currentClassName == "Main" && currentMethodName == "main")
+        available = 0;
+    if (words > available)
+        return false;
+
+    pushArguments(node->expression_list);
+    if (node->identifier_2) {
+        loadVariable(node->identifier_1, "%eax");
+        emit("push %eax");
+    } else {
+        emit("push 8(%ebp)");
+    }
+    for (int i = 0; i < words; i++) {
+        emit("pop %eax");
+        emit("mov %eax, " + std::to_string(8 + 4 * i) + "(%ebp)");
+    }
+
+    if (label == currentClassName + "_" + currentMethodName) {
+        emit("jmp .L" + label + "_body");
+    } else {
+        leaveFrame();
+        emit("jmp " + label);
+    }
+    return true;
 }
 
 void CodeGenerator::visitMemberAccessNode(MemberAccessNode* node) {
-    // WRITEME: Replace with code if necessary
+    loadVariable(node->identifier_1, "%eax");
+    if (node->identifier_2->binding.size == 1) {
+        loadMember(node->identifier_2, "%eax", "%eax");
+        emit("push %eax");
+    } else {
+        emit("push " + memberAddress(node->identifier_2, "%eax"));
+    }
 }
 
 void CodeGenerator::visitVariableNode(VariableNode* node) {
-    // WRITEME: Replace with code if necessary
+    loadVariable(node->identifier, "%eax");
+    emit("push %eax");
 }
 
 void CodeGenerator::visitIntegerLiteralNode(IntegerLiteralNode* node) {
-    // WRITEME: Replace with code if necessary
+    emit("push $" + std::to_string(node->integer->value));
 }
 
 void CodeGenerator::visitBooleanLiteralNode(BooleanLiteralNode* node) {
-    // WRITEME: Replace with code if necessary
+    emit("push $" + std::to_string(node->integer->value));
 }
 
 void CodeGenerator::visitNewNode(NewNode* node) {
-    // WRITEME: Replace with code if necessary
+    allocate(node);
+    emit("push %eax");
 }
 
-void CodeGenerator::visitIntegerTypeNode(IntegerTypeNode* node) {
-    // WRITEME: Replace with code if necessary
+void CodeGenerator::allocate(NewNode* node) {
+    // The constructor arguments are pushed first, so that the new
+    // object only has to be pushed on top of them as "this"
+    int count = pushArguments(node->expression_list);
+    Binding& created = node->identifier->binding;
+
+    // Objects come from the allocator of the runtime, which tasks on
+    // several threads may call at once (see tester.c)
+    emit("push $" + std::to_string(created.size));
+    emit("call __lang_new");
+    emit("add $4, %esp");
+
+    if (!created.label.empty()) {
+        emit("push %eax");
+        emit("call " + created.label);
+        emit("pop %eax");
+    }
+    if (count > 0)
+        emit("add $" + std::to_string(4 * count) + ", %esp");
 }
 
-void CodeGenerator::visitBooleanTypeNode(BooleanTypeNode* node) {
-    // WRITEME: Replace with code if necessary
+void CodeGenerator::visitSpawnNode(SpawnNode* node) {
+    spawnTask(node);
+    emit("push %eax");
 }
 
-void CodeGenerator::visitObjectTypeNode(ObjectTypeNode* node) {
-    // WRITEME: Replace with code if necessary
+// The words of the call are pushed as for the call itself, and the
+// runtime copies them into the task
+void CodeGenerator::spawnTask(SpawnNode* node) {
+    MethodCallNode* call = node->methodcall;
+    int count = pushArguments(call->expression_list);
+
+    IdentifierNode* method = call->identifier_1;
+    if (call->identifier_2) {
+        loadVariable(call->identifier_1, "%eax");
+        method = call->identifier_2;
+        emit("push %eax");
+    } else {
+        emit("push 8(%ebp)");
+    }
+    spawnedMethods[method->binding.label] = count + 1;
+
+    emit("mov %esp, %eax");
+    emit("push %eax");
+    emit("push $" + std::to_string(count + 1));
+    emit("push $__lang_task_" + method->binding.label);
+    emit("call __lang_spawn");
+    emit("add $" + std::to_string(4 * (count + 4)) + ", %esp");
 }
 
-void CodeGenerator::visitNoneNode(NoneNode* node) {
-    // WRITEME: Replace with code if necessary
+void CodeGenerator::visitJoinNode(JoinNode* node) {
+    joinTask(node);
+    emit("push %eax");
 }
 
-void CodeGenerator::visitIdentifierNode(IdentifierNode* node) {
-    // WRITEME: Replace with code if necessary
+void CodeGenerator::joinTask(JoinNode* node) {
+    if (selectInstructions)
+        pushValue(node->expression);
+    else
+        visit(node->expression);
+    emit("call __lang_join");
+    emit("add $4, %esp");
 }
 
-void CodeGenerator::visitIntegerNode(IntegerNode* node) {
-    // WRITEME: Replace with code if necessary
+void CodeGenerator::visitIntegerTypeNode(IntegerTypeNode* node) {}
+
+void CodeGenerator::visitBooleanTypeNode(BooleanTypeNode* node) {}
+
+void CodeGenerator::visitObjectTypeNode(ObjectTypeNode* node) {}
+
+void CodeGenerator::visitTaskTypeNode(TaskTypeNode* node) {}
+
+void CodeGenerator::visitNoneNode(NoneNode* node) {}
+
+void CodeGenerator::visitIdentifierNode(IdentifierNode* node) {}
+
+void CodeGenerator::visitIntegerNode(IntegerNode* node) {}
+
+// Instruction selection
+//
+// From -O1 up, expressions are generated by a tree-pattern instruction
+// selector instead of the stack machine. As in BURS, select labels the
+// nodes of an expression bottom up with the cheapest rule that computes
+// each one into %eax, given the costs of its children, and reduce then
+// generates the chosen rules top down. Constants, locals and members
+// (of "this" or of an object in a local) become the operands of
+// instructions, so add, sub, imul, and, or and cmp take immediates and
+// memory operands instead of popping their operands into registers;
+// base + index * scale + displacement is computed with lea;
+// multiplications by constants use shifts, lea or an immediate imul;
+// and divisions by constants use shifts or a multiplication by the
+// reciprocal. The operands are evaluated in the order of the source,
+// unless nothing between them could change the one moved (a call may
+// change members, but never our locals). Calls, new expressions,
+// spawns and joins leave their result in %eax.
+
+const Selection& CodeGenerator::select(ExpressionNode* node) {
+    std::map<ExpressionNode*, Selection>::iterator found = selections.find(node);
+    if (found != selections.end())
+        return found->second;
+
+    Selection selection;
+    selection.pure = true;
+    switch (node->kind) {
+    case kind_integerliteral:
+    case kind_booleanliteral:
+        selection.rule = rule_constant;
+        selection.cost = 1;
+        break;
+    case kind_variable:
+        if (static_cast<VariableNode*>(node)->identifier->binding.kind == binding_local) {
+            selection.rule = rule_local;
+            selection.cost = 1;
+        } else {
+            selection.rule = rule_member;
+            selection.cost = 2;
+        }
+        break;
+    case kind_memberaccess:
+        selection.rule = rule_member;
+        selection.cost = static_cast<MemberAccessNode*>(node)->identifier_1->binding.kind == binding_local ? 2 : 3;
+        break;
+    case kind_not:
+    case kind_negation: {
+        const Selection& operand = select(node->kind == kind_not ? static_cast<NotNode*>(node)->expression
+                                                                 : static_cast<NegationNode*>(node)->expression);
+        selection.rule = rule_unary;
+        selection.cost = operand.cost + 1;
+        selection.pure = operand.pure;
+        break;
+    }
+    case kind_methodcall:
+    case kind_new:
+    case kind_spawn:
+    case kind_join:
+        selection.rule = rule_call;
+        selection.cost = COST_CALL;
+        selection.pure = false;
+        break;
+    default:
+        selectBinary(node, &selection);
+        break;
+    }
+    return selections[node] = selection;
+}
+
+// Picks how to get the left operand into %eax and the right one into
+// an operand, and adds what that costs: the right operand may be used
+// where it is, or be computed first, when the left one is then usable
+// where it is (swapped); otherwise the left one is spilled.
+SelectionRule CodeGenerator::operandRule(ExpressionNode* left, ExpressionNode* right, bool commutative, bool immediate,
+                                         int* cost) {
+    const Selection& leftSelection = select(left);
+    const Selection& rightSelection = select(right);
+    SelectionRule rule = rule_spill;
+    int best = leftSelection.cost + rightSelection.cost + 3;
+
+    OperandKind rightKind = operandKind(right);
+    if (rightKind != operand_none && (immediate || rightKind != operand_immediate)) {
+        int operandCost = leftSelection.cost + ::operandCost(right);
+        if (operandCost <= best) {
+            rule = rule_operand;
+            best = operandCost;
+        }
+    }
+    OperandKind leftKind = operandKind(left);
+    bool movable = leftKind == operand_immediate || leftKind == operand_local || rightSelection.pure;
+    if (leftKind != operand_none && movable && (commutative ? immediate || leftKind != operand_immediate : true)) {
+        // Not commuting, the right operand moves to %ecx and the left
+        // one is loaded into %eax
+        int swappedCost = rightSelection.cost + ::operandCost(left) + (commutative ? 0 : 2);
+        if (swappedCost < best) {
+            rule = rule_swapped;
+            best = swappedCost;
+        }
+    }
+    *cost += best;
+    return rule;
+}
+
+void CodeGenerator::selectBinary(ExpressionNode* node, Selection* selection) {
+    ExpressionNode *left, *right;
+    binaryOperands(node, &left, &right);
+    selection->pure = select(left).pure && select(right).pure;
+
+    bool commutative = node->kind != kind_minus && node->kind != kind_divide && node->kind != kind_greater &&
+                       node->kind != kind_greaterequal;
+    int cost = 1;
+    if (node->kind == kind_times)
+        cost = COST_MULTIPLY;
+    else if (node->kind == kind_divide)
+        cost = COST_DIVIDE + 1;
+    else if (node->kind == kind_greater || node->kind == kind_greaterequal || node->kind == kind_equal)
+        cost = 3;
+    // idiv has no immediate form
+    selection->rule = operandRule(left, right, commutative, node->kind != kind_divide, &cost);
+    selection->cost = cost;
+
+    int constant;
+    ExpressionNode *first, *second, *inner;
+    bool indexFirst;
+    int scale;
+    if (node->kind == kind_plus) {
+        ExpressionNode* index;
+        int leaCost = 1;
+        if ((scaledIndex(left, &index, &scale) || scaledIndex(right, &index, &scale)) &&
+            address(node, &first, &second, &indexFirst, &scale)) {
+            SelectionRule pair = operandRule(first, second, false, true, &leaCost);
+            if (pair == rule_operand)
+                leaCost++;
+            if (leaCost < selection->cost) {
+                selection->rule = rule_lea;
+                selection->cost = leaCost;
+            }
+        }
+        inner = constantValue(right, &constant) ? left : constantValue(left, &constant) ? right : NULL;
+        leaCost = 1;
+        if (inner && address(inner, &first, &second, &indexFirst, &scale)) {
+            SelectionRule pair = operandRule(first, second, false, true, &leaCost);
+            if (pair == rule_operand)
+                leaCost++;
+            if (leaCost < selection->cost) {
+                selection->rule = rule_lea_displacement;
+                selection->cost = leaCost;
+            }
+        }
+    } else if (node->kind == kind_times) {
+        inner = constantValue(right, &constant) ? left : constantValue(left, &constant) ? right : NULL;
+        if (inner) {
+            if (log2Exact(constant) >= 0 && select(inner).cost + 1 < selection->cost) {
+                selection->rule = rule_shift;
+                selection->cost = select(inner).cost + 1;
+            } else if ((constant == 3 || constant == 5 || constant == 9) && select(inner).cost + 1 < selection->cost) {
+                selection->rule = rule_multiply_lea;
+                selection->cost = select(inner).cost + 1;
+            }
+        }
+    } else if (node->kind == kind_divide && constantValue(right, &constant) && constant != INT_MIN) {
+        int absolute = constant < 0 ? -constant : constant;
+        if (log2Exact(absolute) >= 1) {
+            selection->rule = rule_divide_shift;
+            selection->cost = select(left).cost + 4 + (constant < 0 ? 1 : 0);
+        } else if (absolute >= 3) {
+            selection->rule = rule_divide_magic;
+            selection->cost = select(left).cost + COST_MULTIPLY + 6;
+        }
+    }
+}
+
+std::string CodeGenerator::operand(ExpressionNode* node, std::string reg) {
+    int value;
+    if (constantValue(node, &value))
+        return "$" + std::to_string(value);
+    if (node->kind == kind_memberaccess) {
+        MemberAccessNode* access = static_cast<MemberAccessNode*>(node);
+        loadVariable(access->identifier_1, reg);
+        return memberAddress(access->identifier_2, reg);
+    }
+    IdentifierNode* variable = static_cast<VariableNode*>(node)->identifier;
+    if (variable->binding.kind == binding_local)
+        return std::to_string(variable->binding.offset) + "(%ebp)";
+    emit("mov 8(%ebp), " + reg);
+    return memberAddress(variable, reg);
+}
+
+std::string CodeGenerator::operands(ExpressionNode* left, ExpressionNode* right, SelectionRule rule, bool commutative) {
+    if (rule == rule_operand) {
+        reduce(left);
+        return operand(right, "%ecx");
+    }
+    if (rule == rule_swapped) {
+        reduce(right);
+        if (commutative)
+            return operand(left, "%ecx");
+        emit("mov %eax, %ecx");
+        emit("mov " + operand(left, "%eax") + ", %eax");
+        return "%ecx";
+    }
+    reduce(left);
+    emit("push %eax");
+    reduce(right);
+    emit("mov %eax, %ecx");
+    emit("pop %eax");
+    return "%ecx";
+}
+
+std::string CodeGenerator::compare(ExpressionNode* node) {
+    ExpressionNode *left, *right;
+    binaryOperands(node, &left, &right);
+    emit("cmp " + operands(left, right, select(node).rule, node->kind == kind_equal) + ", %eax");
+    if (node->kind == kind_greater)
+        return "g";
+    if (node->kind == kind_greaterequal)
+        return "ge";
+    return "e";
+}
+
+void CodeGenerator::reduce(ExpressionNode* node) {
+    const Selection& selection = select(node);
+    ExpressionNode *left, *right, *first, *second;
+    bool indexFirst;
+    int constant, scale;
+    std::string registers;
+
+    switch (selection.rule) {
+    case rule_call:
+        if (node->kind == kind_methodcall)
+            callMethod(static_cast<MethodCallNode*>(node));
+        else if (node->kind == kind_new)
+            allocate(static_cast<NewNode*>(node));
+        else if (node->kind == kind_spawn)
+            spawnTask(static_cast<SpawnNode*>(node));
+        else
+            joinTask(static_cast<JoinNode*>(node));
+        return;
+    case rule_constant:
+    case rule_local:
+        emit("mov " + operand(node, "%eax") + ", %eax");
+        return;
+    case rule_member:
+        if (node->kind == kind_variable) {
+            loadVariable(static_cast<VariableNode*>(node)->identifier, "%eax");
+        } else {
+            MemberAccessNode* access = static_cast<MemberAccessNode*>(node);
+            loadVariable(access->identifier_1, "%eax");
+            loadMember(access->identifier_2, "%eax", "%eax");
+        }
+        return;
+    case rule_unary:
+        if (node->kind == kind_not) {
+            reduce(static_cast<NotNode*>(node)->expression);
+            emit("xor $1, %eax");
+        } else {
+            reduce(static_cast<NegationNode*>(node)->expression);
+            emit("neg %eax");
+        }
+        return;
+    default:
+        break;
+    }
+
+    binaryOperands(node, &left, &right);
+    switch (selection.rule) {
+    case rule_lea:
+    case rule_lea_displacement: {
+        std::string displacement;
+        if (selection.rule == rule_lea_displacement) {
+            ExpressionNode* inner = constantValue(right, &constant) ? left : right;
+            constantValue(inner == left ? right : left, &constant);
+            displacement = std::to_string(constant);
+            address(inner, &first, &second, &indexFirst, &scale);
+        } else {
+            address(node, &first, &second, &indexFirst, &scale);
+        }
+        int cost = 0;
+        std::string source = operands(first, second, operandRule(first, second, false, true, &cost), false);
+        if (source != "%ecx")
+            emit("mov " + source + ", %ecx");
+        registers = indexFirst ? "(%ecx,%eax," : "(%eax,%ecx,";
+        emit("lea " + displacement + registers + std::to_string(scale) + "), %eax");
+        return;
+    }
+    case rule_shift:
+    case rule_multiply_lea: {
+        ExpressionNode* inner = constantValue(right, &constant) ? left : right;
+        constantValue(inner == left ? right : left, &constant);
+        reduce(inner);
+        if (selection.rule == rule_multiply_lea)
+            emit("lea (%eax,%eax," + std::to_string(constant - 1) + "), %eax");
+        else if (constant > 1)
+            emit("shl $" + std::to_string(log2Exact(constant)) + ", %eax");
+        return;
+    }
+    case rule_divide_shift: {
+        // Rounds towards zero by adding divisor - 1 to negative
+        // dividends before shifting
+        constantValue(right, &constant);
+        int absolute = constant < 0 ? -constant : constant;
+        reduce(left);
+        emit("cdq");
+        emit("and $" + std::to_string(absolute - 1) + ", %edx");
+        emit("add %edx, %eax");
+        emit("sar $" + std::to_string(log2Exact(absolute)) + ", %eax");
+        if (constant < 0)
+            emit("neg %eax");
+        return;
+    }
+    case rule_divide_magic: {
+        // The high word of the product, corrected and shifted, is the
+        // quotient rounded down; adding its sign bit rounds it
+        // towards zero
+        int multiplier, shift;
+        constantValue(right, &constant);
+        magicNumber(constant, &multiplier, &shift);
+        bool add = constant > 0 && multiplier < 0, subtract = constant < 0 && multiplier > 0;
+        reduce(left);
+        if (add || subtract)
+            emit("mov %eax, %ecx");
+        emit("mov $" + std::to_string(multiplier) + ", %edx");
+        emit("imul %edx");
+        if (add)
+            emit("add %ecx, %edx");
+        if (subtract)
+            emit("sub %ecx, %edx");
+        if (shift > 0)
+            emit("sar $" + std::to_string(shift) + ", %edx");
+        emit("mov %edx, %eax");
+        emit("shr $31, %eax");
+        emit("add %edx, %eax");
+        return;
+    }
+    default:
+        break;
+    }
+
+    if (node->kind == kind_greater || node->kind == kind_greaterequal || node->kind == kind_equal) {
+        emit("set" + compare(node) + " %al");
+        emit("movzbl %al, %eax");
+        return;
+    }
+    bool commutative = node->kind != kind_minus && node->kind != kind_divide;
+    std::string source = operands(left, right, selection.rule, commutative);
+    switch (node->kind) {
+    case kind_plus: emit("add " + source + ", %eax"); break;
+    case kind_minus: emit("sub " + source + ", %eax"); break;
+    case kind_times: emit("imul " + source + ", %eax"); break;
+    case kind_and: emit("and " + source + ", %eax"); break;
+    case kind_or: emit("or " + source + ", %eax"); break;
+    default:
+        emit("cdq");
+        emit("idivl " + source);
+        break;
+    }
+}
+
+void CodeGenerator::evaluate(ExpressionNode* node) {
+    select(node);
+    reduce(node);
+}
+
+void CodeGenerator::pushValue(ExpressionNode* node) {
+    if (operandKind(node) != operand_none) {
+        emit("push " + operand(node, "%eax"));
+    } else {
+        evaluate(node);
+        emit("push %eax");
+    }
+}
+
+bool CodeGenerator::assignInPlace(AssignmentNode* node) {
+    IdentifierNode* target = node->identifier_1;
+    ExpressionNode *left, *right, *other;
+    if (node->identifier_2 || target->binding.kind != binding_local ||
+        (node->expression->kind != kind_plus && node->expression->kind != kind_minus))
+        return false;
+    binaryOperands(node->expression, &left, &right);
+
+    bool leftIsTarget = left->kind == kind_variable &&
+                        static_cast<VariableNode*>(left)->identifier->binding.kind == binding_local &&
+                        static_cast<VariableNode*>(left)->identifier->binding.offset == target->binding.offset;
+    bool rightIsTarget = right->kind == kind_variable &&
+                         static_cast<VariableNode*>(right)->identifier->binding.kind == binding_local &&
+                         static_cast<VariableNode*>(right)->identifier->binding.offset == target->binding.offset;
+    if (leftIsTarget)
+        other = right;
+    else if (rightIsTarget && node->expression->kind == kind_plus)
+        other = left;
+    else
+        return false;
+
+    std::string instruction = node->expression->kind == kind_plus ? "add" : "sub";
+    std::string destination = std::to_string(target->binding.offset) + "(%ebp)";
+    int value;
+    if (constantValue(other, &value)) {
+        emit(instruction + "l $" + std::to_string(value) + ", " + destination);
+    } else {
+        evaluate(other);
+        emit(instruction + " %eax, " + destination);
+    }
+    return true;
 }
@@ -4,6 +4,38 @@
 #include "ast.hpp"
 #include "typecheck.hpp"
 
+#include <set>
+
+// The rules by which the instruction selector (see the end of
+// codegeneration.cpp) computes an expression into %eax
+typedef enum {
+  rule_call,             // a call, new, spawn or join expression
+  rule_constant,         // mov $k, %eax
+  rule_local,            // mov offset(%ebp), %eax
+  rule_member,           // load the object, then the member
+  rule_operand,          // the left operand into %eax, op right, %eax
+  rule_swapped,          // the right operand first, then op left
+  rule_spill,            // the left operand pushed while the right
+                         // one is computed
+  rule_lea,              // lea (base,index,scale), %eax
+  rule_lea_displacement, // lea k(base,index,scale), %eax
+  rule_shift,            // multiplication by a power of two
+  rule_multiply_lea,     // multiplication by 3, 5 or 9
+  rule_divide_shift,     // division by a power of two
+  rule_divide_magic,     // division by a multiplication with the
+                         // reciprocal of a constant
+  rule_unary             // not or negation
+} SelectionRule;
+
+// The cheapest rule for an expression, and what it costs
+typedef struct selection {
+  SelectionRule rule;
+  int cost;
+  // No calls or new expressions (so nothing it does can change a
+  // member)
+  bool pure;
+} Selection;
+
 // This defines the CodeGenerator visitor, which will visit
 // the AST and generate x86 assembly code. You will do all
 // your implementation of the code generation in the visitor
@@ -11,39 +43,153 @@
 //
 // NOTE: This visitor will visit _after_ the TypeCheck visitor,
 // which means the symbol table will already be completely
-// constructed when generating code. You will need to use
-// the symbol table when generating code.
-class CodeGenerator : public Visitor {
+// constructed when generating code. The names in the AST are
+// bound to what they refer to by then (see binding.hpp), so
+// the code is generated from the bindings, without looking
+// anything up in the symbol table. Within the tree the visitor
+// is dispatched statically (see StaticVisitor in ast.hpp).
+class CodeGenerator : public Visitor, public StaticVisitor<CodeGenerator> {
 private:
   int currentLabel;
+  // The last source position marked with .loc
+  SourceLocation lastLocation;
+  // Set when the return statement of the current method ended
+  // with a jump to the method it calls, so no epilogue is needed
+  bool endedWithTailCall;
+
+  // Prints one instruction, a label, or a directive
+  void emit(std::string instruction);
+  void label(std::string name);
+  void directive(std::string text);
+
+  // Loads the value of a local, parameter or member of "this"
+  // into a register
+  void loadVariable(IdentifierNode* name, std::string reg);
+
+  // The address of a member of the object in base, and the code
+  // that loads it into a register or stores %eax into it. Booleans
+  // packed by --pack-objects take one byte, other members a word.
+  std::string memberAddress(IdentifierNode* member, std::string base);
+  void loadMember(IdentifierNode* member, std::string base, std::string reg);
+  void storeMember(IdentifierNode* member, std::string base);
+
+  // Pushes the arguments of a call (right to left) and returns
+  // how many were pushed
+  int pushArguments(std::list<ExpressionNode*>* arguments);
+
+  // Generate a call, new, spawn or join expression, leaving its
+  // result in %eax
+  void callMethod(MethodCallNode* node);
+  void allocate(NewNode* node);
+  void spawnTask(SpawnNode* node);
+  void joinTask(JoinNode* node);
+
+  // The methods spawned in the current method, by label, with the
+  // number of words (arguments and "this") they take, and those whose
+  // task entry was generated already
+  std::map<std::string, int> spawnedMethods;
+  std::set<std::string> taskEntries;
+  // Generates the function that runs a spawned method for the task
+  // runtime (see tester.c), taking the words of the call
+  void taskEntry(std::string label, int words);
+
+  // Generates a returned call as a jump, if the callee's
+  // arguments fit where the current method's arguments are.
+  // Returns false (generating nothing) if they do not.
+  bool tailCall(MethodCallNode* node);
+
+  // Generate the start and end of a function, with its symbol
+  // information and call frame information, and the code that
+  // tears its frame down before a ret or a tail call jump
+  void beginFunction(std::string name, SourceLocation where);
+  void endFunction(std::string name);
+  void leaveFrame();
+  // Marks the following code as coming from a source position
+  void location(SourceLocation where);
+
+  // Generates each statement of a list (which may be NULL)
+  void visitStatements(std::list<StatementNode*>* statements);
+
+  // Counts an execution of a profile site, when instrumenting
+  void countSite(ASTNode* node, int which);
+  // Generates the function that writes the profile at exit
+  void profileDump();
+  // Aligns the top of a loop body, unless it is known to be cold
+  void alignLoop(ASTNode* node);
+  // Jumps to target if the condition is true (or false)
+  void jumpIf(ExpressionNode* condition, std::string target, bool whenTrue);
+
+  // The instruction selector, used from -O1 up. select labels an
+  // expression with its cheapest rule, and reduce generates it.
+  std::map<ExpressionNode*, Selection> selections;
+  const Selection& select(ExpressionNode* node);
+  void selectBinary(ExpressionNode* node, Selection* selection);
+  SelectionRule operandRule(ExpressionNode* left, ExpressionNode* right, bool commutative, bool immediate, int* cost);
+  void reduce(ExpressionNode* node);
+  // Emits the code that puts the left operand in %eax and returns
+  // the right one, as an instruction operand
+  std::string operands(ExpressionNode* left, ExpressionNode* right, SelectionRule rule, bool commutative);
+  // Returns an expression as an instruction operand, loading the
+  // object of a member into reg first
+  std::string operand(ExpressionNode* node, std::string reg);
+  // Computes an expression into %eax, or pushes it
+  void evaluate(ExpressionNode* node);
+  void pushValue(ExpressionNode* node);
+  // Compares the operands of a comparison and returns the condition
+  // code (g, ge or e) under which it holds
+  std::string compare(ExpressionNode* node);
+  // Generates x = x + e or x = x - e, for a local x, as a single
+  // add or sub to x. Returns false (generating nothing) otherwise.
+  bool assignInPlace(AssignmentNode* node);
 public:
-  // This member is the ClassTable pointer for the symbol
-  // table. The main file sets this appropraitely to the
-  // root of the symbol table constructed by the TypeCheck
-  // visitor.
-  //
-  // NOTE: Remember that it is a _pointer_.
-  ClassTable* classTable;
-  
   // These members represent the current class and method
   // names (which class we are inside and which method we are
-  // inside at any point in the code generation) as well
-  // as the class info and method info for the current class
-  // and method. This allows us to get information about
-  // variables, members, and other class methods very easily.
+  // inside at any point in the code generation), and the
+  // number of parameters of the current method.
   //
   // NOTE: These are not automatically set, you will need to
   // maintain/set them as your visitor visits the AST.
   std::string currentClassName;
   std::string currentMethodName;
-  ClassInfo currentClassInfo;
-  MethodInfo currentMethodInfo;
+  int currentParameterCount;
   
   int nextLabel() {
     return currentLabel++;
   }
   
-  CodeGenerator() : currentLabel(0) {}
+  // When set, a call whose result is returned reuses the
+  // current frame and is made with a jump (set from -O1 up).
+  bool tailCalls;
+  // When set, expressions are generated by the instruction selector
+  // instead of the stack machine (set from -O1 up)
+  bool selectInstructions;
+  // When set, the program counts how often each profile site runs
+  // and writes the counts to lang.profile when it exits
+  bool instrument;
+  // When set, the code is marked with the lines of sourceName
+  bool debugInfo;
+  std::string sourceName;
+  // When set, every method is a global symbol, so that the files of
+  // a program, each generated on its own, link together
+  bool globalSymbols;
+
+  // Where the assembly goes, and how many instructions were written
+  // to it (generators may run on several threads at once, so each
+  // counts its own)
+  std::ostream* out;
+  long instructionsEmitted;
+
+  // Generate what comes before and after the classes of a program:
+  // its data, and the profile of an instrumented one, which goes in
+  // the file with Main. visitProgramNode generates the classes in
+  // between; a program may also be generated one class at a time,
+  // with visitClassNode.
+  void beginProgram(bool hasMain);
+  void endProgram(bool hasMain);
+
+  CodeGenerator() : currentLabel(0), lastLocation(0), endedWithTailCall(false), tailCalls(false),
+                    selectInstructions(false), instrument(false), debugInfo(false), globalSymbols(false),
+                    out(&std::cout), instructionsEmitted(0) {}
   
   // All the visitor functions. You will need to write
   // appropriate implementation in codegeneration.cpp.
@@ -77,9 +223,12 @@ public:
   virtual void visitIntegerLiteralNode(IntegerLiteralNode* node);
   virtual void visitBooleanLiteralNode(BooleanLiteralNode* node);
   virtual void visitNewNode(NewNode* node);
+  virtual void visitSpawnNode(SpawnNode* node);
+  virtual void visitJoinNode(JoinNode* node);
   virtual void visitIntegerTypeNode(IntegerTypeNode* node);
   virtual void visitBooleanTypeNode(BooleanTypeNode* node);
   virtual void visitObjectTypeNode(ObjectTypeNode* node);
+  virtual void visitTaskTypeNode(TaskTypeNode* node);
   virtual void visitNoneNode(NoneNode* node);
   virtual void visitIdentifierNode(IdentifierNode* node);
   virtual void visitIntegerNode(IntegerNode* node);
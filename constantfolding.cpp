@@ -0,0 +1,113 @@
+#include "constantfolding.hpp"
+
+#include <climits>
+
+bool isLiteral(ExpressionNode* node, int* value) {
+  if (IntegerLiteralNode* literal = dynamic_cast<IntegerLiteralNode*>(node)) {
+    *value = literal->integer->value;
+    return true;
+  }
+  if (BooleanLiteralNode* literal = dynamic_cast<BooleanLiteralNode*>(node)) {
+    *value = literal->integer->value;
+    return true;
+  }
+  return false;
+}
+
+ExpressionNode* ConstantFolding::integerLiteral(int value) {
+  IntegerLiteralNode* node = new IntegerLiteralNode(new IntegerNode(value));
+  node->basetype = bt_integer;
+  return node;
+}
+
+ExpressionNode* ConstantFolding::booleanLiteral(bool value) {
+  BooleanLiteralNode* node = new BooleanLiteralNode(new IntegerNode(value ? 1 : 0));
+  node->basetype = bt_boolean;
+  return node;
+}
+
+void ConstantFolding::run(ProgramNode* program, ClassTable* classTable) {
+  program->accept(this);
+}
+
+// Arithmetic is done on unsigned values so that overflow wraps the
+// way it does in the generated code, instead of being undefined.
+
+void ConstantFolding::visitPlusNode(PlusNode* node) {
+  ExpressionRewriter::visitPlusNode(node);
+  int a, b;
+  if (isLiteral(node->expression_1, &a) && isLiteral(node->expression_2, &b))
+    result = integerLiteral((int)((unsigned)a + (unsigned)b));
+}
+
+void ConstantFolding::visitMinusNode(MinusNode* node) {
+  ExpressionRewriter::visitMinusNode(node);
+  int a, b;
+  if (isLiteral(node->expression_1, &a) && isLiteral(node->expression_2, &b))
+    result = integerLiteral((int)((unsigned)a - (unsigned)b));
+}
+
+void ConstantFolding::visitTimesNode(TimesNode* node) {
+  ExpressionRewriter::visitTimesNode(node);
+  int a, b;
+  if (isLiteral(node->expression_1, &a) && isLiteral(node->expression_2, &b))
+    result = integerLiteral((int)((unsigned)a * (unsigned)b));
+}
+
+void ConstantFolding::visitDivideNode(DivideNode* node) {
+  ExpressionRewriter::visitDivideNode(node);
+  int a, b;
+  if (isLiteral(node->expression_1, &a) && isLiteral(node->expression_2, &b)) {
+    if (b != 0 && !(a == INT_MIN && b == -1))
+      result = integerLiteral(a / b);
+  }
+}
+
+void ConstantFolding::visitGreaterNode(GreaterNode* node) {
+  ExpressionRewriter::visitGreaterNode(node);
+  int a, b;
+  if (isLiteral(node->expression_1, &a) && isLiteral(node->expression_2, &b))
+    result = booleanLiteral(a > b);
+}
+
+void ConstantFolding::visitGreaterEqualNode(GreaterEqualNode* node) {
+  ExpressionRewriter::visitGreaterEqualNode(node);
+  int a, b;
+  if (isLiteral(node->expression_1, &a) && isLiteral(node->expression_2, &b))
+    result = booleanLiteral(a >= b);
+}
+
+void ConstantFolding::visitEqualNode(EqualNode* node) {
+  ExpressionRewriter::visitEqualNode(node);
+  int a, b;
+  if (isLiteral(node->expression_1, &a) && isLiteral(node->expression_2, &b))
+    result = booleanLiteral(a == b);
+}
+
+void ConstantFolding::visitAndNode(AndNode* node) {
+  ExpressionRewriter::visitAndNode(node);
+  int a, b;
+  if (isLiteral(node->expression_1, &a) && isLiteral(node->expression_2, &b))
+    result = booleanLiteral(a && b);
+}
+
+void ConstantFolding::visitOrNode(OrNode* node) {
+  ExpressionRewriter::visitOrNode(node);
+  int a, b;
+  if (isLiteral(node->expression_1, &a) && isLiteral(node->expression_2, &b))
+    result = booleanLiteral(a || b);
+}
+
+void ConstantFolding::visitNotNode(NotNode* node) {
+  ExpressionRewriter::visitNotNode(node);
+  int a;
+  if (isLiteral(node->expression, &a))
+    result = booleanLiteral(!a);
+}
+
+void ConstantFolding::visitNegationNode(NegationNode* node) {
+  ExpressionRewriter::visitNegationNode(node);
+  int a;
+  if (isLiteral(node->expression, &a))
+    result = integerLiteral((int)(0u - (unsigned)a));
+}
@@ -0,0 +1,37 @@
+#ifndef __CONSTANTFOLDING_HPP
+#define __CONSTANTFOLDING_HPP
+
+#include "passmanager.hpp"
+
+// This pass replaces arithmetic, comparisons and boolean operators
+// whose operands are all literals with a single literal, following
+// the same 32-bit wrapping rules as the generated x86 code. Division
+// by zero (and INT_MIN / -1) is left alone so it still traps at run
+// time.
+class ConstantFolding : public Pass, public ExpressionRewriter {
+private:
+  ExpressionNode* integerLiteral(int value);
+  ExpressionNode* booleanLiteral(bool value);
+
+public:
+  virtual std::string name() { return "constfold"; }
+  virtual void run(ProgramNode* program, ClassTable* classTable);
+
+  virtual void visitPlusNode(PlusNode* node);
+  virtual void visitMinusNode(MinusNode* node);
+  virtual void visitTimesNode(TimesNode* node);
+  virtual void visitDivideNode(DivideNode* node);
+  virtual void visitGreaterNode(GreaterNode* node);
+  virtual void visitGreaterEqualNode(GreaterEqualNode* node);
+  virtual void visitEqualNode(EqualNode* node);
+  virtual void visitAndNode(AndNode* node);
+  virtual void visitOrNode(OrNode* node);
+  virtual void visitNotNode(NotNode* node);
+  virtual void visitNegationNode(NegationNode* node);
+};
+
+// Returns true (and the value) if an expression is an integer or
+// boolean literal. Booleans are 1 for true and 0 for false.
+bool isLiteral(ExpressionNode* node, int* value);
+
+#endif
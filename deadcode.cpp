@@ -0,0 +1,256 @@
+#include "deadcode.hpp"
+#include "constantfolding.hpp"
+
+#include <algorithm>
+
+std::vector<std::string> DeadCodeElimination::dependencies() {
+  // Conditions are only known once constants are folded
+  std::vector<std::string> names;
+  names.push_back("constfold");
+  return names;
+}
+
+void DeadCodeElimination::run(ProgramNode* program, ClassTable* classTable) {
+  for (std::list<ClassNode*>::iterator c = program->class_list->begin(); c != program->class_list->end(); c++) {
+    for (std::list<MethodNode*>::iterator m = (*c)->method_list->begin(); m != (*c)->method_list->end(); m++) {
+      scope = MethodScope(classTable, (*c)->identifier_1->name, (*m)->identifier->name);
+      MethodBodyNode* body = (*m)->methodbody;
+      prune(body->statement_list);
+
+      std::set<std::string> live;
+      if (body->returnstatement)
+        uses(body->returnstatement->expression, live);
+      sweep(body->statement_list, live, true);
+
+      removeUnusedLocals(body);
+    }
+  }
+}
+
+// Replaces ifs and loops with literal conditions by the code that
+// actually runs.
+void DeadCodeElimination::prune(std::list<StatementNode*>* statements) {
+  if (!statements)
+    return;
+  for (std::list<StatementNode*>::iterator it = statements->begin(); it != statements->end();) {
+    int value;
+    if (IfElseNode* node = dynamic_cast<IfElseNode*>(*it)) {
+      prune(node->statement_list_1);
+      prune(node->statement_list_2);
+      if (isLiteral(node->expression, &value)) {
+        std::list<StatementNode*>* taken = value ? node->statement_list_1 : node->statement_list_2;
+        if (taken)
+          statements->splice(it, *taken);
+        it = statements->erase(it);
+        continue;
+      }
+    } else if (WhileNode* node = dynamic_cast<WhileNode*>(*it)) {
+      prune(node->statement_list);
+      if (isLiteral(node->expression, &value) && !value) {
+        it = statements->erase(it);
+        continue;
+      }
+    } else if (DoWhileNode* node = dynamic_cast<DoWhileNode*>(*it)) {
+      prune(node->statement_list);
+      if (isLiteral(node->expression, &value) && !value) {
+        if (node->statement_list)
+          statements->splice(it, *node->statement_list);
+        it = statements->erase(it);
+        continue;
+      }
+    }
+    it++;
+  }
+}
+
+// Adds the locals an expression reads to the live set
+void DeadCodeElimination::uses(ExpressionNode* node, std::set<std::string>& live) {
+  NameCollector collector;
+  collector.collect(node);
+  for (std::set<std::string>::iterator it = collector.names.begin(); it != collector.names.end(); it++) {
+    if (scope.isLocal(*it))
+      live.insert(*it);
+  }
+}
+
+// An expression can be dropped if evaluating it has no effect other
+// than computing its value
+bool DeadCodeElimination::isRemovable(ExpressionNode* node) {
+  if (canTrap(node) || dynamic_cast<NewNode*>(node))
+    return false;
+  std::vector<ExpressionNode**> slots = children(node);
+  for (std::vector<ExpressionNode**>::iterator it = slots.begin(); it != slots.end(); it++) {
+    if (!isRemovable(**it))
+      return false;
+  }
+  return true;
+}
+
+// Walks the statements backwards, turning the set of locals live
+// after them into the set live before them. Dead assignments are
+// skipped (as if already removed, so that what they read is not
+// made live), and actually removed if "remove" is set.
+//
+// A loop is live at its head with whatever its condition reads, what
+// is live after it, and what its body needs; the body is walked until
+// that set stops growing, and only then swept for real.
+void DeadCodeElimination::sweep(std::list<StatementNode*>* statements, std::set<std::string>& live, bool remove) {
+  if (!statements)
+    return;
+  for (std::list<StatementNode*>::iterator it = statements->end(); it != statements->begin();) {
+    it--;
+    if (AssignmentNode* node = dynamic_cast<AssignmentNode*>(*it)) {
+      std::string name = node->identifier_1->name;
+      if (node->identifier_2) {
+        uses(node->expression, live);
+        if (scope.isLocal(name))
+          live.insert(name);
+        continue;
+      }
+      if (scope.isLocal(name) && !live.count(name)) {
+        if (isRemovable(node->expression)) {
+          if (remove)
+            it = statements->erase(it);
+          continue;
+        }
+        if (MethodCallNode* call = dynamic_cast<MethodCallNode*>(node->expression)) {
+          if (remove)
+            *it = new CallNode(call);
+          uses(call, live);
+          continue;
+        }
+      }
+      if (scope.isLocal(name))
+        live.erase(name);
+      uses(node->expression, live);
+    } else if (CallNode* node = dynamic_cast<CallNode*>(*it)) {
+      uses(node->methodcall, live);
+    } else if (PrintNode* node = dynamic_cast<PrintNode*>(*it)) {
+      uses(node->expression, live);
+    } else if (IfElseNode* node = dynamic_cast<IfElseNode*>(*it)) {
+      std::set<std::string> first = live;
+      std::set<std::string> second = live;
+      sweep(node->statement_list_1, first, remove);
+      sweep(node->statement_list_2, second, remove);
+      live = first;
+      live.insert(second.begin(), second.end());
+      uses(node->expression, live);
+    } else if (WhileNode* node = dynamic_cast<WhileNode*>(*it)) {
+      std::set<std::string> head = live;
+      uses(node->expression, head);
+      while (true) {
+        std::set<std::string> body = head;
+        sweep(node->statement_list, body, false);
+        unsigned size = head.size();
+        head.insert(body.begin(), body.end());
+        if (head.size() == size)
+          break;
+      }
+      if (remove) {
+        std::set<std::string> body = head;
+        sweep(node->statement_list, body, true);
+      }
+      live = head;
+    } else if (DoWhileNode* node = dynamic_cast<DoWhileNode*>(*it)) {
+      std::set<std::string> head = live;
+      uses(node->expression, head);
+      std::set<std::string> body;
+      while (true) {
+        body = head;
+        sweep(node->statement_list, body, false);
+        unsigned size = head.size();
+        head.insert(body.begin(), body.end());
+        if (head.size() == size)
+          break;
+      }
+      if (remove) {
+        body = head;
+        sweep(node->statement_list, body, true);
+      }
+      live = body;
+    }
+  }
+}
+
+// Drops the locals that the method no longer mentions, from its
+// declarations and its variable table, and packs the others again
+// from -4(%ebp) down.
+void DeadCodeElimination::removeUnusedLocals(MethodBodyNode* body) {
+  NameCollector collector;
+  collector.collect(body->statement_list);
+  if (body->returnstatement)
+    collector.collect(body->returnstatement->expression);
+
+  MethodInfo& info = scope.classTable->find(scope.className)->second.methods->find(scope.methodName)->second;
+  std::vector<std::pair<int, std::string> > locals;
+  for (VariableTable::iterator it = info.variables->begin(); it != info.variables->end();) {
+    if (it->second.offset >= 0) {
+      it++;
+    } else if (!collector.names.count(it->first)) {
+      info.variables->erase(it++);
+    } else {
+      locals.push_back(std::make_pair(-it->second.offset, it->first));
+      it++;
+    }
+  }
+
+  std::sort(locals.begin(), locals.end());
+  info.localsSize = 0;
+  for (std::vector<std::pair<int, std::string> >::iterator it = locals.begin(); it != locals.end(); it++) {
+    VariableInfo& variable = (*info.variables)[it->second];
+    variable.offset = -(info.localsSize + variable.size);
+    info.localsSize += variable.size;
+  }
+
+  if (body->declaration_list) {
+    for (std::list<DeclarationNode*>::iterator d = body->declaration_list->begin(); d != body->declaration_list->end();) {
+      std::list<IdentifierNode*>* names = (*d)->identifier_list;
+      for (std::list<IdentifierNode*>::iterator it = names->begin(); it != names->end();) {
+        if (info.variables->count((*it)->name))
+          it++;
+        else
+          it = names->erase(it);
+      }
+      if (names->empty())
+        d = body->declaration_list->erase(d);
+      else
+        d++;
+    }
+  }
+}
+
+// NameCollector Visitor Functions
+
+void NameCollector::collect(std::list<StatementNode*>* statements) {
+  visitStatements(statements);
+}
+
+void NameCollector::collect(ExpressionNode* expression) {
+  rewrite(expression);
+}
+
+void NameCollector::visitAssignmentNode(AssignmentNode* node) {
+  names.insert(node->identifier_1->name);
+  node->expression = rewrite(node->expression);
+}
+
+void NameCollector::visitCallNode(CallNode* node) {
+  visitMethodCallNode(node->methodcall);
+}
+
+void NameCollector::visitMethodCallNode(MethodCallNode* node) {
+  if (node->identifier_2)
+    names.insert(node->identifier_1->name);
+  rewrite(node->expression_list);
+  result = node;
+}
+
+void NameCollector::visitMemberAccessNode(MemberAccessNode* node) {
+  names.insert(node->identifier_1->name);
+  result = node;
+}
+
+void NameCollector::visitVariableNode(VariableNode* node) {
+  names.insert(node->identifier->name);
+  result = node;
+}
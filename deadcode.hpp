@@ -0,0 +1,52 @@
+#ifndef __DEADCODE_HPP
+#define __DEADCODE_HPP
+
+#include "passmanager.hpp"
+#include "analysis.hpp"
+
+// This visitor collects every name that code reads or assigns:
+// variables, the objects of member accesses and calls, and the
+// targets of assignments.
+class NameCollector : public ExpressionRewriter {
+public:
+  std::set<std::string> names;
+
+  void collect(std::list<StatementNode*>* statements);
+  void collect(ExpressionNode* expression);
+
+  virtual void visitAssignmentNode(AssignmentNode* node);
+  virtual void visitCallNode(CallNode* node);
+  virtual void visitMethodCallNode(MethodCallNode* node);
+  virtual void visitMemberAccessNode(MemberAccessNode* node);
+  virtual void visitVariableNode(VariableNode* node);
+};
+
+// This pass removes code that cannot affect the output:
+//
+// - The branch of an if statement that a literal condition never
+//   takes, and loops whose condition is the literal false (the body
+//   of such a do-while loop runs exactly once).
+// - Assignments to locals and parameters that are not read before
+//   being assigned again (or before the method returns), found with
+//   a backward liveness analysis. The assigned expression is kept if
+//   evaluating it may trap or have effects; a dead assignment of a
+//   call becomes a call statement.
+// - Locals that are no longer used at all, so they take no space in
+//   the frame.
+class DeadCodeElimination : public Pass {
+private:
+  MethodScope scope;
+
+  void prune(std::list<StatementNode*>* statements);
+  void uses(ExpressionNode* node, std::set<std::string>& live);
+  bool isRemovable(ExpressionNode* node);
+  void sweep(std::list<StatementNode*>* statements, std::set<std::string>& live, bool remove);
+  void removeUnusedLocals(MethodBodyNode* body);
+
+public:
+  virtual std::string name() { return "dce"; }
+  virtual std::vector<std::string> dependencies();
+  virtual void run(ProgramNode* program, ClassTable* classTable);
+};
+
+#endif
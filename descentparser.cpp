@@ -0,0 +1,471 @@
+#include "descentparser.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+int yydebug;
+
+// Names of the tokens for syntax errors, as bison prints them
+static const char* tokenName(int type) {
+  switch (type) {
+  case 0: return "end of file";
+  case T_OPENPAREN: return "T_OPENPAREN";
+  case T_CLOSEPAREN: return "T_CLOSEPAREN";
+  case T_OPENBRACE: return "T_OPENBRACE";
+  case T_CLOSEBRACE: return "T_CLOSEBRACE";
+  case T_INTEGER: return "T_INTEGER";
+  case T_BOOLEAN: return "T_BOOLEAN";
+  case T_NEW: return "T_NEW";
+  case T_NONE: return "T_NONE";
+  case T_TASK: return "T_TASK";
+  case T_SPAWN: return "T_SPAWN";
+  case T_JOIN: return "T_JOIN";
+  case T_PERIOD: return "T_PERIOD";
+  case T_COMMA: return "T_COMMA";
+  case T_SEMICOLON: return "T_SEMICOLON";
+  case T_IF: return "T_IF";
+  case T_ELSE: return "T_ELSE";
+  case T_WHILE: return "T_WHILE";
+  case T_DO: return "T_DO";
+  case T_TRUE: return "T_TRUE";
+  case T_FALSE: return "T_FALSE";
+  case T_LAMBDA: return "T_LAMBDA";
+  case T_EXTENDS: return "T_EXTENDS";
+  case T_PRINT: return "T_PRINT";
+  case T_RETURN: return "T_RETURN";
+  case T_IDENT: return "T_IDENT";
+  case T_LITERAL: return "T_LITERAL";
+  case T_OR: return "T_OR";
+  case T_AND: return "T_AND";
+  case T_GREAT: return "T_GREAT";
+  case T_GREATEQ: return "T_GREATEQ";
+  case T_EQ: return "T_EQ";
+  case T_EQUALS: return "T_EQUALS";
+  case T_PLUS: return "T_PLUS";
+  case T_MINUS: return "T_MINUS";
+  case T_MULTIPLY: return "T_MULTIPLY";
+  case T_DIVIDE: return "T_DIVIDE";
+  case T_NOT: return "T_NOT";
+  default: return "invalid token";
+  }
+}
+
+// The precedence of a binary operator (higher binds tighter), or 0 if
+// the token is not one. All of them are left associative. Unary not,
+// minus and join bind tighter than any of them.
+static int binaryPrecedence(int type) {
+  switch (type) {
+  case T_OR: return 1;
+  case T_AND: return 2;
+  case T_GREAT: case T_GREATEQ: case T_EQUALS: return 3;
+  case T_PLUS: case T_MINUS: return 4;
+  case T_MULTIPLY: case T_DIVIDE: return 5;
+  default: return 0;
+  }
+}
+
+ProgramNode* parse(FILE* file, const char* name, ClassHandler onClass) {
+  void* scanner = openScanner(file, name);
+  DescentParser parser(scanner, onClass);
+  ProgramNode* program = parser.parseProgram();
+  closeScanner(scanner);
+  return program;
+}
+
+// Tokens are read from the lexer only when the parser looks at them,
+// so a lexical error after a syntax error is not reported first. The
+// lexer sets no position for the end of the file, which is left where
+// the last thing it read ended, as in the bison parser.
+void DescentParser::read(unsigned ahead) {
+  while (buffered <= ahead) {
+    Token& token = buffer[(first + buffered) % PARSER_LOOKAHEAD];
+    token.type = yylex(&token.value, &position, scanner);
+    token.location = makeLocation(position.first_line, position.first_column);
+    buffered++;
+  }
+}
+
+const Token& DescentParser::expect(int type) {
+  if (!at(type))
+    syntaxError(type);
+  return next();
+}
+
+// Reports the token the parser is looking at as unexpected; expected
+// is the one token that could have come instead, or 0
+void DescentParser::syntaxError(int expected) {
+  std::string message = std::string("syntax error, unexpected ") + tokenName(peek().type);
+  if (expected)
+    message = message + ", expecting " + tokenName(expected);
+  YYLTYPE position;
+  position.first_line = locationLine(peek().location);
+  position.first_column = locationColumn(peek().location);
+  parseError(&position, scanner, message.c_str());
+}
+
+ProgramNode* DescentParser::parseProgram() {
+  SourceLocation location = peek().location;
+  std::list<ClassNode*>* classes = new std::list<ClassNode*>();
+  do {
+    ClassNode* node = parseClass();
+    if (onClass)
+      onClass(node);
+    else
+      classes->push_back(node);
+  } while (!at(0));
+  ProgramNode* program = new ProgramNode(classes);
+  program->location = location;
+  return program;
+}
+
+// Members come before methods; a member starts with its type, so
+// "Name name" is a member and "Name(" a method (see atDeclaration)
+ClassNode* DescentParser::parseClass() {
+  SourceLocation location = peek().location;
+  IdentifierNode* name = expect(T_IDENT).value.identifier_ptr;
+  IdentifierNode* superclass = NULL;
+  if (at(T_EXTENDS)) {
+    next();
+    superclass = expect(T_IDENT).value.identifier_ptr;
+  }
+  expect(T_OPENBRACE);
+  std::list<DeclarationNode*>* members = new std::list<DeclarationNode*>();
+  while (atDeclaration())
+    members->push_back(parseMember());
+  std::list<MethodNode*>* methods = new std::list<MethodNode*>();
+  while (at(T_IDENT))
+    methods->push_back(parseMethod());
+  expect(T_CLOSEBRACE);
+  ClassNode* node = new ClassNode(name, superclass, members, methods);
+  node->location = location;
+  return node;
+}
+
+// Members are declared one per declaration
+DeclarationNode* DescentParser::parseMember() {
+  SourceLocation location = peek().location;
+  TypeNode* type = parseType();
+  std::list<IdentifierNode*>* names = new std::list<IdentifierNode*>();
+  names->push_back(expect(T_IDENT).value.identifier_ptr);
+  expect(T_SEMICOLON);
+  DeclarationNode* node = new DeclarationNode(type, names);
+  node->location = location;
+  return node;
+}
+
+MethodNode* DescentParser::parseMethod() {
+  SourceLocation location = peek().location;
+  IdentifierNode* name = expect(T_IDENT).value.identifier_ptr;
+  expect(T_OPENPAREN);
+  std::list<ParameterNode*>* parameters = new std::list<ParameterNode*>();
+  if (!at(T_CLOSEPAREN)) {
+    parameters->push_back(parseParameter());
+    while (at(T_COMMA)) {
+      next();
+      parameters->push_back(parseParameter());
+    }
+  }
+  expect(T_CLOSEPAREN);
+  expect(T_LAMBDA);
+  TypeNode* returnType = parseReturnType();
+  expect(T_OPENBRACE);
+  MethodBodyNode* body = parseBody();
+  expect(T_CLOSEBRACE);
+  MethodNode* node = new MethodNode(name, parameters, returnType, body);
+  node->location = location;
+  return node;
+}
+
+ParameterNode* DescentParser::parseParameter() {
+  SourceLocation location = peek().location;
+  TypeNode* type = parseType();
+  ParameterNode* node = new ParameterNode(type, expect(T_IDENT).value.identifier_ptr);
+  node->location = location;
+  return node;
+}
+
+// The body starts with its list of declarations, which bison places at
+// the end of the token before it (the opening brace, which is one
+// character long) even when it is not empty, since the list is built
+// left recursively from an empty one
+MethodBodyNode* DescentParser::parseBody() {
+  SourceLocation location = previous.location;
+  std::list<DeclarationNode*>* declarations = new std::list<DeclarationNode*>();
+  while (atDeclaration())
+    declarations->push_back(parseDeclaration());
+  std::list<StatementNode*>* statements = new std::list<StatementNode*>();
+  while (atStatement())
+    statements->push_back(parseStatement());
+  ReturnStatementNode* returnStatement = NULL;
+  if (at(T_RETURN)) {
+    SourceLocation returnLocation = next().location;
+    returnStatement = new ReturnStatementNode(parseExpression());
+    returnStatement->location = returnLocation;
+    expect(T_SEMICOLON);
+  }
+  MethodBodyNode* node = new MethodBodyNode(declarations, statements, returnStatement);
+  node->location = location;
+  return node;
+}
+
+// A declaration starts with a type, and a statement with a keyword or
+// a name that is not followed by another name
+bool DescentParser::atDeclaration() {
+  return at(T_INTEGER) || at(T_BOOLEAN) || at(T_TASK) || (at(T_IDENT) && at(T_IDENT, 1));
+}
+
+DeclarationNode* DescentParser::parseDeclaration() {
+  SourceLocation location = peek().location;
+  TypeNode* type = parseType();
+  std::list<IdentifierNode*>* names = new std::list<IdentifierNode*>();
+  names->push_back(expect(T_IDENT).value.identifier_ptr);
+  while (at(T_COMMA)) {
+    next();
+    names->push_back(expect(T_IDENT).value.identifier_ptr);
+  }
+  expect(T_SEMICOLON);
+  DeclarationNode* node = new DeclarationNode(type, names);
+  node->location = location;
+  return node;
+}
+
+bool DescentParser::atStatement() {
+  return at(T_IDENT) || at(T_IF) || at(T_WHILE) || at(T_DO) || at(T_PRINT);
+}
+
+StatementNode* DescentParser::parseStatement() {
+  Token start = next();
+  StatementNode* node = NULL;
+  switch (start.type) {
+  case T_IDENT:
+    if (at(T_EQ)) {
+      next();
+      node = new AssignmentNode(start.value.identifier_ptr, NULL, parseExpression());
+    } else if (at(T_PERIOD)) {
+      next();
+      IdentifierNode* member = expect(T_IDENT).value.identifier_ptr;
+      if (at(T_EQ)) {
+        next();
+        node = new AssignmentNode(start.value.identifier_ptr, member, parseExpression());
+      } else {
+        node = new CallNode(parseMethodCall(start, member));
+      }
+    } else {
+      node = new CallNode(parseMethodCall(start, NULL));
+    }
+    expect(T_SEMICOLON);
+    break;
+  case T_IF: {
+    ExpressionNode* condition = parseExpression();
+    std::list<StatementNode*>* thenBlock = parseBlock();
+    std::list<StatementNode*>* elseBlock = NULL;
+    if (at(T_ELSE)) {
+      next();
+      elseBlock = parseBlock();
+    }
+    node = new IfElseNode(condition, thenBlock, elseBlock);
+    break;
+  }
+  case T_WHILE: {
+    ExpressionNode* condition = parseExpression();
+    node = new WhileNode(condition, parseBlock());
+    break;
+  }
+  case T_DO: {
+    std::list<StatementNode*>* body = parseBlock();
+    expect(T_WHILE);
+    expect(T_OPENPAREN);
+    node = new DoWhileNode(body, parseExpression());
+    expect(T_CLOSEPAREN);
+    expect(T_SEMICOLON);
+    break;
+  }
+  case T_PRINT:
+    node = new PrintNode(parseExpression());
+    expect(T_SEMICOLON);
+    break;
+  }
+  node->location = start.location;
+  return node;
+}
+
+// A block holds at least one statement
+std::list<StatementNode*>* DescentParser::parseBlock() {
+  expect(T_OPENBRACE);
+  std::list<StatementNode*>* statements = new std::list<StatementNode*>();
+  do {
+    if (!atStatement())
+      syntaxError(0);
+    statements->push_back(parseStatement());
+  } while (!at(T_CLOSEBRACE));
+  next();
+  return statements;
+}
+
+TypeNode* DescentParser::parseType() {
+  if (at(T_TASK)) {
+    SourceLocation location = next().location;
+    TaskTypeNode* node = new TaskTypeNode(parseValueType());
+    node->location = location;
+    return node;
+  }
+  return parseValueType();
+}
+
+TypeNode* DescentParser::parseValueType() {
+  if (!at(T_INTEGER) && !at(T_BOOLEAN) && !at(T_IDENT))
+    syntaxError(0);
+  const Token& token = next();
+  TypeNode* node;
+  switch (token.type) {
+  case T_INTEGER:
+    node = new IntegerTypeNode();
+    break;
+  case T_BOOLEAN:
+    node = new BooleanTypeNode();
+    break;
+  default:
+    node = new ObjectTypeNode(token.value.identifier_ptr);
+    break;
+  }
+  node->location = token.location;
+  return node;
+}
+
+TypeNode* DescentParser::parseReturnType() {
+  if (!at(T_NONE))
+    return parseType();
+  NoneNode* node = new NoneNode();
+  node->location = next().location;
+  return node;
+}
+
+// Parses operators of at least the given precedence: an operator takes
+// as its right operand only operators that bind tighter, which makes
+// them left associative
+ExpressionNode* DescentParser::parseExpression(int minPrecedence) {
+  ExpressionNode* left = parseUnary();
+  for (;;) {
+    int precedence = binaryPrecedence(peek().type);
+    if (precedence == 0 || precedence < minPrecedence)
+      return left;
+    int op = peek().type;
+    SourceLocation location = next().location;
+    ExpressionNode* right = parseExpression(precedence + 1);
+    switch (op) {
+    case T_OR: left = new OrNode(left, right); break;
+    case T_AND: left = new AndNode(left, right); break;
+    case T_GREAT: left = new GreaterNode(left, right); break;
+    case T_GREATEQ: left = new GreaterEqualNode(left, right); break;
+    case T_EQUALS: left = new EqualNode(left, right); break;
+    case T_PLUS: left = new PlusNode(left, right); break;
+    case T_MINUS: left = new MinusNode(left, right); break;
+    case T_MULTIPLY: left = new TimesNode(left, right); break;
+    case T_DIVIDE: left = new DivideNode(left, right); break;
+    }
+    left->location = location;
+  }
+}
+
+ExpressionNode* DescentParser::parseUnary() {
+  if (!at(T_NOT) && !at(T_MINUS) && !at(T_JOIN))
+    return parsePrimary();
+  int op = peek().type;
+  SourceLocation location = next().location;
+  ExpressionNode* operand = parseUnary();
+  ExpressionNode* node;
+  if (op == T_NOT)
+    node = new NotNode(operand);
+  else if (op == T_JOIN)
+    node = new JoinNode(operand);
+  else
+    node = new NegationNode(operand);
+  node->location = location;
+  return node;
+}
+
+ExpressionNode* DescentParser::parsePrimary() {
+  ExpressionNode* node;
+  switch (peek().type) {
+  case T_IDENT: {
+    Token name = next();
+    if (at(T_OPENPAREN))
+      return parseMethodCall(name, NULL);
+    if (!at(T_PERIOD)) {
+      node = new VariableNode(name.value.identifier_ptr);
+      node->location = name.location;
+      return node;
+    }
+    next();
+    IdentifierNode* member = expect(T_IDENT).value.identifier_ptr;
+    if (at(T_OPENPAREN))
+      return parseMethodCall(name, member);
+    node = new MemberAccessNode(name.value.identifier_ptr, member);
+    node->location = name.location;
+    return node;
+  }
+  case T_OPENPAREN:
+    next();
+    node = parseExpression();
+    expect(T_CLOSEPAREN);
+    return node;
+  case T_LITERAL:
+    node = new IntegerLiteralNode(next().value.integer_ptr);
+    break;
+  case T_TRUE:
+  case T_FALSE:
+    node = new BooleanLiteralNode(next().value.integer_ptr);
+    break;
+  case T_NEW: {
+    SourceLocation location = next().location;
+    IdentifierNode* className = expect(T_IDENT).value.identifier_ptr;
+    std::list<ExpressionNode*>* arguments = NULL;
+    if (at(T_OPENPAREN))
+      arguments = parseArguments();
+    node = new NewNode(className, arguments);
+    node->location = location;
+    return node;
+  }
+  case T_SPAWN: {
+    SourceLocation location = next().location;
+    Token name = expect(T_IDENT);
+    IdentifierNode* method = NULL;
+    if (at(T_PERIOD)) {
+      next();
+      method = expect(T_IDENT).value.identifier_ptr;
+    }
+    node = new SpawnNode(parseMethodCall(name, method));
+    node->location = location;
+    return node;
+  }
+  default:
+    syntaxError(0);
+    return NULL;
+  }
+  // The literal is the last token read
+  node->location = previous.location;
+  return node;
+}
+
+// Parses the arguments of a call whose names were already read: the
+// first token, and for "object.name(arguments)", the method name
+MethodCallNode* DescentParser::parseMethodCall(const Token& name, IdentifierNode* method) {
+  MethodCallNode* node = new MethodCallNode(name.value.identifier_ptr, method, parseArguments());
+  node->location = name.location;
+  return node;
+}
+
+std::list<ExpressionNode*>* DescentParser::parseArguments() {
+  expect(T_OPENPAREN);
+  std::list<ExpressionNode*>* arguments = new std::list<ExpressionNode*>();
+  if (!at(T_CLOSEPAREN)) {
+    arguments->push_back(parseExpression());
+    while (at(T_COMMA)) {
+      next();
+      arguments->push_back(parseExpression());
+    }
+  }
+  expect(T_CLOSEPAREN);
+  return arguments;
+}
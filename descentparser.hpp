@@ -0,0 +1,92 @@
+#ifndef __DESCENTPARSER_HPP
+#define __DESCENTPARSER_HPP
+
+#include "ast.hpp"
+#include "parser.hpp"
+
+// One token read from the lexer, with its value and packed position
+typedef struct token {
+  int type;
+  SourceLocation location;
+  YYSTYPE value;
+} Token;
+
+// The most tokens the parser looks ahead (telling a member or local
+// declaration of an object type from a statement or method takes two)
+#define PARSER_LOOKAHEAD 2
+
+// This is a hand-written parser for the grammar of parser.y, used in
+// place of the bison one when the compiler is built with
+// PARSER=descent. Declarations, statements and expressions are parsed
+// by recursive descent, and binary operators by precedence climbing
+// (a Pratt parser), with the precedences and associativity declared in
+// parser.y. Lists are parsed by loops, so the stack grows only with
+// the nesting of the program, not its length. It reads tokens from the
+// flex lexer into a small ring buffer, and builds the same nodes, with
+// the same locations, as the bison parser, which stays the reference:
+// the two builds generate the same code for every program (with -g,
+// the same line information too). Syntax errors are reported at the
+// same token, though not always with the same list of expected tokens.
+class DescentParser {
+private:
+  // The scanner of the file being parsed (see lexer.l), and what
+  // takes each class, if the classes are not kept in the program
+  void* scanner;
+  ClassHandler onClass;
+  Token buffer[PARSER_LOOKAHEAD];
+  unsigned first;
+  unsigned buffered;
+  // The last token consumed, and the position the lexer last set
+  Token previous;
+  YYLTYPE position;
+
+  void read(unsigned ahead);
+
+  // The parser looks at every token several times, so these are kept
+  // inline
+  Token& peek(unsigned ahead = 0) {
+    if (ahead >= buffered)
+      read(ahead);
+    return buffer[(first + ahead) % PARSER_LOOKAHEAD];
+  }
+  bool at(int type, unsigned ahead = 0) { return peek(ahead).type == type; }
+  const Token& next() {
+    previous = peek();
+    first = (first + 1) % PARSER_LOOKAHEAD;
+    buffered--;
+    return previous;
+  }
+  const Token& expect(int type);
+  void syntaxError(int expected);
+
+  ClassNode* parseClass();
+  DeclarationNode* parseMember();
+  MethodNode* parseMethod();
+  ParameterNode* parseParameter();
+  MethodBodyNode* parseBody();
+  DeclarationNode* parseDeclaration();
+  bool atDeclaration();
+  bool atStatement();
+  StatementNode* parseStatement();
+  std::list<StatementNode*>* parseBlock();
+  TypeNode* parseType();
+  TypeNode* parseValueType();
+  TypeNode* parseReturnType();
+  ExpressionNode* parseExpression(int minPrecedence = 1);
+  ExpressionNode* parseUnary();
+  ExpressionNode* parsePrimary();
+  MethodCallNode* parseMethodCall(const Token& name, IdentifierNode* method);
+  std::list<ExpressionNode*>* parseArguments();
+
+public:
+  DescentParser(void* scanner, ClassHandler onClass = ClassHandler())
+    : scanner(scanner), onClass(onClass), first(0), buffered(0), previous() {
+    // Where the bison parser starts too
+    position.first_line = position.last_line = 1;
+    position.first_column = position.last_column = 1;
+  }
+
+  ProgramNode* parseProgram();
+};
+
+#endif
@@ -128,6 +128,27 @@ for line in inputfile:
             optional = True
         node.addChild(childname, vector, optional)
 
+# Returns the member names of the children of a node, numbering the
+#   children that share a type the same way the node classes above do
+def childmembers(node):
+    counts = {}
+    for child in node.children:
+        counts[child.name] = counts.get(child.name, 0) + 1
+    numbers = {}
+    members = []
+    for child in node.children:
+        member = child.name.lower()
+        if (child.list):
+            member = member + "_list"
+        if (counts[child.name] > 1):
+            numbers[child.name] = numbers.get(child.name, 0) + 1
+            member = member + "_" + str(numbers[child.name])
+        members.append((child, member))
+    return members
+
+# Every kind of concrete node, as (class name, lower case name)
+kinds = [(node.name, node.name.lower()) for node in nodes] + [("Identifier", "identifier"), ("Integer", "integer")]
+
 # Print all definitions read from def file if we are verbose
 if (verbose):
     [print("Found node def: " + str(node)) for node in nodes]
@@ -157,8 +178,21 @@ writeline(headerfile, "#include <stack>")
 writeline(headerfile, "#include <string>")
 writeline(headerfile, "#include <sstream>")
 writeline(headerfile, "")
-writeline(headerfile, "// Enumaration of all base types in the language")
-writeline(headerfile, "typedef enum {bt_boolean, bt_integer, bt_none, bt_object} BaseType;")
+writeline(headerfile, "// Enumaration of all base types in the language. bt_error is not a")
+writeline(headerfile, "//   type of the language: the type checker gives it to expressions and")
+writeline(headerfile, "//   variables that had a type error, so errors are not reported again")
+writeline(headerfile, "//   for the code that uses them. The task types are the handles of")
+writeline(headerfile, "//   spawned calls, by the type that joining them gives.")
+writeline(headerfile, "typedef enum {bt_boolean, bt_integer, bt_none, bt_object, bt_task_boolean, bt_task_integer, bt_task_object,")
+writeline(headerfile, "              bt_error} BaseType;")
+writeline(headerfile, "")
+writeline(headerfile, "// Enumeration of all kinds of concrete nodes. Every node stores its")
+writeline(headerfile, "//   kind, so visitors can dispatch on it without virtual calls")
+writeline(headerfile, "typedef enum {")
+for kind in kinds:
+    writeline(headerfile, "  kind_" + kind[1] + ",")
+writeline(headerfile, "  kind_count")
+writeline(headerfile, "} NodeKind;")
 writeline(headerfile, "")
 writeline(headerfile, "// Forward declarations of AST Node classes")
 for node in nodes:
@@ -216,6 +250,25 @@ writeline(headerfile, "  virtual void visitIdentifierNode(IdentifierNode* node)
 writeline(headerfile, "  virtual void visitIntegerNode(IntegerNode* node) = 0;")
 writeline(headerfile, "};")
 writeline(headerfile, "")
+writeline(headerfile, "// A position in the source, packed into one word: the line in the")
+writeline(headerfile, "//   upper 20 bits and the column in the lower 12, both counted from 1.")
+writeline(headerfile, "//   0 is an unknown position (nodes made after parsing). Lines and")
+writeline(headerfile, "//   columns that do not fit are kept at the largest value.")
+writeline(headerfile, "typedef unsigned int SourceLocation;")
+writeline(headerfile, "#define LOCATION_COLUMN_BITS 12")
+writeline(headerfile, "#define LOCATION_MAX_COLUMN ((1u << LOCATION_COLUMN_BITS) - 1)")
+writeline(headerfile, "#define LOCATION_MAX_LINE ((1u << (32 - LOCATION_COLUMN_BITS)) - 1)")
+writeline(headerfile, "")
+writeline(headerfile, "inline SourceLocation makeLocation(int line, int column) {")
+writeline(headerfile, "  if (line <= 0)")
+writeline(headerfile, "    return 0;")
+writeline(headerfile, "  unsigned l = (unsigned)line < LOCATION_MAX_LINE ? line : LOCATION_MAX_LINE;")
+writeline(headerfile, "  unsigned c = column <= 0 ? 0 : (unsigned)column < LOCATION_MAX_COLUMN ? column : LOCATION_MAX_COLUMN;")
+writeline(headerfile, "  return (l << LOCATION_COLUMN_BITS) | c;")
+writeline(headerfile, "}")
+writeline(headerfile, "inline int locationLine(SourceLocation location) { return location >> LOCATION_COLUMN_BITS; }")
+writeline(headerfile, "inline int locationColumn(SourceLocation location) { return location & LOCATION_MAX_COLUMN; }")
+writeline(headerfile, "")
 writeline(headerfile, "// Define abstract base class for all AST Nodes")
 writeline(headerfile, "//   (this also serves to define the visitable objects)")
 writeline(headerfile, "class ASTNode {")
@@ -225,6 +278,15 @@ writeline(headerfile, "  BaseType basetype;")
 writeline(headerfile, "  // All AST nodes have a member which stores the class name, applicable if the base type")
 writeline(headerfile, "  // is object. Otherwise this field may be unused")
 writeline(headerfile, "  std::string objectClassName;")
+writeline(headerfile, "  // Where the node was parsed, set by the parser actions (0 for nodes")
+writeline(headerfile, "  // made after parsing). It is kept in the node, so costs no allocation.")
+writeline(headerfile, "  SourceLocation location;")
+writeline(headerfile, "  // The kind of the node, set by its constructor")
+writeline(headerfile, "  NodeKind kind;")
+writeline(headerfile, "")
+writeline(headerfile, "  ASTNode() : location(0) {}")
+writeline(headerfile, "  // Deleting a node deletes the whole subtree rooted at it")
+writeline(headerfile, "  virtual ~ASTNode() {}")
 writeline(headerfile, "")
 writeline(headerfile, "  // All AST nodes provide visit children and accept methods")
 writeline(headerfile, "  virtual void visit_children(Visitor* v) = 0;")
@@ -235,15 +297,34 @@ writeline(headerfile, "// Define all abstract AST node classes")
 for abstractnode in abstractnodes:
     writeline(headerfile, "class " + abstractnode + "Node : public ASTNode {};")
 
+writeline(headerfile, "")
+writeline(headerfile, "// What a name was resolved to, written after type checking (see")
+writeline(headerfile, "//   binding.hpp), so code generation needs no symbol table lookups:")
+writeline(headerfile, "//   binding_local:  a parameter or local, at offset(%ebp)")
+writeline(headerfile, "//   binding_member: a member, at offset from the start of its object,")
+writeline(headerfile, "//                   taking size bytes (1 for packed booleans, else 4)")
+writeline(headerfile, "//   binding_method: a method, called at label; where the method is")
+writeline(headerfile, "//                   declared, size is the size of its locals")
+writeline(headerfile, "//   binding_class:  a class, whose objects take size bytes, and whose")
+writeline(headerfile, "//                   constructor is at label (empty if it has none)")
+writeline(headerfile, "typedef enum {binding_none, binding_local, binding_member, binding_method, binding_class} BindingKind;")
+writeline(headerfile, "typedef struct binding {")
+writeline(headerfile, "  BindingKind kind;")
+writeline(headerfile, "  int offset;")
+writeline(headerfile, "  int size;")
+writeline(headerfile, "  std::string label;")
+writeline(headerfile, "} Binding;")
 writeline(headerfile, "")
 writeline(headerfile, "// Define leaf AST nodes for ids and ints (also used for bools)")
-writeline(headerfile, "// Identifiers have a member name, which is a string")
+writeline(headerfile, "// Identifiers have a member name, which is a string, and the binding")
+writeline(headerfile, "//   of the name")
 writeline(headerfile, "class IdentifierNode : public ASTNode {")
 writeline(headerfile, "public:")
 writeline(headerfile, "  std::string name;")
+writeline(headerfile, "  Binding binding;")
 writeline(headerfile, "  virtual void visit_children(Visitor* v) { /* No Children */ }")
 writeline(headerfile, "  virtual void accept(Visitor* v) { v->visitIdentifierNode(this); }")
-writeline(headerfile, "  IdentifierNode(std::string name) { this->name = name; }")
+writeline(headerfile, "  IdentifierNode(std::string name) { this->kind = kind_identifier; this->name = name; this->binding.kind = binding_none; }")
 writeline(headerfile, "")
 writeline(headerfile, "};")
 writeline(headerfile, "")
@@ -255,7 +336,7 @@ writeline(headerfile, "")
 writeline(headerfile, "  virtual void visit_children(Visitor* v) {/* No Children */ }")
 writeline(headerfile, "  virtual void accept(Visitor* v) { v->visitIntegerNode(this); }")
 writeline(headerfile, "")
-writeline(headerfile, "  IntegerNode(int value) { this->value = value; }")
+writeline(headerfile, "  IntegerNode(int value) { this->kind = kind_integer; this->value = value; }")
 writeline(headerfile, "};")
 writeline(headerfile, "")
 writeline(headerfile, "// Define all other AST nodes")
@@ -297,12 +378,69 @@ for node in nodes:
     if (len(members) > 0):
         writeline(headerfile, "")
         writeline(headerfile, "  " + node.name + "Node(" + (", ".join(members)) + ");")
+        writeline(headerfile, "  virtual ~" + node.name + "Node();")
+    else:
+        writeline(headerfile, "")
+        writeline(headerfile, "  " + node.name + "Node() { this->kind = kind_" + node.name.lower() + "; }")
     writeline(headerfile, "};")
     writeline(headerfile, "")
 
+writeline(headerfile, "// Define a base class for visitors dispatched statically (without")
+writeline(headerfile, "//   virtual calls). A visitor derives from StaticVisitor<Itself>; visit()")
+writeline(headerfile, "//   switches on the kind of a node and calls the visitor's own function")
+writeline(headerfile, "//   for it directly, so the compiler can inline it, and visitChildren()")
+writeline(headerfile, "//   visits the children of a node the same way. The functions of a")
+writeline(headerfile, "//   visitor that also derives from Visitor are called non-virtually, as")
+writeline(headerfile, "//   the visitor's own. A visitor that does not define the function for")
+writeline(headerfile, "//   a kind visits the children of those nodes.")
+writeline(headerfile, "template <typename Derived>")
+writeline(headerfile, "class StaticVisitor {")
+writeline(headerfile, "public:")
+writeline(headerfile, "  void visit(ASTNode* node) {")
+writeline(headerfile, "    Derived* self = static_cast<Derived*>(this);")
+writeline(headerfile, "    switch (node->kind) {")
+for kind in kinds:
+    writeline(headerfile, "    case kind_" + kind[1] + ": self->Derived::visit" + kind[0] + "Node(static_cast<" + kind[0] + "Node*>(node)); break;")
+writeline(headerfile, "    default: break;")
+writeline(headerfile, "    }")
+writeline(headerfile, "  }")
+writeline(headerfile, "")
+writeline(headerfile, "  template <typename T>")
+writeline(headerfile, "  void visitList(std::list<T*>* list) {")
+writeline(headerfile, "    if (list) {")
+writeline(headerfile, "      for (typename std::list<T*>::iterator iter = list->begin(); iter != list->end(); iter++)")
+writeline(headerfile, "        visit(*iter);")
+writeline(headerfile, "    }")
+writeline(headerfile, "  }")
+writeline(headerfile, "")
+writeline(headerfile, "  // Visit the children of each kind of node, in the order of visit_children")
+for node in nodes:
+    members = childmembers(node)
+    if (len(members) == 0):
+        writeline(headerfile, "  void visitChildren(" + node.name + "Node* node) { /* No Children */ }")
+        continue
+    writeline(headerfile, "  void visitChildren(" + node.name + "Node* node) {")
+    for (child, member) in members:
+        if (child.list):
+            writeline(headerfile, "    visitList(node->" + member + ");")
+        elif (child.optional):
+            writeline(headerfile, "    if (node->" + member + ")")
+            writeline(headerfile, "      visit(node->" + member + ");")
+        else:
+            writeline(headerfile, "    visit(node->" + member + ");")
+    writeline(headerfile, "  }")
+writeline(headerfile, "  void visitChildren(IdentifierNode* node) { /* No Children */ }")
+writeline(headerfile, "  void visitChildren(IntegerNode* node) { /* No Children */ }")
+writeline(headerfile, "")
+writeline(headerfile, "  // Functions for the kinds a visitor does not define")
+for kind in kinds:
+    writeline(headerfile, "  void visit" + kind[0] + "Node(" + kind[0] + "Node* node) { visitChildren(node); }")
+writeline(headerfile, "};")
+writeline(headerfile, "")
 writeline(headerfile, "// Define the provided Print visitor, which will print the AST,")
 writeline(headerfile, "//   this is an example of a concrete visitor which visit the tree")
-writeline(headerfile, "class Print : public Visitor {")
+writeline(headerfile, "//   (it is dispatched statically within the tree)")
+writeline(headerfile, "class Print : public Visitor, public StaticVisitor<Print> {")
 writeline(headerfile, "private:")
 writeline(headerfile, "  std::vector<std::string>* elements;")
 writeline(headerfile, "  std::stack<std::vector<std::string>*> stack;")
@@ -374,10 +512,27 @@ for node in nodes:
         writeline(codefile, "")
         writeline(codefile, "// Constructor for " + node.name + " AST node")
         writeline(codefile, "" + node.name + "Node::" + node.name + "Node(" + (", ".join(map(lambda x: x[0] + " " + x[1], members))) + ") {")
+        writeline(codefile, "  this->kind = kind_" + node.name.lower() + ";")
         for member in members:
             writeline(codefile, "  this->" + member[1] + " = " + member[1] + ";")
         writeline(codefile, "}")
 
+        writeline(codefile, "")
+        writeline(codefile, "// Destructor for " + node.name + " AST node, which deletes its children")
+        writeline(codefile, "" + node.name + "Node::~" + node.name + "Node() {")
+        for member in members:
+            if (member[0].startswith("std::list")):
+                writeline(codefile, "  if (this->" + member[1] + ") {")
+                writeline(codefile, "    for(" + member[0][:-1] + "::iterator iter = this->" + member[1] + "->begin();")
+                writeline(codefile, "        iter != this->" + member[1] + "->end(); iter++) {")
+                writeline(codefile, "      delete *iter;")
+                writeline(codefile, "    }")
+                writeline(codefile, "    delete this->" + member[1] + ";")
+                writeline(codefile, "  }")
+            else:
+                writeline(codefile, "  delete this->" + member[1] + ";")
+        writeline(codefile, "}")
+
 writeline(codefile, "")
 writeline(codefile, "// Definitions for print functions")
 writeline(codefile, "// Push Level adds a new level to the printed tree (for a node with children)")
@@ -448,7 +603,7 @@ for node in nodes:
             pushflags = ", true";
             popflags = "true, true"
         writeline(codefile, "  this->pushLevel(\"" + node.name + "\"" + pushflags + ");")
-        writeline(codefile, "  node->visit_children(this);")
+        writeline(codefile, "  this->visitChildren(node);")
         writeline(codefile, "  this->popLevel(" + popflags + ");")
     else:
         writeline(codefile, "  this->addElement(\"" + node.name + "\");")
@@ -460,7 +615,6 @@ writeline(codefile, "  std::stringstream ss;")
 writeline(codefile, "  // Print the name of the indentifier surrounded by quotes")
 writeline(codefile, "  ss << \"\\\"\" << node->name << \"\\\"\";")
 writeline(codefile, "  this->addElement(ss.str());")
-writeline(codefile, "  node->visit_children(this);")
 writeline(codefile, "}")
 writeline(codefile, "")
 writeline(codefile, "void Print::visitIntegerNode(IntegerNode* node) {")
@@ -468,9 +622,9 @@ writeline(codefile, "  std::stringstream ss;")
 writeline(codefile, "  // Print the value of the integer")
 writeline(codefile, "  ss << node->value;")
 writeline(codefile, "  this->addElement(ss.str());")
-writeline(codefile, "  node->visit_children(this);")
 writeline(codefile, "}")
 writeline(codefile, "")
 
 # Close code file
 codefile.close()
+
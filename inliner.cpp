@@ -0,0 +1,275 @@
+#include "inliner.hpp"
+#include "profile.hpp"
+
+void Inliner::run(ProgramNode* program, ClassTable* classTable) {
+  this->classTable = classTable;
+  methods.clear();
+  for (std::list<ClassNode*>::iterator c = program->class_list->begin(); c != program->class_list->end(); c++) {
+    for (std::list<MethodNode*>::iterator m = (*c)->method_list->begin(); m != (*c)->method_list->end(); m++) {
+      std::string className = (*c)->identifier_1->name;
+      methods[className + "_" + (*m)->identifier->name] = std::make_pair(className, *m);
+    }
+  }
+
+  threshold = profile.hottest() / 100;
+  if (threshold == 0)
+    threshold = 1;
+
+  for (std::list<ClassNode*>::iterator c = program->class_list->begin(); c != program->class_list->end(); c++) {
+    for (std::list<MethodNode*>::iterator m = (*c)->method_list->begin(); m != (*c)->method_list->end(); m++) {
+      scope = MethodScope(classTable, (*c)->identifier_1->name, (*m)->identifier->name);
+      unsigned count = 0;
+      profile.count(*m, 0, &count);
+      inlineStatements((*m)->methodbody->statement_list, count);
+    }
+  }
+}
+
+int Inliner::size(std::list<StatementNode*>* statements) {
+  int result = 0;
+  if (!statements)
+    return result;
+  for (std::list<StatementNode*>::iterator it = statements->begin(); it != statements->end(); it++) {
+    result++;
+    if (IfElseNode* node = dynamic_cast<IfElseNode*>(*it)) {
+      result += size(node->statement_list_1) + size(node->statement_list_2);
+    } else if (WhileNode* node = dynamic_cast<WhileNode*>(*it)) {
+      result += size(node->statement_list);
+    } else if (DoWhileNode* node = dynamic_cast<DoWhileNode*>(*it)) {
+      result += size(node->statement_list);
+    }
+  }
+  return result;
+}
+
+// "count" is how many times the statements ran in the profile
+void Inliner::inlineStatements(std::list<StatementNode*>* statements, unsigned count) {
+  if (!statements)
+    return;
+  for (std::list<StatementNode*>::iterator it = statements->begin(); it != statements->end();) {
+    MethodCallNode* call = NULL;
+    AssignmentNode* target = NULL;
+    unsigned inner = 0;
+    if (CallNode* node = dynamic_cast<CallNode*>(*it)) {
+      call = node->methodcall;
+    } else if (AssignmentNode* node = dynamic_cast<AssignmentNode*>(*it)) {
+      call = dynamic_cast<MethodCallNode*>(node->expression);
+      target = node;
+    } else if (IfElseNode* node = dynamic_cast<IfElseNode*>(*it)) {
+      profile.count(node, 0, &inner);
+      inlineStatements(node->statement_list_1, inner);
+      inner = 0;
+      profile.count(node, 1, &inner);
+      inlineStatements(node->statement_list_2, inner);
+    } else if (WhileNode* node = dynamic_cast<WhileNode*>(*it)) {
+      profile.count(node, 0, &inner);
+      inlineStatements(node->statement_list, inner);
+    } else if (DoWhileNode* node = dynamic_cast<DoWhileNode*>(*it)) {
+      profile.count(node, 0, &inner);
+      inlineStatements(node->statement_list, inner);
+    }
+
+    // The copy goes before the call, which is then removed
+    if (call && count >= threshold && expand(statements, it, call, target))
+      it = statements->erase(it);
+    else
+      it++;
+  }
+}
+
+bool Inliner::expand(std::list<StatementNode*>* statements, std::list<StatementNode*>::iterator position,
+                     MethodCallNode* call, AssignmentNode* target) {
+  std::string label = scope.callTarget(call);
+  if (!methods.count(label) || label == scope.className + "_" + scope.methodName)
+    return false;
+  std::string calleeClass = methods[label].first;
+  MethodNode* method = methods[label].second;
+  if (size(method->methodbody->statement_list) > 12)
+    return false;
+  if (call->identifier_2) {
+    if (scope.typeOf(call->identifier_1->name).objectClassName != calleeClass)
+      return false;
+  } else if (scope.className != calleeClass) {
+    return false;
+  }
+
+  std::string prefix = "_inl" + std::to_string(nextInline) + "_";
+  callee = MethodScope(classTable, calleeClass, method->identifier->name);
+  renamed.clear();
+  for (VariableTable::iterator it = callee.method.variables->begin(); it != callee.method.variables->end(); it++)
+    renamed[it->first] = prefix + it->first;
+  receiver = call->identifier_2 ? prefix + "this" : "";
+
+  failed = false;
+  std::list<StatementNode*>* body = copy(method->methodbody->statement_list);
+  ExpressionNode* result = NULL;
+  if (method->methodbody->returnstatement)
+    result = copy(method->methodbody->returnstatement->expression);
+  if (failed)
+    return false;
+  nextInline++;
+
+  for (VariableTable::iterator it = callee.method.variables->begin(); it != callee.method.variables->end(); it++)
+    scope.addLocal(renamed[it->first], it->second.type);
+
+  std::list<StatementNode*> code;
+  if (call->expression_list) {
+    std::list<ExpressionNode*>::reverse_iterator argument = call->expression_list->rbegin();
+    std::list<ParameterNode*>::reverse_iterator parameter = method->parameter_list->rbegin();
+    for (; argument != call->expression_list->rend(); argument++, parameter++)
+      code.push_back(assignment(renamed[(*parameter)->identifier->name], *argument));
+  }
+  if (!receiver.empty()) {
+    CompoundType type = scope.typeOf(call->identifier_1->name);
+    scope.addLocal(receiver, type);
+    code.push_back(assignment(receiver, variable(call->identifier_1->name, type)));
+  }
+  if (body)
+    code.splice(code.end(), *body);
+
+  if (result && target) {
+    target->expression = result;
+    code.push_back(target);
+  } else if (MethodCallNode* node = dynamic_cast<MethodCallNode*>(result)) {
+    code.push_back(new CallNode(node));
+  } else if (result) {
+    // Dead code elimination drops this if computing it has no effect
+    CompoundType type;
+    type.baseType = result->basetype;
+    type.objectClassName = result->objectClassName;
+    scope.addLocal(prefix + "result", type);
+    code.push_back(assignment(prefix + "result", result));
+  }
+
+  statements->splice(position, code);
+  return true;
+}
+
+// A name used as an object (to access a member or call a method).
+// Members of the callee's "this" cannot be reached through another
+// object, and must not be hidden by a local of the caller.
+IdentifierNode* Inliner::local(IdentifierNode* name) {
+  if (renamed.count(name->name))
+    return new IdentifierNode(renamed[name->name]);
+  if (!receiver.empty() || scope.isLocal(name->name))
+    failed = true;
+  return new IdentifierNode(name->name);
+}
+
+// Copies callee code into the caller: locals and parameters are
+// renamed, and members of "this" are reached through the receiver.
+ExpressionNode* Inliner::copy(ExpressionNode* node) {
+  ExpressionNode* result = NULL;
+  if (PlusNode* n = dynamic_cast<PlusNode*>(node)) {
+    result = new PlusNode(copy(n->expression_1), copy(n->expression_2));
+  } else if (MinusNode* n = dynamic_cast<MinusNode*>(node)) {
+    result = new MinusNode(copy(n->expression_1), copy(n->expression_2));
+  } else if (TimesNode* n = dynamic_cast<TimesNode*>(node)) {
+    result = new TimesNode(copy(n->expression_1), copy(n->expression_2));
+  } else if (DivideNode* n = dynamic_cast<DivideNode*>(node)) {
+    result = new DivideNode(copy(n->expression_1), copy(n->expression_2));
+  } else if (GreaterNode* n = dynamic_cast<GreaterNode*>(node)) {
+    result = new GreaterNode(copy(n->expression_1), copy(n->expression_2));
+  } else if (GreaterEqualNode* n = dynamic_cast<GreaterEqualNode*>(node)) {
+    result = new GreaterEqualNode(copy(n->expression_1), copy(n->expression_2));
+  } else if (EqualNode* n = dynamic_cast<EqualNode*>(node)) {
+    result = new EqualNode(copy(n->expression_1), copy(n->expression_2));
+  } else if (AndNode* n = dynamic_cast<AndNode*>(node)) {
+    result = new AndNode(copy(n->expression_1), copy(n->expression_2));
+  } else if (OrNode* n = dynamic_cast<OrNode*>(node)) {
+    result = new OrNode(copy(n->expression_1), copy(n->expression_2));
+  } else if (NotNode* n = dynamic_cast<NotNode*>(node)) {
+    result = new NotNode(copy(n->expression));
+  } else if (NegationNode* n = dynamic_cast<NegationNode*>(node)) {
+    result = new NegationNode(copy(n->expression));
+  } else if (MethodCallNode* n = dynamic_cast<MethodCallNode*>(node)) {
+    if (n->identifier_2)
+      result = new MethodCallNode(local(n->identifier_1), new IdentifierNode(n->identifier_2->name),
+                                  copy(n->expression_list));
+    else if (!receiver.empty())
+      result = new MethodCallNode(new IdentifierNode(receiver), new IdentifierNode(n->identifier_1->name),
+                                  copy(n->expression_list));
+    else
+      result = new MethodCallNode(new IdentifierNode(n->identifier_1->name), NULL, copy(n->expression_list));
+  } else if (MemberAccessNode* n = dynamic_cast<MemberAccessNode*>(node)) {
+    result = new MemberAccessNode(local(n->identifier_1), new IdentifierNode(n->identifier_2->name));
+  } else if (VariableNode* n = dynamic_cast<VariableNode*>(node)) {
+    std::string name = n->identifier->name;
+    if (renamed.count(name)) {
+      result = new VariableNode(new IdentifierNode(renamed[name]));
+    } else if (!receiver.empty()) {
+      result = new MemberAccessNode(new IdentifierNode(receiver), new IdentifierNode(name));
+    } else {
+      if (scope.isLocal(name))
+        failed = true;
+      result = new VariableNode(new IdentifierNode(name));
+    }
+  } else if (IntegerLiteralNode* n = dynamic_cast<IntegerLiteralNode*>(node)) {
+    result = new IntegerLiteralNode(new IntegerNode(n->integer->value));
+  } else if (BooleanLiteralNode* n = dynamic_cast<BooleanLiteralNode*>(node)) {
+    result = new BooleanLiteralNode(new IntegerNode(n->integer->value));
+  } else if (NewNode* n = dynamic_cast<NewNode*>(node)) {
+    result = new NewNode(new IdentifierNode(n->identifier->name), copy(n->expression_list));
+  } else if (SpawnNode* n = dynamic_cast<SpawnNode*>(node)) {
+    result = new SpawnNode((MethodCallNode*)copy(n->methodcall));
+  } else if (JoinNode* n = dynamic_cast<JoinNode*>(node)) {
+    result = new JoinNode(copy(n->expression));
+  }
+  result->basetype = node->basetype;
+  result->objectClassName = node->objectClassName;
+  result->location = node->location;
+  return result;
+}
+
+StatementNode* Inliner::copy(StatementNode* node) {
+  StatementNode* result = NULL;
+  if (AssignmentNode* n = dynamic_cast<AssignmentNode*>(node)) {
+    std::string name = n->identifier_1->name;
+    if (n->identifier_2) {
+      result = new AssignmentNode(local(n->identifier_1), new IdentifierNode(n->identifier_2->name),
+                                  copy(n->expression));
+    } else if (renamed.count(name)) {
+      result = new AssignmentNode(new IdentifierNode(renamed[name]), NULL, copy(n->expression));
+    } else if (!receiver.empty()) {
+      result = new AssignmentNode(new IdentifierNode(receiver), new IdentifierNode(name), copy(n->expression));
+    } else {
+      if (scope.isLocal(name))
+        failed = true;
+      result = new AssignmentNode(new IdentifierNode(name), NULL, copy(n->expression));
+    }
+  } else if (CallNode* n = dynamic_cast<CallNode*>(node)) {
+    result = new CallNode((MethodCallNode*)copy(n->methodcall));
+  } else if (PrintNode* n = dynamic_cast<PrintNode*>(node)) {
+    result = new PrintNode(copy(n->expression));
+  } else if (IfElseNode* n = dynamic_cast<IfElseNode*>(node)) {
+    result = new IfElseNode(copy(n->expression), copy(n->statement_list_1), copy(n->statement_list_2));
+  } else if (WhileNode* n = dynamic_cast<WhileNode*>(node)) {
+    result = new WhileNode(copy(n->expression), copy(n->statement_list));
+  } else if (DoWhileNode* n = dynamic_cast<DoWhileNode*>(node)) {
+    result = new DoWhileNode(copy(n->statement_list), copy(n->expression));
+  }
+  // Branches and loops keep the counts of the original
+  profile.copySite(node, result);
+  result->basetype = node->basetype;
+  result->objectClassName = node->objectClassName;
+  result->location = node->location;
+  return result;
+}
+
+std::list<ExpressionNode*>* Inliner::copy(std::list<ExpressionNode*>* list) {
+  if (!list)
+    return NULL;
+  std::list<ExpressionNode*>* result = new std::list<ExpressionNode*>();
+  for (std::list<ExpressionNode*>::iterator it = list->begin(); it != list->end(); it++)
+    result->push_back(copy(*it));
+  return result;
+}
+
+std::list<StatementNode*>* Inliner::copy(std::list<StatementNode*>* list) {
+  if (!list)
+    return NULL;
+  std::list<StatementNode*>* result = new std::list<StatementNode*>();
+  for (std::list<StatementNode*>::iterator it = list->begin(); it != list->end(); it++)
+    result->push_back(copy(*it));
+  return result;
+}
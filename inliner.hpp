@@ -0,0 +1,57 @@
+#ifndef __INLINER_HPP
+#define __INLINER_HPP
+
+#include "passmanager.hpp"
+#include "analysis.hpp"
+
+// This pass replaces hot calls by a copy of the called method's
+// body. It is driven by the profile (see profile.hpp), and only
+// scheduled when one is given: a call is inlined if the block it is
+// in ran at least 1% as often as the hottest site of the program,
+// and the callee is small (at most 12 statements).
+//
+// The call must be a statement, or be the whole right hand side of
+// an assignment. The copy assigns the arguments (right to left, as
+// the call evaluated them) to new locals standing for the callee's
+// parameters, and keeps its result in the assignment's target.
+// The callee's locals are renamed (_inlN_name). For a call through
+// an object variable, the object is kept in a new local _inlN_this,
+// and the callee's members are accessed through it; so the callee
+// cannot access members of its members, and the variable must be
+// declared with the callee's own class (the class table resolves
+// members and calls through it the same way as inside the callee).
+// Inlined code is not inlined into again, so recursion is harmless.
+class Inliner : public Pass {
+private:
+  ClassTable* classTable;
+  MethodScope scope;
+  // Every method, by label, and the class that declares it
+  std::map<std::string, std::pair<std::string, MethodNode*> > methods;
+  unsigned threshold;
+  int nextInline;
+
+  // The state of the copy being made
+  MethodScope callee;
+  std::map<std::string, std::string> renamed;
+  std::string receiver;
+  bool failed;
+
+  int size(std::list<StatementNode*>* statements);
+  void inlineStatements(std::list<StatementNode*>* statements, unsigned count);
+  bool expand(std::list<StatementNode*>* statements, std::list<StatementNode*>::iterator position,
+              MethodCallNode* call, AssignmentNode* target);
+
+  IdentifierNode* local(IdentifierNode* name);
+  ExpressionNode* copy(ExpressionNode* node);
+  StatementNode* copy(StatementNode* node);
+  std::list<ExpressionNode*>* copy(std::list<ExpressionNode*>* list);
+  std::list<StatementNode*>* copy(std::list<StatementNode*>* list);
+
+public:
+  Inliner() : nextInline(0) {}
+
+  virtual std::string name() { return "inline"; }
+  virtual void run(ProgramNode* program, ClassTable* classTable);
+};
+
+#endif
@@ -0,0 +1,453 @@
+#include "ir.hpp"
+
+#include <algorithm>
+#include <set>
+#include <sstream>
+
+IRInstruction::IRInstruction(IROpcode op, BaseType type)
+  : op(op), id(0), type(type), block(NULL), value(0), origin(NULL) {}
+
+bool IRInstruction::isTerminator() {
+  return op == ir_br || op == ir_condbr || op == ir_ret;
+}
+
+bool IRInstruction::hasValue() {
+  return type != bt_none && !isTerminator() && op != ir_store && op != ir_print;
+}
+
+bool IRInstruction::isPure() {
+  switch (op) {
+    case ir_const: case ir_undef: case ir_param: case ir_phi:
+    case ir_add: case ir_sub: case ir_mul:
+    case ir_gt: case ir_ge: case ir_eq:
+    case ir_and: case ir_or: case ir_not: case ir_neg:
+      return true;
+    default:
+      // Division can trap, so it is not pure either
+      return false;
+  }
+}
+
+void IRInstruction::addOperand(IRInstruction* operand) {
+  operands.push_back(operand);
+  operand->users.push_back(this);
+}
+
+static void removeUser(IRInstruction* operand, IRInstruction* user) {
+  std::vector<IRInstruction*>::iterator it = std::find(operand->users.begin(), operand->users.end(), user);
+  if (it != operand->users.end())
+    operand->users.erase(it);
+}
+
+void IRInstruction::setOperand(int index, IRInstruction* operand) {
+  removeUser(operands[index], this);
+  operands[index] = operand;
+  operand->users.push_back(this);
+}
+
+void IRInstruction::replaceAllUsesWith(IRInstruction* other) {
+  std::vector<IRInstruction*> oldUsers = users;
+  for (std::vector<IRInstruction*>::iterator user = oldUsers.begin(); user != oldUsers.end(); user++) {
+    for (unsigned int i = 0; i < (*user)->operands.size(); i++) {
+      if ((*user)->operands[i] == this) {
+        (*user)->operands[i] = other;
+        other->users.push_back(*user);
+      }
+    }
+  }
+  users.clear();
+}
+
+void IRInstruction::erase() {
+  for (std::vector<IRInstruction*>::iterator it = operands.begin(); it != operands.end(); it++)
+    removeUser(*it, this);
+  operands.clear();
+  if (block) {
+    std::vector<IRInstruction*>& list = block->instructions;
+    list.erase(std::find(list.begin(), list.end(), this));
+    block = NULL;
+  }
+}
+
+IRInstruction* IRBlock::terminator() {
+  if (instructions.empty() || !instructions.back()->isTerminator())
+    return NULL;
+  return instructions.back();
+}
+
+void IRBlock::insertBeforeTerminator(IRInstruction* instruction) {
+  instruction->block = this;
+  if (terminator())
+    instructions.insert(instructions.end() - 1, instruction);
+  else
+    instructions.push_back(instruction);
+}
+
+void IRBlock::insertAfterPhis(IRInstruction* instruction) {
+  instruction->block = this;
+  std::vector<IRInstruction*>::iterator it = instructions.begin();
+  while (it != instructions.end() && (*it)->op == ir_phi)
+    it++;
+  instructions.insert(it, instruction);
+}
+
+IRBlock* IRFunction::newBlock() {
+  IRBlock* block = new IRBlock(nextBlockId++, this);
+  blocks.push_back(block);
+  return block;
+}
+
+IRInstruction* IRFunction::newInstruction(IROpcode op, BaseType type) {
+  IRInstruction* instruction = new IRInstruction(op, type);
+  instruction->id = nextId++;
+  return instruction;
+}
+
+static void postorder(IRBlock* block, std::set<IRBlock*>& visited, std::vector<IRBlock*>& order) {
+  visited.insert(block);
+  for (std::vector<IRBlock*>::iterator it = block->successors.begin(); it != block->successors.end(); it++) {
+    if (!visited.count(*it))
+      postorder(*it, visited, order);
+  }
+  order.push_back(block);
+}
+
+std::vector<IRBlock*> IRFunction::reversePostorder() {
+  std::vector<IRBlock*> order;
+  std::set<IRBlock*> visited;
+  if (!blocks.empty())
+    postorder(blocks[0], visited, order);
+  std::reverse(order.begin(), order.end());
+  return order;
+}
+
+void addEdge(IRBlock* from, IRBlock* to) {
+  from->successors.push_back(to);
+  to->predecessors.push_back(from);
+}
+
+// Computes immediate dominators with the iterative algorithm of
+// Cooper, Harvey and Kennedy, walking the blocks in reverse postorder.
+std::map<int, IRBlock*> dominators(IRFunction* function) {
+  std::vector<IRBlock*> order = function->reversePostorder();
+  std::map<IRBlock*, int> number;
+  for (unsigned int i = 0; i < order.size(); i++)
+    number[order[i]] = i;
+
+  std::map<int, IRBlock*> idom;
+  if (order.empty())
+    return idom;
+  idom[order[0]->id] = order[0];
+
+  bool changed = true;
+  while (changed) {
+    changed = false;
+    for (unsigned int i = 1; i < order.size(); i++) {
+      IRBlock* block = order[i];
+      IRBlock* newIdom = NULL;
+      for (std::vector<IRBlock*>::iterator pred = block->predecessors.begin(); pred != block->predecessors.end(); pred++) {
+        if (!number.count(*pred) || !idom.count((*pred)->id))
+          continue;
+        if (!newIdom) {
+          newIdom = *pred;
+          continue;
+        }
+        // Intersect the two dominator chains
+        IRBlock* a = *pred;
+        IRBlock* b = newIdom;
+        while (a != b) {
+          while (number[a] > number[b])
+            a = idom[a->id];
+          while (number[b] > number[a])
+            b = idom[b->id];
+        }
+        newIdom = a;
+      }
+      if (newIdom && (!idom.count(block->id) || idom[block->id] != newIdom)) {
+        idom[block->id] = newIdom;
+        changed = true;
+      }
+    }
+  }
+  return idom;
+}
+
+bool dominates(std::map<int, IRBlock*>& idom, IRBlock* a, IRBlock* b) {
+  if (!idom.count(b->id))
+    return false;
+  while (true) {
+    if (a == b)
+      return true;
+    IRBlock* parent = idom[b->id];
+    if (parent == b)
+      return false;
+    b = parent;
+  }
+}
+
+static std::string valueName(IRInstruction* instruction) {
+  std::stringstream ss;
+  ss << "%" << instruction->id;
+  return ss.str();
+}
+
+static std::string blockName(IRBlock* block) {
+  std::stringstream ss;
+  ss << "bb" << block->id;
+  return ss.str();
+}
+
+std::vector<std::string> verify(IRFunction* function) {
+  std::vector<std::string> errors;
+  std::string where = function->name + ": ";
+
+  if (function->blocks.empty()) {
+    errors.push_back(where + "function has no blocks");
+    return errors;
+  }
+  if (!function->blocks[0]->predecessors.empty())
+    errors.push_back(where + "entry block has predecessors");
+
+  // Collect the instructions that belong to this function
+  std::set<IRInstruction*> defined;
+  std::set<IRBlock*> blocks(function->blocks.begin(), function->blocks.end());
+  for (std::vector<IRBlock*>::iterator b = function->blocks.begin(); b != function->blocks.end(); b++) {
+    for (std::vector<IRInstruction*>::iterator it = (*b)->instructions.begin(); it != (*b)->instructions.end(); it++)
+      defined.insert(*it);
+  }
+
+  std::map<int, IRBlock*> idom = dominators(function);
+  std::map<IRInstruction*, int> position;
+
+  for (std::vector<IRBlock*>::iterator b = function->blocks.begin(); b != function->blocks.end(); b++) {
+    IRBlock* block = *b;
+    std::string at = where + blockName(block) + ": ";
+
+    // Structure: a single terminator at the end, phis at the start
+    if (block->instructions.empty() || !block->instructions.back()->isTerminator()) {
+      errors.push_back(at + "block does not end with a terminator");
+    }
+    bool pastPhis = false;
+    for (unsigned int i = 0; i < block->instructions.size(); i++) {
+      IRInstruction* instruction = block->instructions[i];
+      position[instruction] = i;
+      if (instruction->block != block)
+        errors.push_back(at + valueName(instruction) + " has the wrong parent block");
+      if (instruction->isTerminator() && i + 1 != block->instructions.size())
+        errors.push_back(at + "terminator " + opcodeName(instruction->op) + " in the middle of the block");
+      if (instruction->op == ir_phi && pastPhis)
+        errors.push_back(at + "phi " + valueName(instruction) + " after a non-phi instruction");
+      if (instruction->op != ir_phi)
+        pastPhis = true;
+    }
+
+    // Edges must match the terminator and be recorded on both sides
+    IRInstruction* terminator = block->terminator();
+    unsigned int expected = 0;
+    if (terminator && terminator->op == ir_br)
+      expected = 1;
+    else if (terminator && terminator->op == ir_condbr)
+      expected = 2;
+    if (terminator && block->successors.size() != expected)
+      errors.push_back(at + opcodeName(terminator->op) + " with the wrong number of successors");
+    for (std::vector<IRBlock*>::iterator s = block->successors.begin(); s != block->successors.end(); s++) {
+      if (!blocks.count(*s))
+        errors.push_back(at + "successor is not in this function");
+      else if (std::count((*s)->predecessors.begin(), (*s)->predecessors.end(), block) != std::count(block->successors.begin(), block->successors.end(), *s))
+        errors.push_back(at + "edge to " + blockName(*s) + " missing from its predecessors");
+    }
+    for (std::vector<IRBlock*>::iterator p = block->predecessors.begin(); p != block->predecessors.end(); p++) {
+      if (!blocks.count(*p))
+        errors.push_back(at + "predecessor is not in this function");
+      else if (std::find((*p)->successors.begin(), (*p)->successors.end(), block) == (*p)->successors.end())
+        errors.push_back(at + "edge from " + blockName(*p) + " missing from its successors");
+    }
+  }
+
+  for (std::vector<IRBlock*>::iterator b = function->blocks.begin(); b != function->blocks.end(); b++) {
+    IRBlock* block = *b;
+    std::string at = where + blockName(block) + ": ";
+    bool reachable = idom.count(block->id) > 0;
+
+    for (std::vector<IRInstruction*>::iterator it = block->instructions.begin(); it != block->instructions.end(); it++) {
+      IRInstruction* instruction = *it;
+      std::string name = valueName(instruction);
+
+      if (instruction->op == ir_phi && instruction->operands.size() != block->predecessors.size())
+        errors.push_back(at + "phi " + name + " has a different number of operands than predecessors");
+
+      for (unsigned int i = 0; i < instruction->operands.size(); i++) {
+        IRInstruction* operand = instruction->operands[i];
+        if (!defined.count(operand)) {
+          errors.push_back(at + name + " uses a value that is not in this function");
+          continue;
+        }
+        if (std::count(operand->users.begin(), operand->users.end(), instruction) == 0)
+          errors.push_back(at + name + " is missing from the users of " + valueName(operand));
+        if (!operand->hasValue())
+          errors.push_back(at + name + " uses " + valueName(operand) + ", which has no value");
+
+        // Definitions must dominate their uses; a phi operand must
+        // dominate the end of the matching predecessor
+        if (!reachable || !idom.count(operand->block->id))
+          continue;
+        if (instruction->op == ir_phi) {
+          if (i < block->predecessors.size() && idom.count(block->predecessors[i]->id) && !dominates(idom, operand->block, block->predecessors[i]))
+            errors.push_back(at + "phi operand " + valueName(operand) + " does not dominate " + blockName(block->predecessors[i]));
+        } else if (operand->block == block) {
+          if (position[operand] >= position[instruction])
+            errors.push_back(at + name + " uses " + valueName(operand) + " before it is defined");
+        } else if (!dominates(idom, operand->block, block)) {
+          errors.push_back(at + name + " uses " + valueName(operand) + ", which does not dominate it");
+        }
+      }
+
+      // Operand types
+      BaseType want = bt_none;
+      switch (instruction->op) {
+        case ir_add: case ir_sub: case ir_mul: case ir_div: case ir_gt: case ir_ge: case ir_neg:
+          want = bt_integer;
+          break;
+        case ir_and: case ir_or: case ir_not: case ir_condbr:
+          want = bt_boolean;
+          break;
+        default:
+          break;
+      }
+      if (want != bt_none) {
+        for (std::vector<IRInstruction*>::iterator op = instruction->operands.begin(); op != instruction->operands.end(); op++) {
+          if ((*op)->type != want)
+            errors.push_back(at + name + " (" + opcodeName(instruction->op) + ") has an operand of the wrong type");
+        }
+      }
+      if (instruction->op == ir_phi) {
+        for (std::vector<IRInstruction*>::iterator op = instruction->operands.begin(); op != instruction->operands.end(); op++) {
+          if ((*op)->type != instruction->type && (*op)->op != ir_undef)
+            errors.push_back(at + "phi " + name + " merges values of different types");
+        }
+      }
+    }
+  }
+  return errors;
+}
+
+std::vector<std::string> verify(IRModule* module) {
+  std::vector<std::string> errors;
+  for (std::vector<IRFunction*>::iterator it = module->functions.begin(); it != module->functions.end(); it++) {
+    std::vector<std::string> functionErrors = verify(*it);
+    errors.insert(errors.end(), functionErrors.begin(), functionErrors.end());
+  }
+  return errors;
+}
+
+std::string opcodeName(IROpcode op) {
+  switch (op) {
+    case ir_const: return "const";
+    case ir_undef: return "undef";
+    case ir_param: return "param";
+    case ir_phi: return "phi";
+    case ir_add: return "add";
+    case ir_sub: return "sub";
+    case ir_mul: return "mul";
+    case ir_div: return "div";
+    case ir_gt: return "gt";
+    case ir_ge: return "ge";
+    case ir_eq: return "eq";
+    case ir_and: return "and";
+    case ir_or: return "or";
+    case ir_not: return "not";
+    case ir_neg: return "neg";
+    case ir_load: return "load";
+    case ir_store: return "store";
+    case ir_call: return "call";
+    case ir_new: return "new";
+    case ir_spawn: return "spawn";
+    case ir_join: return "join";
+    case ir_print: return "print";
+    case ir_br: return "br";
+    case ir_condbr: return "condbr";
+    case ir_ret: return "ret";
+  }
+  return "?";
+}
+
+static std::string typeName(IRInstruction* instruction) {
+  CompoundType type;
+  type.baseType = instruction->type;
+  type.objectClassName = instruction->objectClassName;
+  return string(type);
+}
+
+void dump(IRFunction* function, std::ostream& out) {
+  out << "function " << function->name << "(";
+  for (unsigned int i = 0; i < function->params.size(); i++)
+    out << (i ? ", " : "") << valueName(function->params[i]);
+  out << ") {" << std::endl;
+
+  for (std::vector<IRBlock*>::iterator b = function->blocks.begin(); b != function->blocks.end(); b++) {
+    IRBlock* block = *b;
+    out << blockName(block) << ":";
+    if (!block->predecessors.empty()) {
+      out << "    ; preds";
+      for (std::vector<IRBlock*>::iterator p = block->predecessors.begin(); p != block->predecessors.end(); p++)
+        out << " " << blockName(*p);
+    }
+    out << std::endl;
+
+    for (std::vector<IRInstruction*>::iterator it = block->instructions.begin(); it != block->instructions.end(); it++) {
+      IRInstruction* instruction = *it;
+      out << "  ";
+      if (instruction->hasValue())
+        out << valueName(instruction) << " = ";
+      out << opcodeName(instruction->op);
+
+      switch (instruction->op) {
+        case ir_const:
+        case ir_param:
+          out << " " << instruction->value;
+          break;
+        case ir_phi:
+          for (unsigned int i = 0; i < instruction->operands.size(); i++) {
+            out << (i ? ", " : " ") << "[" << valueName(instruction->operands[i]) << ", ";
+            out << (i < block->predecessors.size() ? blockName(block->predecessors[i]) : "?") << "]";
+          }
+          break;
+        case ir_load:
+        case ir_store:
+          out << " " << instruction->symbol << " +" << instruction->value;
+          for (unsigned int i = 0; i < instruction->operands.size(); i++)
+            out << ", " << valueName(instruction->operands[i]);
+          break;
+        case ir_call:
+        case ir_new:
+        case ir_spawn:
+          out << " " << instruction->symbol << "(";
+          for (unsigned int i = 0; i < instruction->operands.size(); i++)
+            out << (i ? ", " : "") << valueName(instruction->operands[i]);
+          out << ")";
+          break;
+        default:
+          for (unsigned int i = 0; i < instruction->operands.size(); i++)
+            out << (i ? ", " : " ") << valueName(instruction->operands[i]);
+          break;
+      }
+
+      if (instruction->op == ir_br || instruction->op == ir_condbr) {
+        for (unsigned int i = 0; i < block->successors.size(); i++)
+          out << (i || instruction->op == ir_condbr ? ", " : " ") << blockName(block->successors[i]);
+      }
+      if (instruction->hasValue())
+        out << " : " << typeName(instruction);
+      out << std::endl;
+    }
+  }
+  out << "}" << std::endl;
+}
+
+void dump(IRModule* module, std::ostream& out) {
+  for (std::vector<IRFunction*>::iterator it = module->functions.begin(); it != module->functions.end(); it++) {
+    if (it != module->functions.begin())
+      out << std::endl;
+    dump(*it, out);
+  }
+}
@@ -0,0 +1,146 @@
+#ifndef __IR_HPP
+#define __IR_HPP
+
+#include "ast.hpp"
+#include "typecheck.hpp"
+
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+// This file defines an SSA-form intermediate representation. Each
+// method becomes an IRFunction, which is a control flow graph of
+// IRBlocks. Locals and parameters from the method's VariableTable
+// become SSA values (with phi instructions where control flow
+// merges); members stay in memory and are read and written with
+// explicit load and store instructions.
+
+// Enumeration of all IR operations
+typedef enum {
+  // Values
+  ir_const,     // value = the constant
+  ir_undef,     // a local read before it is assigned
+  ir_param,     // value = parameter index (0 is "this")
+  ir_phi,       // one operand per predecessor, in the same order
+
+  // Arithmetic, comparisons and boolean operators
+  ir_add, ir_sub, ir_mul, ir_div,
+  ir_gt, ir_ge, ir_eq,
+  ir_and, ir_or, ir_not, ir_neg,
+
+  // Memory and calls
+  ir_load,      // operands: object; value = byte offset, symbol = Class.member
+  ir_store,     // operands: object, value; value = byte offset, symbol = Class.member
+  ir_call,      // operands: receiver, arguments; symbol = Class_method
+  ir_new,       // operands: constructor arguments; symbol = class name, value = object size
+  ir_spawn,     // operands: receiver, arguments; symbol = Class_method
+  ir_join,      // operands: task
+  ir_print,     // operands: value to print
+
+  // Terminators (successors are in the block's successor list)
+  ir_br,
+  ir_condbr,    // operands: boolean; successors: true block, false block
+  ir_ret        // operands: return value (if any)
+} IROpcode;
+
+class IRBlock;
+class IRFunction;
+
+class IRInstruction {
+public:
+  IROpcode op;
+  // Every instruction is numbered; the ones that produce a value
+  // are printed as %id
+  int id;
+  BaseType type;
+  std::string objectClassName;
+  std::vector<IRInstruction*> operands;
+  // Every instruction using this one, once per use
+  std::vector<IRInstruction*> users;
+  IRBlock* block;
+  int value;
+  std::string symbol;
+  // The AST node this instruction was built from (may be NULL)
+  ASTNode* origin;
+
+  IRInstruction(IROpcode op, BaseType type);
+
+  bool isTerminator();
+  bool hasValue();
+  // True for instructions that only compute a value: they read
+  // and write no memory, and cannot trap or print
+  bool isPure();
+
+  void addOperand(IRInstruction* operand);
+  void setOperand(int index, IRInstruction* operand);
+  // Points every user of this instruction at another value instead
+  void replaceAllUsesWith(IRInstruction* other);
+  // Removes this instruction from its block and from its operands'
+  // user lists. It must not have any users left.
+  void erase();
+};
+
+class IRBlock {
+public:
+  int id;
+  IRFunction* function;
+  std::vector<IRInstruction*> instructions;
+  std::vector<IRBlock*> predecessors;
+  std::vector<IRBlock*> successors;
+
+  IRBlock(int id, IRFunction* function) : id(id), function(function) {}
+
+  IRInstruction* terminator();
+  // Inserts before the terminator, or at the end if there is none
+  void insertBeforeTerminator(IRInstruction* instruction);
+  // Inserts after the phi instructions at the start of the block
+  void insertAfterPhis(IRInstruction* instruction);
+};
+
+class IRFunction {
+public:
+  // The assembly label, Class_method
+  std::string name;
+  std::string className;
+  std::string methodName;
+  MethodInfo methodInfo;
+  std::vector<IRBlock*> blocks;
+  // Parameter values in order; params[0] is "this"
+  std::vector<IRInstruction*> params;
+  int nextId;
+  int nextBlockId;
+
+  IRFunction() : nextId(0), nextBlockId(0) {}
+
+  IRBlock* newBlock();
+  IRInstruction* newInstruction(IROpcode op, BaseType type);
+  // Blocks in reverse postorder from the entry block. Unreachable
+  // blocks are left out.
+  std::vector<IRBlock*> reversePostorder();
+};
+
+class IRModule {
+public:
+  std::vector<IRFunction*> functions;
+};
+
+// Adds a control flow edge, keeping both lists in sync
+void addEdge(IRBlock* from, IRBlock* to);
+
+// Immediate dominators of the reachable blocks of a function, by
+// block id (the entry block is its own immediate dominator)
+std::map<int, IRBlock*> dominators(IRFunction* function);
+bool dominates(std::map<int, IRBlock*>& idom, IRBlock* a, IRBlock* b);
+
+// Checks the structural and SSA invariants of a function, returning
+// a description of every problem found (empty if it is well formed)
+std::vector<std::string> verify(IRFunction* function);
+std::vector<std::string> verify(IRModule* module);
+
+// Print the IR in a readable text form
+void dump(IRFunction* function, std::ostream& out);
+void dump(IRModule* module, std::ostream& out);
+std::string opcodeName(IROpcode op);
+
+#endif
@@ -0,0 +1,514 @@
+#include "irbuilder.hpp"
+
+IRModule* buildIR(ProgramNode* program, ClassTable* classTable) {
+  IRBuilder* builder = new IRBuilder(classTable);
+  program->accept(builder);
+  IRModule* module = builder->module;
+  delete builder;
+  return module;
+}
+
+IRBuilder::IRBuilder(ClassTable* classTable)
+  : classTable(classTable), function(NULL), current(NULL), value(NULL) {
+  module = new IRModule();
+}
+
+IRInstruction* IRBuilder::emit(IROpcode op, BaseType type, ASTNode* origin) {
+  IRInstruction* instruction = function->newInstruction(op, type);
+  instruction->origin = origin;
+  instruction->block = current;
+  current->instructions.push_back(instruction);
+  return instruction;
+}
+
+void IRBuilder::branch(IRBlock* target) {
+  emit(ir_br, bt_none, NULL);
+  addEdge(current, target);
+}
+
+void IRBuilder::condBranch(IRInstruction* condition, IRBlock* whenTrue, IRBlock* whenFalse, ASTNode* origin) {
+  IRInstruction* instruction = emit(ir_condbr, bt_none, origin);
+  instruction->addOperand(condition);
+  addEdge(current, whenTrue);
+  addEdge(current, whenFalse);
+}
+
+bool IRBuilder::isLocal(std::string name) {
+  return currentMethodInfo.variables->find(name) != currentMethodInfo.variables->end();
+}
+
+CompoundType IRBuilder::localType(std::string name) {
+  return currentMethodInfo.variables->find(name)->second.type;
+}
+
+// SSA construction: see the comment on IRBuilder in irbuilder.hpp
+
+void IRBuilder::writeVariable(std::string name, IRBlock* block, IRInstruction* value) {
+  currentDef[name][block] = value;
+}
+
+IRInstruction* IRBuilder::readVariable(std::string name, IRBlock* block) {
+  std::map<IRBlock*, IRInstruction*>& defs = currentDef[name];
+  std::map<IRBlock*, IRInstruction*>::iterator def = defs.find(block);
+  if (def != defs.end()) {
+    IRInstruction* value = def->second;
+    while (replaced.count(value))
+      value = replaced[value];
+    return value;
+  }
+  return readVariableRecursive(name, block);
+}
+
+IRInstruction* IRBuilder::newPhi(std::string name, IRBlock* block) {
+  CompoundType type = localType(name);
+  IRInstruction* phi = function->newInstruction(ir_phi, type.baseType);
+  phi->objectClassName = type.objectClassName;
+  block->insertAfterPhis(phi);
+  return phi;
+}
+
+IRInstruction* IRBuilder::readVariableRecursive(std::string name, IRBlock* block) {
+  IRInstruction* value;
+  if (!sealed.count(block)) {
+    // Not all predecessors are known yet; fill in the phi when
+    // the block is sealed
+    value = newPhi(name, block);
+    incompletePhis[block][name] = value;
+  } else if (block->predecessors.empty()) {
+    // Read before any assignment
+    CompoundType type = localType(name);
+    value = function->newInstruction(ir_undef, type.baseType);
+    value->objectClassName = type.objectClassName;
+    function->blocks[0]->insertAfterPhis(value);
+  } else if (block->predecessors.size() == 1) {
+    value = readVariable(name, block->predecessors[0]);
+  } else {
+    // Break cycles by recording the phi before reading operands
+    value = newPhi(name, block);
+    writeVariable(name, block, value);
+    value = addPhiOperands(name, value);
+  }
+  writeVariable(name, block, value);
+  return value;
+}
+
+IRInstruction* IRBuilder::addPhiOperands(std::string name, IRInstruction* phi) {
+  std::vector<IRBlock*> predecessors = phi->block->predecessors;
+  for (std::vector<IRBlock*>::iterator it = predecessors.begin(); it != predecessors.end(); it++)
+    phi->addOperand(readVariable(name, *it));
+  return tryRemoveTrivialPhi(phi);
+}
+
+IRInstruction* IRBuilder::tryRemoveTrivialPhi(IRInstruction* phi) {
+  IRInstruction* same = NULL;
+  for (std::vector<IRInstruction*>::iterator it = phi->operands.begin(); it != phi->operands.end(); it++) {
+    if (*it == same || *it == phi)
+      continue;
+    if (same)
+      return phi;
+    same = *it;
+  }
+  if (!same) {
+    // The phi is unreachable or in the entry block
+    same = function->newInstruction(ir_undef, phi->type);
+    same->objectClassName = phi->objectClassName;
+    function->blocks[0]->insertAfterPhis(same);
+  }
+
+  std::vector<IRInstruction*> users;
+  for (std::vector<IRInstruction*>::iterator it = phi->users.begin(); it != phi->users.end(); it++) {
+    if (*it != phi)
+      users.push_back(*it);
+  }
+  phi->replaceAllUsesWith(same);
+  phi->erase();
+  replaced[phi] = same;
+
+  // Removing this phi may have made the phis using it trivial
+  for (std::vector<IRInstruction*>::iterator it = users.begin(); it != users.end(); it++) {
+    if ((*it)->op == ir_phi && (*it)->block)
+      tryRemoveTrivialPhi(*it);
+  }
+  return same;
+}
+
+void IRBuilder::sealBlock(IRBlock* block) {
+  std::map<std::string, IRInstruction*> phis = incompletePhis[block];
+  for (std::map<std::string, IRInstruction*>::iterator it = phis.begin(); it != phis.end(); it++)
+    addPhiOperands(it->first, it->second);
+  incompletePhis.erase(block);
+  sealed.insert(block);
+}
+
+IRInstruction* IRBuilder::objectValue(std::string name, ASTNode* origin, std::string* className) {
+  if (isLocal(name)) {
+    *className = localType(name).objectClassName;
+    return readVariable(name, current);
+  }
+  VariableInfo info;
+  std::string declaringClass;
+  int offset = 0;
+  findMember(classTable, currentClassName, name, &info, &declaringClass, &offset);
+  IRInstruction* load = emit(ir_load, info.type.baseType, origin);
+  load->objectClassName = info.type.objectClassName;
+  load->addOperand(function->params[0]);
+  load->value = offset;
+  load->symbol = declaringClass + "." + name;
+  *className = info.type.objectClassName;
+  return load;
+}
+
+IRInstruction* IRBuilder::binary(IROpcode op, BaseType type, ExpressionNode* left, ExpressionNode* right, ASTNode* origin) {
+  left->accept(this);
+  IRInstruction* a = value;
+  right->accept(this);
+  IRInstruction* b = value;
+  IRInstruction* instruction = emit(op, type, origin);
+  instruction->addOperand(a);
+  instruction->addOperand(b);
+  return instruction;
+}
+
+// IRBuilder Visitor Functions
+
+void IRBuilder::visitProgramNode(ProgramNode* node) {
+  node->visit_children(this);
+}
+
+void IRBuilder::visitClassNode(ClassNode* node) {
+  currentClassName = node->identifier_1->name;
+  for (std::list<MethodNode*>::iterator it = node->method_list->begin(); it != node->method_list->end(); it++)
+    (*it)->accept(this);
+}
+
+void IRBuilder::visitMethodNode(MethodNode* node) {
+  currentMethodName = node->identifier->name;
+  currentMethodInfo = (*classTable)[currentClassName].methods->find(currentMethodName)->second;
+
+  function = new IRFunction();
+  function->name = currentClassName + "_" + currentMethodName;
+  function->className = currentClassName;
+  function->methodName = currentMethodName;
+  function->methodInfo = currentMethodInfo;
+  module->functions.push_back(function);
+
+  currentDef.clear();
+  incompletePhis.clear();
+  sealed.clear();
+  replaced.clear();
+
+  current = function->newBlock();
+  sealBlock(current);
+
+  IRInstruction* self = emit(ir_param, bt_object, node);
+  self->objectClassName = currentClassName;
+  self->value = 0;
+  function->params.push_back(self);
+
+  int index = 1;
+  for (std::list<ParameterNode*>::iterator it = node->parameter_list->begin(); it != node->parameter_list->end(); it++) {
+    std::string name = (*it)->identifier->name;
+    IRInstruction* param = emit(ir_param, localType(name).baseType, *it);
+    param->objectClassName = localType(name).objectClassName;
+    param->value = index++;
+    function->params.push_back(param);
+    writeVariable(name, current, param);
+  }
+
+  node->methodbody->accept(this);
+}
+
+void IRBuilder::visitMethodBodyNode(MethodBodyNode* node) {
+  for (std::list<StatementNode*>::iterator it = node->statement_list->begin(); it != node->statement_list->end(); it++)
+    (*it)->accept(this);
+  if (node->returnstatement) {
+    node->returnstatement->accept(this);
+  } else {
+    emit(ir_ret, bt_none, NULL);
+  }
+}
+
+void IRBuilder::visitParameterNode(ParameterNode* node) {}
+
+void IRBuilder::visitDeclarationNode(DeclarationNode* node) {}
+
+void IRBuilder::visitReturnStatementNode(ReturnStatementNode* node) {
+  node->expression->accept(this);
+  IRInstruction* ret = emit(ir_ret, bt_none, node);
+  ret->addOperand(value);
+}
+
+void IRBuilder::visitAssignmentNode(AssignmentNode* node) {
+  node->expression->accept(this);
+  IRInstruction* result = value;
+  std::string name = node->identifier_1->name;
+
+  if (!node->identifier_2 && isLocal(name)) {
+    writeVariable(name, current, result);
+    return;
+  }
+
+  IRInstruction* object;
+  std::string className;
+  std::string memberName;
+  if (node->identifier_2) {
+    object = objectValue(name, node, &className);
+    memberName = node->identifier_2->name;
+  } else {
+    object = function->params[0];
+    className = currentClassName;
+    memberName = name;
+  }
+
+  std::string declaringClass;
+  int offset = 0;
+  findMember(classTable, className, memberName, NULL, &declaringClass, &offset);
+  IRInstruction* store = emit(ir_store, bt_none, node);
+  store->addOperand(object);
+  store->addOperand(result);
+  store->value = offset;
+  store->symbol = declaringClass + "." + memberName;
+}
+
+void IRBuilder::visitCallNode(CallNode* node) {
+  node->methodcall->accept(this);
+}
+
+void IRBuilder::visitIfElseNode(IfElseNode* node) {
+  node->expression->accept(this);
+  IRInstruction* condition = value;
+
+  bool hasElse = node->statement_list_2 && !node->statement_list_2->empty();
+  IRBlock* thenBlock = function->newBlock();
+  IRBlock* elseBlock = hasElse ? function->newBlock() : NULL;
+  IRBlock* joinBlock = function->newBlock();
+
+  condBranch(condition, thenBlock, hasElse ? elseBlock : joinBlock, node);
+  sealBlock(thenBlock);
+  if (hasElse)
+    sealBlock(elseBlock);
+
+  current = thenBlock;
+  for (std::list<StatementNode*>::iterator it = node->statement_list_1->begin(); it != node->statement_list_1->end(); it++)
+    (*it)->accept(this);
+  branch(joinBlock);
+
+  if (hasElse) {
+    current = elseBlock;
+    for (std::list<StatementNode*>::iterator it = node->statement_list_2->begin(); it != node->statement_list_2->end(); it++)
+      (*it)->accept(this);
+    branch(joinBlock);
+  }
+
+  sealBlock(joinBlock);
+  current = joinBlock;
+}
+
+void IRBuilder::visitWhileNode(WhileNode* node) {
+  IRBlock* header = function->newBlock();
+  IRBlock* body = function->newBlock();
+  IRBlock* exit = function->newBlock();
+
+  // The header is sealed once the back edge from the body exists
+  branch(header);
+  current = header;
+  node->expression->accept(this);
+  condBranch(value, body, exit, node);
+  sealBlock(body);
+  sealBlock(exit);
+
+  current = body;
+  for (std::list<StatementNode*>::iterator it = node->statement_list->begin(); it != node->statement_list->end(); it++)
+    (*it)->accept(this);
+  branch(header);
+  sealBlock(header);
+
+  current = exit;
+}
+
+void IRBuilder::visitDoWhileNode(DoWhileNode* node) {
+  IRBlock* body = function->newBlock();
+  IRBlock* exit = function->newBlock();
+
+  branch(body);
+  current = body;
+  for (std::list<StatementNode*>::iterator it = node->statement_list->begin(); it != node->statement_list->end(); it++)
+    (*it)->accept(this);
+  node->expression->accept(this);
+  condBranch(value, body, exit, node);
+  sealBlock(body);
+  sealBlock(exit);
+
+  current = exit;
+}
+
+void IRBuilder::visitPrintNode(PrintNode* node) {
+  node->expression->accept(this);
+  IRInstruction* print = emit(ir_print, bt_none, node);
+  print->addOperand(value);
+}
+
+void IRBuilder::visitPlusNode(PlusNode* node) {
+  value = binary(ir_add, bt_integer, node->expression_1, node->expression_2, node);
+}
+
+void IRBuilder::visitMinusNode(MinusNode* node) {
+  value = binary(ir_sub, bt_integer, node->expression_1, node->expression_2, node);
+}
+
+void IRBuilder::visitTimesNode(TimesNode* node) {
+  value = binary(ir_mul, bt_integer, node->expression_1, node->expression_2, node);
+}
+
+void IRBuilder::visitDivideNode(DivideNode* node) {
+  value = binary(ir_div, bt_integer, node->expression_1, node->expression_2, node);
+}
+
+void IRBuilder::visitGreaterNode(GreaterNode* node) {
+  value = binary(ir_gt, bt_boolean, node->expression_1, node->expression_2, node);
+}
+
+void IRBuilder::visitGreaterEqualNode(GreaterEqualNode* node) {
+  value = binary(ir_ge, bt_boolean, node->expression_1, node->expression_2, node);
+}
+
+void IRBuilder::visitEqualNode(EqualNode* node) {
+  value = binary(ir_eq, bt_boolean, node->expression_1, node->expression_2, node);
+}
+
+void IRBuilder::visitAndNode(AndNode* node) {
+  value = binary(ir_and, bt_boolean, node->expression_1, node->expression_2, node);
+}
+
+void IRBuilder::visitOrNode(OrNode* node) {
+  value = binary(ir_or, bt_boolean, node->expression_1, node->expression_2, node);
+}
+
+void IRBuilder::visitNotNode(NotNode* node) {
+  node->expression->accept(this);
+  IRInstruction* operand = value;
+  value = emit(ir_not, bt_boolean, node);
+  value->addOperand(operand);
+}
+
+void IRBuilder::visitNegationNode(NegationNode* node) {
+  node->expression->accept(this);
+  IRInstruction* operand = value;
+  value = emit(ir_neg, bt_integer, node);
+  value->addOperand(operand);
+}
+
+void IRBuilder::visitMethodCallNode(MethodCallNode* node) {
+  IRInstruction* receiver;
+  std::string className;
+  std::string methodName;
+  if (node->identifier_2) {
+    receiver = objectValue(node->identifier_1->name, node, &className);
+    methodName = node->identifier_2->name;
+  } else {
+    receiver = function->params[0];
+    className = currentClassName;
+    methodName = node->identifier_1->name;
+  }
+
+  std::vector<IRInstruction*> arguments;
+  for (std::list<ExpressionNode*>::iterator it = node->expression_list->begin(); it != node->expression_list->end(); it++) {
+    (*it)->accept(this);
+    arguments.push_back(value);
+  }
+
+  MethodInfo info;
+  std::string declaringClass;
+  findMethod(classTable, className, methodName, &info, &declaringClass);
+  IRInstruction* call = emit(ir_call, info.returnType.baseType, node);
+  if (info.returnType.baseType == bt_object)
+    call->objectClassName = info.returnType.objectClassName;
+  call->symbol = declaringClass + "_" + methodName;
+  call->addOperand(receiver);
+  for (std::vector<IRInstruction*>::iterator it = arguments.begin(); it != arguments.end(); it++)
+    call->addOperand(*it);
+  value = call;
+}
+
+void IRBuilder::visitMemberAccessNode(MemberAccessNode* node) {
+  std::string className;
+  IRInstruction* object = objectValue(node->identifier_1->name, node, &className);
+
+  VariableInfo info;
+  std::string declaringClass;
+  int offset = 0;
+  findMember(classTable, className, node->identifier_2->name, &info, &declaringClass, &offset);
+  value = emit(ir_load, info.type.baseType, node);
+  value->objectClassName = info.type.objectClassName;
+  value->addOperand(object);
+  value->value = offset;
+  value->symbol = declaringClass + "." + node->identifier_2->name;
+}
+
+void IRBuilder::visitVariableNode(VariableNode* node) {
+  std::string name = node->identifier->name;
+  if (isLocal(name)) {
+    value = readVariable(name, current);
+    return;
+  }
+  std::string className;
+  value = objectValue(name, node, &className);
+}
+
+void IRBuilder::visitIntegerLiteralNode(IntegerLiteralNode* node) {
+  value = emit(ir_const, bt_integer, node);
+  value->value = node->integer->value;
+}
+
+void IRBuilder::visitBooleanLiteralNode(BooleanLiteralNode* node) {
+  value = emit(ir_const, bt_boolean, node);
+  value->value = node->integer->value;
+}
+
+void IRBuilder::visitNewNode(NewNode* node) {
+  std::vector<IRInstruction*> arguments;
+  if (node->expression_list) {
+    for (std::list<ExpressionNode*>::iterator it = node->expression_list->begin(); it != node->expression_list->end(); it++) {
+      (*it)->accept(this);
+      arguments.push_back(value);
+    }
+  }
+  std::string className = node->identifier->name;
+  IRInstruction* allocation = emit(ir_new, bt_object, node);
+  allocation->objectClassName = className;
+  allocation->symbol = className;
+  allocation->value = objectSize(classTable, className);
+  for (std::vector<IRInstruction*>::iterator it = arguments.begin(); it != arguments.end(); it++)
+    allocation->addOperand(*it);
+  value = allocation;
+}
+
+// The spawn is built as the call it makes, which it then replaces
+void IRBuilder::visitSpawnNode(SpawnNode* node) {
+  node->methodcall->accept(this);
+  value->op = ir_spawn;
+  value->type = node->basetype;
+  value->objectClassName = "";
+  value->origin = node;
+}
+
+void IRBuilder::visitJoinNode(JoinNode* node) {
+  node->expression->accept(this);
+  IRInstruction* task = value;
+  value = emit(ir_join, node->basetype, node);
+  value->addOperand(task);
+}
+
+void IRBuilder::visitIntegerTypeNode(IntegerTypeNode* node) {}
+
+void IRBuilder::visitBooleanTypeNode(BooleanTypeNode* node) {}
+
+void IRBuilder::visitObjectTypeNode(ObjectTypeNode* node) {}
+
+void IRBuilder::visitTaskTypeNode(TaskTypeNode* node) {}
+
+void IRBuilder::visitNoneNode(NoneNode* node) {}
+
+void IRBuilder::visitIdentifierNode(IdentifierNode* node) {}
+
+void IRBuilder::visitIntegerNode(IntegerNode* node) {}
@@ -0,0 +1,109 @@
+#ifndef __IRBUILDER_HPP
+#define __IRBUILDER_HPP
+
+#include "ast.hpp"
+#include "typecheck.hpp"
+#include "ir.hpp"
+
+#include <map>
+#include <set>
+#include <string>
+
+// This visitor builds the SSA IR for every method of a typed AST.
+// It must run after the TypeCheck visitor, since it relies on the
+// symbol table to tell locals from members and to resolve methods.
+//
+// SSA form is constructed directly while walking the tree, using
+// the algorithm of Braun et al., "Simple and Efficient Construction
+// of Static Single Assignment Form" (CC 2013): every assignment to a
+// local records its current value per block, reads look the value
+// up through the predecessors, and phis are only placed where two
+// different values meet. Since our control flow is structured, each
+// block is sealed as soon as all its predecessors are known.
+class IRBuilder : public Visitor {
+private:
+  ClassTable* classTable;
+  IRFunction* function;
+  IRBlock* current;
+  // The value of the last expression visited
+  IRInstruction* value;
+
+  std::string currentClassName;
+  std::string currentMethodName;
+  MethodInfo currentMethodInfo;
+
+  std::map<std::string, std::map<IRBlock*, IRInstruction*> > currentDef;
+  std::map<IRBlock*, std::map<std::string, IRInstruction*> > incompletePhis;
+  std::set<IRBlock*> sealed;
+  // Trivial phis that were removed, and what replaced them
+  std::map<IRInstruction*, IRInstruction*> replaced;
+
+  IRInstruction* emit(IROpcode op, BaseType type, ASTNode* origin);
+  void branch(IRBlock* target);
+  void condBranch(IRInstruction* condition, IRBlock* whenTrue, IRBlock* whenFalse, ASTNode* origin);
+
+  bool isLocal(std::string name);
+  CompoundType localType(std::string name);
+  void writeVariable(std::string name, IRBlock* block, IRInstruction* value);
+  IRInstruction* readVariable(std::string name, IRBlock* block);
+  IRInstruction* readVariableRecursive(std::string name, IRBlock* block);
+  IRInstruction* newPhi(std::string name, IRBlock* block);
+  IRInstruction* addPhiOperands(std::string name, IRInstruction* phi);
+  IRInstruction* tryRemoveTrivialPhi(IRInstruction* phi);
+  void sealBlock(IRBlock* block);
+
+  // Returns the value of a local or member variable holding an
+  // object, and sets the name of its class
+  IRInstruction* objectValue(std::string name, ASTNode* origin, std::string* className);
+  IRInstruction* binary(IROpcode op, BaseType type, ExpressionNode* left, ExpressionNode* right, ASTNode* origin);
+
+public:
+  IRModule* module;
+
+  IRBuilder(ClassTable* classTable);
+
+  virtual void visitProgramNode(ProgramNode* node);
+  virtual void visitClassNode(ClassNode* node);
+  virtual void visitMethodNode(MethodNode* node);
+  virtual void visitMethodBodyNode(MethodBodyNode* node);
+  virtual void visitParameterNode(ParameterNode* node);
+  virtual void visitDeclarationNode(DeclarationNode* node);
+  virtual void visitReturnStatementNode(ReturnStatementNode* node);
+  virtual void visitAssignmentNode(AssignmentNode* node);
+  virtual void visitCallNode(CallNode* node);
+  virtual void visitIfElseNode(IfElseNode* node);
+  virtual void visitWhileNode(WhileNode* node);
+  virtual void visitDoWhileNode(DoWhileNode* node);
+  virtual void visitPrintNode(PrintNode* node);
+  virtual void visitPlusNode(PlusNode* node);
+  virtual void visitMinusNode(MinusNode* node);
+  virtual void visitTimesNode(TimesNode* node);
+  virtual void visitDivideNode(DivideNode* node);
+  virtual void visitGreaterNode(GreaterNode* node);
+  virtual void visitGreaterEqualNode(GreaterEqualNode* node);
+  virtual void visitEqualNode(EqualNode* node);
+  virtual void visitAndNode(AndNode* node);
+  virtual void visitOrNode(OrNode* node);
+  virtual void visitNotNode(NotNode* node);
+  virtual void visitNegationNode(NegationNode* node);
+  virtual void visitMethodCallNode(MethodCallNode* node);
+  virtual void visitMemberAccessNode(MemberAccessNode* node);
+  virtual void visitVariableNode(VariableNode* node);
+  virtual void visitIntegerLiteralNode(IntegerLiteralNode* node);
+  virtual void visitBooleanLiteralNode(BooleanLiteralNode* node);
+  virtual void visitNewNode(NewNode* node);
+  virtual void visitSpawnNode(SpawnNode* node);
+  virtual void visitJoinNode(JoinNode* node);
+  virtual void visitIntegerTypeNode(IntegerTypeNode* node);
+  virtual void visitBooleanTypeNode(BooleanTypeNode* node);
+  virtual void visitObjectTypeNode(ObjectTypeNode* node);
+  virtual void visitTaskTypeNode(TaskTypeNode* node);
+  virtual void visitNoneNode(NoneNode* node);
+  virtual void visitIdentifierNode(IdentifierNode* node);
+  virtual void visitIntegerNode(IntegerNode* node);
+};
+
+// Builds the IR for a whole program
+IRModule* buildIR(ProgramNode* program, ClassTable* classTable);
+
+#endif
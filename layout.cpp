@@ -0,0 +1,143 @@
+#include "layout.hpp"
+#include "profile.hpp"
+
+#include <algorithm>
+
+void AccessCounter::count(MethodNode* method) {
+  weight = 1;
+  unsigned value;
+  if (profile.count(method, 0, &value))
+    weight = value;
+  visitStatements(method->methodbody->statement_list);
+  if (method->methodbody->returnstatement)
+    rewrite(method->methodbody->returnstatement->expression);
+}
+
+void AccessCounter::access(std::string objectClass, std::string member) {
+  std::string declaringClass;
+  if (findMember(scope->classTable, objectClass, member, NULL, &declaringClass, NULL))
+    (*heat)[declaringClass][member] += weight;
+}
+
+// A name that is not a local is a member of "this"
+void AccessCounter::accessName(std::string name) {
+  if (!scope->isLocal(name))
+    access(scope->className, name);
+}
+
+// Visits code that runs the number of times a profile site counted,
+// or (without a profile) factor times as often as the code around it
+void AccessCounter::visitWeighted(std::list<StatementNode*>* statements, ASTNode* site, int which, double factor) {
+  double outer = weight;
+  unsigned value;
+  if (profile.count(site, which, &value))
+    weight = value;
+  else
+    weight *= factor;
+  visitStatements(statements);
+  weight = outer;
+}
+
+void AccessCounter::visitAssignmentNode(AssignmentNode* node) {
+  accessName(node->identifier_1->name);
+  if (node->identifier_2)
+    access(scope->typeOf(node->identifier_1->name).objectClassName, node->identifier_2->name);
+  node->expression = rewrite(node->expression);
+}
+
+void AccessCounter::visitCallNode(CallNode* node) {
+  visitMethodCallNode(node->methodcall);
+}
+
+void AccessCounter::visitIfElseNode(IfElseNode* node) {
+  node->expression = rewrite(node->expression);
+  visitWeighted(node->statement_list_1, node, 0, 1);
+  visitWeighted(node->statement_list_2, node, 1, 1);
+}
+
+void AccessCounter::visitWhileNode(WhileNode* node) {
+  double outer = weight;
+  weight *= 8;
+  node->expression = rewrite(node->expression);
+  weight = outer;
+  visitWeighted(node->statement_list, node, 0, 8);
+}
+
+void AccessCounter::visitDoWhileNode(DoWhileNode* node) {
+  visitWeighted(node->statement_list, node, 0, 8);
+  double outer = weight;
+  weight *= 8;
+  node->expression = rewrite(node->expression);
+  weight = outer;
+}
+
+void AccessCounter::visitMethodCallNode(MethodCallNode* node) {
+  if (node->identifier_2)
+    accessName(node->identifier_1->name);
+  rewrite(node->expression_list);
+  result = node;
+}
+
+void AccessCounter::visitMemberAccessNode(MemberAccessNode* node) {
+  accessName(node->identifier_1->name);
+  access(scope->typeOf(node->identifier_1->name).objectClassName, node->identifier_2->name);
+  result = node;
+}
+
+void AccessCounter::visitVariableNode(VariableNode* node) {
+  accessName(node->identifier->name);
+  result = node;
+}
+
+typedef std::pair<std::string, VariableInfo*> Member;
+
+// Orders members hottest first, then as they were declared
+struct HotterMember {
+  std::map<std::string, double>* heat;
+
+  bool operator()(const Member& a, const Member& b) const {
+    double heatA = (*heat)[a.first], heatB = (*heat)[b.first];
+    if (heatA != heatB)
+      return heatA > heatB;
+    return a.second->offset < b.second->offset;
+  }
+};
+
+void ObjectLayout::run(ProgramNode* program, ClassTable* classTable) {
+  MemberHeat heat;
+  for (std::list<ClassNode*>::iterator c = program->class_list->begin(); c != program->class_list->end(); c++) {
+    for (std::list<MethodNode*>::iterator m = (*c)->method_list->begin(); m != (*c)->method_list->end(); m++) {
+      MethodScope scope(classTable, (*c)->identifier_1->name, (*m)->identifier->name);
+      AccessCounter counter(&scope, &heat);
+      counter.count(*m);
+    }
+  }
+
+  for (ClassTable::iterator c = classTable->begin(); c != classTable->end(); c++) {
+    std::vector<Member> members;
+    for (VariableTable::iterator it = c->second.members->begin(); it != c->second.members->end(); it++)
+      members.push_back(Member(it->first, &it->second));
+    HotterMember hotter = { &heat[c->first] };
+    std::stable_sort(members.begin(), members.end(), hotter);
+
+    int size = 0;
+    // The next free byte of the word booleans are packed into
+    int packed = 0;
+    for (std::vector<Member>::iterator it = members.begin(); it != members.end(); it++) {
+      VariableInfo* info = it->second;
+      if (info->type.baseType == bt_boolean) {
+        if (packed % 4 == 0) {
+          packed = size;
+          size += 4;
+        }
+        info->offset = packed++;
+        info->size = 1;
+      } else {
+        info->offset = size;
+        info->size = 4;
+        size += 4;
+      }
+    }
+    c->second.membersSize = size;
+  }
+}
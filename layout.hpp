@@ -0,0 +1,55 @@
+#ifndef __LAYOUT_HPP
+#define __LAYOUT_HPP
+
+#include "passmanager.hpp"
+#include "analysis.hpp"
+
+// Heat of each member, by declaring class and name
+typedef std::map<std::string, std::map<std::string, double> > MemberHeat;
+
+// This visitor adds up how often the code of one method reads or
+// assigns each member. Each access counts the weight of the code
+// it is in: with a profile, the count of the innermost method,
+// branch or loop around it; without one, 1, times 8 for every loop
+// around it.
+class AccessCounter : public ExpressionRewriter {
+private:
+  MethodScope* scope;
+  MemberHeat* heat;
+  double weight;
+
+  void access(std::string objectClass, std::string member);
+  void accessName(std::string name);
+  void visitWeighted(std::list<StatementNode*>* statements, ASTNode* site, int which, double factor);
+
+public:
+  AccessCounter(MethodScope* scope, MemberHeat* heat) : scope(scope), heat(heat), weight(1) {}
+
+  void count(MethodNode* method);
+
+  virtual void visitAssignmentNode(AssignmentNode* node);
+  virtual void visitCallNode(CallNode* node);
+  virtual void visitIfElseNode(IfElseNode* node);
+  virtual void visitWhileNode(WhileNode* node);
+  virtual void visitDoWhileNode(DoWhileNode* node);
+  virtual void visitMethodCallNode(MethodCallNode* node);
+  virtual void visitMemberAccessNode(MemberAccessNode* node);
+  virtual void visitVariableNode(VariableNode* node);
+};
+
+// This pass lays out the members of every class again, when
+// --pack-objects is given. A class still starts with the members
+// of its superclass, so code written for the superclass finds them
+// at the same offsets, but its own members are reordered, hottest
+// (see AccessCounter) first, and boolean members take one byte
+// instead of a word: a boolean opens a new word, and the next
+// booleans in the order share it. Words stay aligned, and the size
+// of a class stays a multiple of 4. The CodeGenerator loads and
+// stores members with the size in their VariableInfo.
+class ObjectLayout : public Pass {
+public:
+  virtual std::string name() { return "layout"; }
+  virtual void run(ProgramNode* program, ClassTable* classTable);
+};
+
+#endif
@@ -0,0 +1,425 @@
+#include "loopoptimization.hpp"
+#include "constantfolding.hpp"
+
+#include <sstream>
+
+// Hoisted values are kept in new locals. Their names start with an
+// underscore, which the lexer does not allow in identifiers, so
+// they cannot clash with names in the program. Locals named _inv
+// are assigned once, before the loop; the products kept by
+// strength reduction (_iv) are also updated inside it.
+std::string LoopOptimization::newTemporary(std::string prefix, CompoundType type) {
+  std::stringstream name;
+  name << prefix << nextTemporary++;
+  scope.addLocal(name.str(), type);
+  return name.str();
+}
+
+std::vector<std::string> LoopOptimization::dependencies() {
+  // Strength reduction only recognizes constant steps, so fold
+  // the constants first
+  std::vector<std::string> names;
+  names.push_back("constfold");
+  return names;
+}
+
+void LoopOptimization::run(ProgramNode* program, ClassTable* classTable) {
+  effects = computeEffects(program, classTable);
+  for (std::list<ClassNode*>::iterator c = program->class_list->begin(); c != program->class_list->end(); c++) {
+    for (std::list<MethodNode*>::iterator m = (*c)->method_list->begin(); m != (*c)->method_list->end(); m++) {
+      scope = MethodScope(classTable, (*c)->identifier_1->name, (*m)->identifier->name);
+      optimizeStatements((*m)->methodbody->statement_list);
+    }
+  }
+}
+
+// Loops are optimized innermost first. The code hoisted out of a
+// loop goes right before it, in the enclosing statement list (which
+// may be the body of an outer loop, which can then hoist it further).
+void LoopOptimization::optimizeStatements(std::list<StatementNode*>* statements) {
+  if (!statements)
+    return;
+  for (std::list<StatementNode*>::iterator it = statements->begin(); it != statements->end(); it++) {
+    std::list<StatementNode*> preheader;
+    if (IfElseNode* node = dynamic_cast<IfElseNode*>(*it)) {
+      optimizeStatements(node->statement_list_1);
+      optimizeStatements(node->statement_list_2);
+    } else if (WhileNode* node = dynamic_cast<WhileNode*>(*it)) {
+      optimizeStatements(node->statement_list);
+      optimizeLoop(node->statement_list, &node->expression, false, &preheader);
+    } else if (DoWhileNode* node = dynamic_cast<DoWhileNode*>(*it)) {
+      optimizeStatements(node->statement_list);
+      optimizeLoop(node->statement_list, &node->expression, true, &preheader);
+    }
+    statements->insert(it, preheader.begin(), preheader.end());
+  }
+}
+
+EffectsCollector LoopOptimization::summarize(std::list<StatementNode*>* body, ExpressionNode* condition) {
+  EffectsCollector loop(&scope, &effects);
+  loop.collect(body);
+  loop.collect(condition);
+  return loop;
+}
+
+bool LoopOptimization::isInvariant(ExpressionNode* node, EffectsCollector& loop) {
+  if (VariableNode* n = dynamic_cast<VariableNode*>(node)) {
+    std::string name = n->identifier->name;
+    if (scope.isLocal(name))
+      return !loop.assignedLocals.count(name);
+    return !loop.effects.writes.count(scope.memberOffset(name));
+  }
+
+  if (MemberAccessNode* n = dynamic_cast<MemberAccessNode*>(node)) {
+    std::string name = n->identifier_1->name;
+    bool object = scope.isLocal(name) ? !loop.assignedLocals.count(name)
+                                      : !loop.effects.writes.count(scope.memberOffset(name));
+    int offset = scope.memberOffset(scope.typeOf(name).objectClassName, n->identifier_2->name);
+    return object && !loop.effects.writes.count(offset);
+  }
+
+  if (MethodCallNode* n = dynamic_cast<MethodCallNode*>(node)) {
+    Effects& callee = effects[scope.callTarget(n)];
+    if (!isPure(callee) || (callee.readsMemory && !loop.effects.writes.empty()))
+      return false;
+    if (n->identifier_2) {
+      std::string name = n->identifier_1->name;
+      if (scope.isLocal(name) ? loop.assignedLocals.count(name)
+                              : loop.effects.writes.count(scope.memberOffset(name)))
+        return false;
+    }
+  }
+
+  // Each iteration makes its own object or task, and joins its own
+  if (dynamic_cast<NewNode*>(node) || dynamic_cast<SpawnNode*>(node) || dynamic_cast<JoinNode*>(node))
+    return false;
+
+  std::vector<ExpressionNode**> slots = children(node);
+  for (std::vector<ExpressionNode**>::iterator it = slots.begin(); it != slots.end(); it++) {
+    if (!isInvariant(**it, loop))
+      return false;
+  }
+  return true;
+}
+
+// Replaces the largest invariant expressions under a slot with new
+// locals, which are assigned in the preheader. Literals and locals
+// are left alone, since they are as cheap to use as a new local.
+void LoopOptimization::hoist(ExpressionNode** slot, EffectsCollector& loop, bool mayTrap,
+                             std::list<StatementNode*>* preheader) {
+  ExpressionNode* node = *slot;
+  int value;
+  bool trivial = isLiteral(node, &value) ||
+    (dynamic_cast<VariableNode*>(node) && scope.isLocal(((VariableNode*)node)->identifier->name));
+
+  if (!trivial && isInvariant(node, loop) && (mayTrap || !canTrap(node))) {
+    CompoundType type;
+    type.baseType = node->basetype;
+    type.objectClassName = node->objectClassName;
+
+    // Reuse the local of an equal expression hoisted from this loop
+    for (std::list<StatementNode*>::iterator it = preheader->begin(); it != preheader->end(); it++) {
+      AssignmentNode* hoisted = (AssignmentNode*)*it;
+      if (sameExpression(hoisted->expression, node)) {
+        *slot = variable(hoisted->identifier_1->name, type);
+        return;
+      }
+    }
+
+    std::string name = newTemporary("_inv", type);
+    preheader->push_back(assignment(name, node));
+    *slot = variable(name, type);
+    return;
+  }
+
+  std::vector<ExpressionNode**> slots = children(node);
+  for (std::vector<ExpressionNode**>::iterator it = slots.begin(); it != slots.end(); it++)
+    hoist(*it, loop, mayTrap, preheader);
+}
+
+// Calls hoist on every expression in a list of statements. Code
+// that may trap can only be hoisted out of the statements that are
+// sure to run, before anything is printed, on the first iteration.
+void LoopOptimization::hoistStatements(std::list<StatementNode*>* statements, EffectsCollector& loop, bool* mayTrap,
+                                       std::list<StatementNode*>* preheader) {
+  if (!statements)
+    return;
+  for (std::list<StatementNode*>::iterator it = statements->begin(); it != statements->end(); it++) {
+    bool nested = false;
+    if (AssignmentNode* node = dynamic_cast<AssignmentNode*>(*it)) {
+      hoist(&node->expression, loop, *mayTrap, preheader);
+    } else if (CallNode* node = dynamic_cast<CallNode*>(*it)) {
+      std::vector<ExpressionNode**> slots = children(node->methodcall);
+      for (std::vector<ExpressionNode**>::iterator slot = slots.begin(); slot != slots.end(); slot++)
+        hoist(*slot, loop, *mayTrap, preheader);
+    } else if (PrintNode* node = dynamic_cast<PrintNode*>(*it)) {
+      hoist(&node->expression, loop, *mayTrap, preheader);
+    } else if (IfElseNode* node = dynamic_cast<IfElseNode*>(*it)) {
+      hoist(&node->expression, loop, *mayTrap, preheader);
+      nested = true;
+      bool never = false;
+      hoistStatements(node->statement_list_1, loop, &never, preheader);
+      hoistStatements(node->statement_list_2, loop, &never, preheader);
+    } else if (WhileNode* node = dynamic_cast<WhileNode*>(*it)) {
+      hoist(&node->expression, loop, *mayTrap, preheader);
+      nested = true;
+      bool never = false;
+      hoistStatements(node->statement_list, loop, &never, preheader);
+    } else if (DoWhileNode* node = dynamic_cast<DoWhileNode*>(*it)) {
+      nested = true;
+      bool never = false;
+      hoistStatements(node->statement_list, loop, &never, preheader);
+      hoist(&node->expression, loop, false, preheader);
+    }
+
+    if (*mayTrap) {
+      EffectsCollector statement(&scope, &effects);
+      (*it)->accept(&statement);
+      if (nested || statement.effects.prints)
+        *mayTrap = false;
+    }
+  }
+}
+
+void LoopOptimization::optimizeLoop(std::list<StatementNode*>* body, ExpressionNode** condition, bool doWhile,
+                                    std::list<StatementNode*>* preheader) {
+  EffectsCollector loop = summarize(body, *condition);
+
+  // The code hoisted out of inner loops (or kept in a local by value
+  // numbering) can move further out if it is invariant in this loop
+  // too. Each of those locals is assigned exactly once, so once moved
+  // it is no longer assigned in the loop.
+  bool mayTrap = doWhile;
+  for (std::list<StatementNode*>::iterator it = body->begin(); it != body->end();) {
+    AssignmentNode* node = dynamic_cast<AssignmentNode*>(*it);
+    if (node && (node->identifier_1->name.compare(0, 4, "_inv") == 0 ||
+                 node->identifier_1->name.compare(0, 4, "_cse") == 0) &&
+        isInvariant(node->expression, loop) && (mayTrap || !canTrap(node->expression))) {
+      preheader->push_back(node);
+      loop.assignedLocals.erase(node->identifier_1->name);
+      it = body->erase(it);
+    } else {
+      it++;
+    }
+  }
+
+  // A while loop tests its condition before anything else, and a
+  // do-while loop runs its body at least once
+  if (!doWhile)
+    hoist(condition, loop, true, preheader);
+  hoistStatements(body, loop, &mayTrap, preheader);
+  if (doWhile)
+    hoist(condition, loop, mayTrap, preheader);
+
+  reduceStrength(body, condition, preheader);
+}
+
+// Strength reduction
+
+// If an assignment is "name = name + c", "name = c + name" or
+// "name = name - c", sets the amount it adds to name.
+static bool inductionStep(AssignmentNode* node, std::string name, int* step) {
+  if (node->identifier_2 || node->identifier_1->name != name)
+    return false;
+
+  ExpressionNode* left = NULL;
+  ExpressionNode* right = NULL;
+  bool subtract = false;
+  if (PlusNode* plus = dynamic_cast<PlusNode*>(node->expression)) {
+    left = plus->expression_1;
+    right = plus->expression_2;
+  } else if (MinusNode* minus = dynamic_cast<MinusNode*>(node->expression)) {
+    left = minus->expression_1;
+    right = minus->expression_2;
+    subtract = true;
+  } else {
+    return false;
+  }
+
+  int value;
+  VariableNode* variable = dynamic_cast<VariableNode*>(left);
+  if (variable && variable->identifier->name == name && dynamic_cast<IntegerLiteralNode*>(right) && isLiteral(right, &value)) {
+    *step = subtract ? (int)(0u - (unsigned)value) : value;
+    return true;
+  }
+  variable = dynamic_cast<VariableNode*>(right);
+  if (!subtract && variable && variable->identifier->name == name && dynamic_cast<IntegerLiteralNode*>(left) && isLiteral(left, &value)) {
+    *step = value;
+    return true;
+  }
+  return false;
+}
+
+// Collects every assignment in a list of statements, at any depth
+static void assignments(std::list<StatementNode*>* statements, std::vector<AssignmentNode*>& found) {
+  if (!statements)
+    return;
+  for (std::list<StatementNode*>::iterator it = statements->begin(); it != statements->end(); it++) {
+    if (AssignmentNode* node = dynamic_cast<AssignmentNode*>(*it)) {
+      found.push_back(node);
+    } else if (IfElseNode* node = dynamic_cast<IfElseNode*>(*it)) {
+      assignments(node->statement_list_1, found);
+      assignments(node->statement_list_2, found);
+    } else if (WhileNode* node = dynamic_cast<WhileNode*>(*it)) {
+      assignments(node->statement_list, found);
+    } else if (DoWhileNode* node = dynamic_cast<DoWhileNode*>(*it)) {
+      assignments(node->statement_list, found);
+    }
+  }
+}
+
+// Collects the slot of every expression in a list of statements,
+// at any depth (including the expressions inside other expressions)
+static void expressionSlots(ExpressionNode** slot, std::vector<ExpressionNode**>& found) {
+  found.push_back(slot);
+  std::vector<ExpressionNode**> slots = children(*slot);
+  for (std::vector<ExpressionNode**>::iterator it = slots.begin(); it != slots.end(); it++)
+    expressionSlots(*it, found);
+}
+
+static void expressionSlots(std::list<StatementNode*>* statements, std::vector<ExpressionNode**>& found) {
+  if (!statements)
+    return;
+  for (std::list<StatementNode*>::iterator it = statements->begin(); it != statements->end(); it++) {
+    if (AssignmentNode* node = dynamic_cast<AssignmentNode*>(*it)) {
+      expressionSlots(&node->expression, found);
+    } else if (CallNode* node = dynamic_cast<CallNode*>(*it)) {
+      std::vector<ExpressionNode**> slots = children(node->methodcall);
+      for (std::vector<ExpressionNode**>::iterator slot = slots.begin(); slot != slots.end(); slot++)
+        expressionSlots(*slot, found);
+    } else if (PrintNode* node = dynamic_cast<PrintNode*>(*it)) {
+      expressionSlots(&node->expression, found);
+    } else if (IfElseNode* node = dynamic_cast<IfElseNode*>(*it)) {
+      expressionSlots(&node->expression, found);
+      expressionSlots(node->statement_list_1, found);
+      expressionSlots(node->statement_list_2, found);
+    } else if (WhileNode* node = dynamic_cast<WhileNode*>(*it)) {
+      expressionSlots(&node->expression, found);
+      expressionSlots(node->statement_list, found);
+    } else if (DoWhileNode* node = dynamic_cast<DoWhileNode*>(*it)) {
+      expressionSlots(node->statement_list, found);
+      expressionSlots(&node->expression, found);
+    }
+  }
+}
+
+// Inserts "product = product + factor * step" after every
+// assignment that steps the induction variable
+void LoopOptimization::insertUpdates(std::list<StatementNode*>* statements, Reduction& reduction,
+                                     std::list<StatementNode*>* preheader) {
+  if (!statements)
+    return;
+  CompoundType integer;
+  integer.baseType = bt_integer;
+
+  for (std::list<StatementNode*>::iterator it = statements->begin(); it != statements->end(); it++) {
+    int step;
+    if (AssignmentNode* node = dynamic_cast<AssignmentNode*>(*it)) {
+      if (!inductionStep(node, reduction.induction, &step))
+        continue;
+
+      ExpressionNode* product = variable(reduction.product, integer);
+      ExpressionNode* update;
+      int factor;
+      if (isLiteral(reduction.factor, &factor)) {
+        update = new PlusNode(product, integerLiteral((int)((unsigned)factor * (unsigned)step)));
+      } else {
+        std::string name = ((VariableNode*)reduction.factor)->identifier->name;
+        if (step == 1) {
+          update = new PlusNode(product, variable(name, integer));
+        } else if (step == -1) {
+          update = new MinusNode(product, variable(name, integer));
+        } else {
+          if (!reduction.steps.count(step)) {
+            std::string scaled = newTemporary("_inv", integer);
+            TimesNode* times = new TimesNode(variable(name, integer), integerLiteral(step));
+            times->basetype = bt_integer;
+            preheader->push_back(assignment(scaled, times));
+            reduction.steps[step] = scaled;
+          }
+          update = new PlusNode(product, variable(reduction.steps[step], integer));
+        }
+      }
+      update->basetype = bt_integer;
+      it = statements->insert(++it, assignment(reduction.product, update));
+    } else if (IfElseNode* node = dynamic_cast<IfElseNode*>(*it)) {
+      insertUpdates(node->statement_list_1, reduction, preheader);
+      insertUpdates(node->statement_list_2, reduction, preheader);
+    } else if (WhileNode* node = dynamic_cast<WhileNode*>(*it)) {
+      insertUpdates(node->statement_list, reduction, preheader);
+    } else if (DoWhileNode* node = dynamic_cast<DoWhileNode*>(*it)) {
+      insertUpdates(node->statement_list, reduction, preheader);
+    }
+  }
+}
+
+void LoopOptimization::reduceStrength(std::list<StatementNode*>* body, ExpressionNode** condition,
+                                      std::list<StatementNode*>* preheader) {
+  // Integer locals that are only ever stepped by constants
+  std::map<std::string, bool> inductions;
+  std::vector<AssignmentNode*> found;
+  assignments(body, found);
+  for (std::vector<AssignmentNode*>::iterator it = found.begin(); it != found.end(); it++) {
+    std::string name = (*it)->identifier_1->name;
+    if ((*it)->identifier_2 || !scope.isLocal(name) || scope.typeOf(name).baseType != bt_integer)
+      continue;
+    int step;
+    bool stepped = inductionStep(*it, name, &step);
+    if (inductions.count(name))
+      inductions[name] = inductions[name] && stepped;
+    else
+      inductions[name] = stepped;
+  }
+
+  EffectsCollector loop = summarize(body, *condition);
+  std::vector<ExpressionNode**> slots;
+  expressionSlots(condition, slots);
+  expressionSlots(body, slots);
+
+  std::vector<Reduction> reductions;
+  CompoundType integer;
+  integer.baseType = bt_integer;
+  for (std::vector<ExpressionNode**>::iterator slot = slots.begin(); slot != slots.end(); slot++) {
+    TimesNode* times = dynamic_cast<TimesNode*>(**slot);
+    if (!times)
+      continue;
+
+    // Find which operand is the induction variable, and check that
+    // the other is a literal or an invariant local
+    ExpressionNode* operands[2] = { times->expression_1, times->expression_2 };
+    for (int i = 0; i < 2; i++) {
+      VariableNode* induction = dynamic_cast<VariableNode*>(operands[i]);
+      ExpressionNode* factor = operands[1 - i];
+      if (!induction || !inductions.count(induction->identifier->name) || !inductions[induction->identifier->name])
+        continue;
+      int value;
+      VariableNode* local = dynamic_cast<VariableNode*>(factor);
+      if (!dynamic_cast<IntegerLiteralNode*>(factor) || !isLiteral(factor, &value)) {
+        if (!local || !scope.isLocal(local->identifier->name) || loop.assignedLocals.count(local->identifier->name))
+          continue;
+      }
+
+      Reduction* reduction = NULL;
+      for (std::vector<Reduction>::iterator it = reductions.begin(); it != reductions.end(); it++) {
+        if (it->induction == induction->identifier->name && sameExpression(it->factor, factor))
+          reduction = &*it;
+      }
+      if (!reduction) {
+        Reduction added;
+        added.induction = induction->identifier->name;
+        added.factor = factor;
+        added.product = newTemporary("_iv", integer);
+        TimesNode* initial = new TimesNode(variable(added.induction, integer), factor);
+        initial->basetype = bt_integer;
+        preheader->push_back(assignment(added.product, initial));
+        reductions.push_back(added);
+        reduction = &reductions.back();
+      }
+      **slot = variable(reduction->product, integer);
+      break;
+    }
+  }
+
+  for (std::vector<Reduction>::iterator it = reductions.begin(); it != reductions.end(); it++)
+    insertUpdates(body, *it, preheader);
+}
@@ -0,0 +1,63 @@
+#ifndef __LOOPOPTIMIZATION_HPP
+#define __LOOPOPTIMIZATION_HPP
+
+#include "passmanager.hpp"
+#include "analysis.hpp"
+
+// A product i * k being reduced, and the local that holds it
+typedef struct reduction {
+  std::string induction;
+  ExpressionNode* factor;
+  std::string product;
+  // Locals holding factor * step, for steps other than 1 and -1
+  std::map<int, std::string> steps;
+} Reduction;
+
+// This pass optimizes while and do-while loops, innermost first.
+//
+// Loop-invariant code motion: expressions whose value cannot change
+// while the loop runs are computed once into a new local before the
+// loop. Member reads are invariant if nothing in the loop (including
+// the methods it calls) stores to a member at the same offset; calls
+// are only moved if the method is pure. Expressions that may trap or
+// not terminate (division, member access through a variable, calls)
+// are only moved if the original code evaluated them before doing
+// anything else in the loop.
+//
+// Strength reduction: for a local that the loop only changes by
+// adding or subtracting constants (an induction variable i), each
+// product i * k with k invariant is kept in a new local, which is
+// updated with an addition wherever i changes.
+class LoopOptimization : public Pass {
+private:
+  MethodScope scope;
+  EffectsTable effects;
+  int nextTemporary;
+
+  std::string newTemporary(std::string prefix, CompoundType type);
+
+  void optimizeStatements(std::list<StatementNode*>* statements);
+  void optimizeLoop(std::list<StatementNode*>* body, ExpressionNode** condition, bool doWhile,
+                    std::list<StatementNode*>* preheader);
+
+  EffectsCollector summarize(std::list<StatementNode*>* body, ExpressionNode* condition);
+  bool isInvariant(ExpressionNode* node, EffectsCollector& loop);
+  void hoist(ExpressionNode** slot, EffectsCollector& loop, bool mayTrap,
+             std::list<StatementNode*>* preheader);
+  void hoistStatements(std::list<StatementNode*>* statements, EffectsCollector& loop, bool* mayTrap,
+                       std::list<StatementNode*>* preheader);
+
+  void reduceStrength(std::list<StatementNode*>* body, ExpressionNode** condition,
+                      std::list<StatementNode*>* preheader);
+  void insertUpdates(std::list<StatementNode*>* statements, Reduction& reduction,
+                     std::list<StatementNode*>* preheader);
+
+public:
+  LoopOptimization() : nextTemporary(0) {}
+
+  virtual std::string name() { return "loopopt"; }
+  virtual std::vector<std::string> dependencies();
+  virtual void run(ProgramNode* program, ClassTable* classTable);
+};
+
+#endif
@@ -1,32 +1,307 @@
 #include "ast.hpp"
 #include "typecheck.hpp"
 #include "codegeneration.hpp"
+#include "passmanager.hpp"
+#include "binding.hpp"
+#include "irbuilder.hpp"
+#include "profile.hpp"
+#include "stats.hpp"
 #include "parser.hpp"
 
+#include <atomic>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <thread>
+
 extern int yydebug;
-extern int yyparse();
 
 ASTNode* astRoot;
 
-int main(void) {
+// Runs work(0) to work(count - 1) on as many threads as there are
+// cores (or count, if fewer), each taking the next index when done
+static void inParallel(int count, std::function<void(int)> work) {
+    std::atomic<int> next(0);
+    int threads = std::min<int>(count, std::max(1u, std::thread::hardware_concurrency()));
+    if (threads <= 1) {
+        for (int index = 0; index < count; index++)
+            work(index);
+        return;
+    }
+    std::vector<std::thread> workers;
+    for (int i = 0; i < threads; i++) {
+        workers.push_back(std::thread([&]() {
+            for (int index = next++; index < count; index = next++)
+                work(index);
+        }));
+    }
+    for (std::vector<std::thread>::iterator it = workers.begin(); it != workers.end(); it++)
+        it->join();
+}
+
+// The assembly of a source file goes next to it, in name.s
+static std::string assemblyName(std::string source) {
+    std::string::size_type dot = source.rfind('.');
+    if (dot != std::string::npos && source.find('/', dot) == std::string::npos)
+        source = source.substr(0, dot);
+    return source + ".s";
+}
+
+// Compiles a program one class at a time, as the parser reads it (see
+// --stream). Each class is checked with the tables of the classes
+// before it, generated, and then deleted, with the tables of its
+// methods' locals; only the signatures of the classes (their members
+// and the types of their methods) are kept. After a type error the
+// remaining classes are only checked. The assembly of the classes
+// before an error has already been written by then, so it is only
+// usable if this returns true (there were no errors).
+static bool compileByClass(FILE* file, CodeGenerator* codegen, bool countNodes) {
+    TypeCheck* typecheck = new TypeCheck();
+    typecheck->classTable = new ClassTable;
+    ClassTable* classTable = typecheck->classTable;
+
+    codegen->beginProgram(false);
+    ProgramNode* program = parse(file, NULL, [&](ClassNode* node) {
+        std::string name = node->identifier_1->name;
+        bool redefined = classTable->count(name) > 0;
+        typecheck->visitClassNode(node);
+        if (typeErrorCount == 0) {
+            bind(node, classTable);
+            codegen->visitClassNode(node);
+        }
+
+        // The class is deleted by the program made to hold it
+        ProgramNode* holder = new ProgramNode(new std::list<ClassNode*>(1, node));
+        if (countNodes)
+            stats.countNodes(holder);
+        delete holder;
+        if (!redefined) {
+            MethodTable* methods = classTable->find(name)->second.methods;
+            for (MethodTable::iterator it = methods->begin(); it != methods->end(); it++)
+                it->second.variables->clear();
+        }
+    });
+    typecheck->checkMain(program);
+    delete program;
+    if (typeErrorCount > 0)
+        return false;
+    codegen->endProgram(false);
+    return true;
+}
+
+static void reportStats(bool json) {
+    if (json)
+        stats.printJSON(std::cerr);
+    else
+        stats.printText(std::cerr);
+}
+
+int main(int argc, char** argv) {
     yydebug = 0; // Set this to 1 if you want the parser to output debug information and parse process
-    
+
+    PassManager* passManager = new PassManager();
+
+    // --stats prints phase timings and counters to stderr when
+    // compilation finishes; --stats=json prints them as JSON.
+    // -O0 (the default), -O1 and -O2 select the optimization passes,
+    // and --print-after=<pass> prints the AST after a pass runs.
+    // --dump-ir builds the SSA IR, verifies it and prints it to stderr.
+    // --instrument makes the program write its profile to lang.profile
+    // when it exits, and --profile-use=<file> optimizes using one.
+    // -g adds line information for debuggers and profilers. The
+    // source is read from the file named on the command line, if
+    // any, and from stdin otherwise. A program may also be split
+    // into several files, which are parsed in parallel and checked
+    // and optimized as one program (in the order given, so a
+    // superclass must come first); the code for each file is then
+    // generated in parallel into name.s (for name.lang), and the
+    // files link together. All type errors are reported,
+    // up to --max-errors=<n> of them (20 by default, 0 for no limit).
+    // --pack-objects packs boolean members into bytes and puts the
+    // most used members of each class first. --stream compiles a
+    // single file one class at a time, as it is parsed, keeping only
+    // one class in memory (and the signatures of those before it); it
+    // runs no optimization passes, which need the whole program, only
+    // the code generator's own (at -O1 and up).
+    bool stream = false;
+    bool printStats = false;
+    bool dumpIR = false;
+    bool statsJSON = false;
+    bool instrument = false;
+    bool debugInfo = false;
+    bool packObjects = false;
+    std::string profileFile;
+    std::vector<std::string> sources;
+    int optLevel = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--stats") == 0) {
+            printStats = true;
+        } else if (strcmp(argv[i], "--stats=json") == 0) {
+            printStats = true;
+            statsJSON = true;
+        } else if (strcmp(argv[i], "-O0") == 0 || strcmp(argv[i], "-O1") == 0 || strcmp(argv[i], "-O2") == 0) {
+            optLevel = argv[i][2] - '0';
+        } else if (strncmp(argv[i], "--print-after=", 14) == 0) {
+            std::string pass = argv[i] + 14;
+            if (pass != "all" && !passManager->hasPass(pass)) {
+                std::cerr << "Unknown pass: " << pass << std::endl;
+                return 1;
+            }
+            passManager->printAfter.insert(pass);
+        } else if (strcmp(argv[i], "--dump-ir") == 0) {
+            dumpIR = true;
+        } else if (strcmp(argv[i], "-g") == 0) {
+            debugInfo = true;
+        } else if (strcmp(argv[i], "--pack-objects") == 0) {
+            packObjects = true;
+        } else if (strcmp(argv[i], "--stream") == 0) {
+            stream = true;
+        } else if (strcmp(argv[i], "--instrument") == 0) {
+            instrument = true;
+        } else if (strncmp(argv[i], "--profile-use=", 14) == 0) {
+            profileFile = argv[i] + 14;
+        } else if (strncmp(argv[i], "--max-errors=", 13) == 0) {
+            typeErrorLimit = atoi(argv[i] + 13);
+        } else if (argv[i][0] != '-') {
+            sources.push_back(argv[i]);
+        } else {
+            std::cerr << "Unknown option: " << argv[i] << std::endl;
+            return 1;
+        }
+    }
+
+    std::vector<FILE*> files;
+    for (std::vector<std::string>::iterator it = sources.begin(); it != sources.end(); it++) {
+        files.push_back(fopen(it->c_str(), "r"));
+        if (!files.back()) {
+            std::cerr << "Cannot open " << *it << std::endl;
+            return 1;
+        }
+    }
+
+    // A streamed program is compiled as it is parsed
+    if (stream) {
+        if (sources.size() > 1 || packObjects || dumpIR || instrument || !profileFile.empty() ||
+            !passManager->printAfter.empty()) {
+            std::cerr << "--stream compiles a single file, without --pack-objects, --dump-ir, profiles or passes" << std::endl;
+            return 1;
+        }
+        if (!sources.empty())
+            sourceName = sources[0];
+        CodeGenerator* codegen = new CodeGenerator();
+        codegen->tailCalls = optLevel >= 1;
+        codegen->selectInstructions = optLevel >= 1;
+        codegen->debugInfo = debugInfo;
+        codegen->sourceName = sourceName;
+        stats.beginPhase("stream");
+        bool compiled = compileByClass(files.empty() ? stdin : files[0], codegen, printStats);
+        stats.counters[stat_instructions_emitted] += codegen->instructionsEmitted;
+        stats.endPhase();
+        if (!compiled)
+            return 1;
+        if (printStats)
+            reportStats(statsJSON);
+        return 0;
+    }
+
+    // A program made of several files is placed at the start of the
+    // first one
+    if (!sources.empty())
+        sourceName = sources[0];
+    bool separateFiles = sources.size() > 1;
+
+    // Each file is parsed into its own program, with its own scanner;
+    // their classes are then merged into one program
     astRoot = NULL;
-    
-    yyparse();
-    
+    std::vector<ProgramNode*> programs(std::max<size_t>(files.size(), 1));
+    stats.beginPhase("parse");
+    if (!separateFiles) {
+        programs[0] = parse(files.empty() ? stdin : files[0], NULL);
+        astRoot = programs[0];
+    } else {
+        inParallel(files.size(), [&](int i) { programs[i] = parse(files[i], sources[i].c_str()); });
+        std::list<ClassNode*>* classes = new std::list<ClassNode*>();
+        for (size_t i = 0; i < programs.size(); i++)
+            classes->insert(classes->end(), programs[i]->class_list->begin(), programs[i]->class_list->end());
+        astRoot = new ProgramNode(classes);
+        astRoot->location = programs[0]->location;
+    }
+    stats.endPhase();
+
     if (astRoot) {
+        stats.beginPhase("typecheck");
         TypeCheck* typecheck = new TypeCheck();
+        if (separateFiles) {
+            for (size_t i = 0; i < programs.size(); i++) {
+                for (std::list<ClassNode*>::iterator it = programs[i]->class_list->begin(); it != programs[i]->class_list->end(); it++)
+                    typecheck->classFiles[*it] = sources[i];
+            }
+        }
         astRoot->accept(typecheck);
+        stats.endPhase();
+        if (typeErrorCount > 0)
+            return 1;
         ClassTable* classTable = typecheck->classTable;
         if (classTable) {
+            if (instrument || !profileFile.empty())
+                profile.number((ProgramNode*)astRoot);
+            if (!profileFile.empty()) {
+                std::string error;
+                if (!profile.load(profileFile, &error))
+                    std::cerr << "Profile not used: " << error << std::endl;
+            }
+
+            if (packObjects)
+                passManager->addPass("layout");
+            passManager->addPassesForLevel(optLevel);
+            passManager->run((ProgramNode*)astRoot, classTable);
+
+            if (dumpIR) {
+                stats.beginPhase("ssa");
+                IRModule* module = buildIR((ProgramNode*)astRoot, classTable);
+                std::vector<std::string> errors = verify(module);
+                stats.endPhase();
+                for (std::vector<std::string>::iterator it = errors.begin(); it != errors.end(); it++)
+                    std::cerr << "IR error: " << *it << std::endl;
+                dump(module, std::cerr);
+                if (!errors.empty())
+                    return 1;
+            }
+
             // Uncomment the following line to print the class table after it is generated
             //print(*classTable);
-            CodeGenerator* codegen = new CodeGenerator();
-            codegen->classTable = classTable;
-            astRoot->accept(codegen);
+            // A single program goes to stdout, and each file of a
+            // program made of several to its own assembly file
+            stats.beginPhase("codegen");
+            std::vector<CodeGenerator*> generators(programs.size());
+            inParallel(programs.size(), [&](int i) {
+                CodeGenerator* codegen = new CodeGenerator();
+                codegen->tailCalls = optLevel >= 1;
+                codegen->selectInstructions = optLevel >= 1;
+                codegen->instrument = instrument;
+                codegen->debugInfo = debugInfo;
+                codegen->sourceName = separateFiles ? sources[i] : sourceName;
+                codegen->globalSymbols = separateFiles;
+                if (separateFiles) {
+                    std::ofstream assembly(assemblyName(sources[i]).c_str());
+                    codegen->out = &assembly;
+                    programs[i]->accept(codegen);
+                } else {
+                    astRoot->accept(codegen);
+                }
+                generators[i] = codegen;
+            });
+            for (std::vector<CodeGenerator*>::iterator it = generators.begin(); it != generators.end(); it++)
+                stats.counters[stat_instructions_emitted] += (*it)->instructionsEmitted;
+            stats.endPhase();
         }
     }
 
+    if (printStats) {
+        if (astRoot)
+            stats.countNodes(astRoot);
+        reportStats(statsJSON);
+    }
+
     return 0;
 }
@@ -0,0 +1,82 @@
+from subprocess import Popen, PIPE
+from os import listdir, path, cpu_count
+from concurrent.futures import ThreadPoolExecutor
+import argparse
+import re
+import sys
+
+# Compares the hand-written parser against the bison one, which stays
+# the reference. Every program in tests/ and bench/programs is compiled
+# by both builds of the compiler, and the assembly (with -g, so the line
+# information is compared too), the messages and the exit status must
+# be the same. Each program is also compiled cut short at a few points,
+# to check that both report a syntax error at the same token; the list
+# of expected tokens is left out of that comparison, since the
+# hand-written parser names at most one.
+
+dirs = ["tests", path.join("bench", "programs")]
+
+# How many truncated copies of each program are compiled
+cuts = 8
+
+def compile(lang, flags, source):
+	p = Popen([lang] + flags, stdin=PIPE, stdout=PIPE, stderr=PIPE)
+	(out, err) = p.communicate(source)
+	return (p.returncode, out, err)
+
+def normalize(err):
+	return re.sub(rb", expecting [^\n]*? at line", b" at line", err)
+
+# Returns a description of how the two compilers differ on a source,
+# or None if they agree
+def differs(reference, descent, flags, source, syntaxOnly):
+	(code1, out1, err1) = compile(reference, flags, source)
+	(code2, out2, err2) = compile(descent, flags, source)
+	if (syntaxOnly):
+		(err1, err2) = (normalize(err1), normalize(err2))
+	if (code1 != code2):
+		return "exit status %d, but %d" % (code1, code2)
+	if (err1 != err2):
+		return "messages differ:\n  " + err1.decode("utf-8", "replace").strip() + "\n  " + err2.decode("utf-8", "replace").strip()
+	if (out1 != out2):
+		return "assembly differs"
+	return None
+
+def check(f, reference, descent, flags):
+	with open(f, "rb") as infile:
+		source = infile.read()
+	report = []
+	why = differs(reference, descent, flags, source, False)
+	if (why):
+		report.append(f + ": " + why)
+	for i in range(1, cuts + 1):
+		cut = len(source) * i // (cuts + 1)
+		why = differs(reference, descent, flags, source[:cut], True)
+		if (why):
+			report.append(f + " (cut at byte %d): %s" % (cut, why))
+	return report
+
+def main():
+	parser = argparse.ArgumentParser(description="Check that the bison and the hand-written parser give the same output for every program.")
+	parser.add_argument("reference", help="The compiler built with the bison parser")
+	parser.add_argument("descent", help="The compiler built with PARSER=descent")
+	parser.add_argument("-j", metavar="jobs", type=int, default=cpu_count(), help="Number of programs to check at once (default: all cores)")
+	parser.add_argument("--flags", metavar="flags", type=str, default="-g", help="Flags to pass to both compilers (default: -g)")
+	args = parser.parse_args()
+
+	files = []
+	for d in dirs:
+		if (path.isdir(d)):
+			files += sorted([path.join(d, f) for f in listdir(d) if f.endswith(".lang")])
+
+	with ThreadPoolExecutor(max_workers=max(1, args.j or 1)) as pool:
+		reports = list(pool.map(lambda f: check(f, args.reference, args.descent, args.flags.split()), files))
+
+	failures = [line for report in reports for line in report]
+	for line in failures:
+		print(line)
+	print("%d programs checked, %d differences" % (len(files), len(failures)))
+	sys.exit(1 if failures else 0)
+
+if __name__ == "__main__":
+	main()
@@ -6,21 +6,55 @@
     
     #define YYDEBUG 1
     #define YYINITDEPTH 10000
-    
-    int yylex(void);
-    void yyerror(const char *);
-    
-    extern ASTNode* astRoot;
+
+    // The packed position of a symbol, for stamping the node made
+    // for it. Binary expressions are placed at their operator.
+    #define LOCATION(position) makeLocation((position).first_line, (position).first_column)
 %}
 
+// The parser and the lexer keep no global state, so that several
+// files can be parsed at once, each on its own thread with its own
+// scanner (see parse below and openScanner in lexer.l)
+%define api.pure full
+%locations
+%lex-param {void* scanner}
+%parse-param {void* scanner} {ProgramNode** program} {ClassHandler* onClass}
 %error-verbose
 // %glr-parser
 /* NOTE: You may use the %glr-parser directive, which may allow your parser to
          work even with some shift/reduce conflicts remianing. */
 
+%code requires {
+    #include <functional>
+
+    // Takes each class of a program as soon as it is parsed, for a
+    // compiler that handles the classes one at a time (see --stream)
+    typedef std::function<void(ClassNode*)> ClassHandler;
+}
+
+%code provides {
+    int yylex(YYSTYPE* value, YYLTYPE* location, void* scanner);
+    void yyerror(YYLTYPE* location, void* scanner, ProgramNode** program, ClassHandler* onClass, const char* message);
+
+    // Parses a whole source file, read from file, with the bison
+    // parser (or the one in descentparser.cpp). name is put before
+    // the position in syntax errors, unless it is NULL. If onClass
+    // is given, each class is handed to it instead of being added to
+    // the program, which then has no classes.
+    ProgramNode* parse(FILE* file, const char* name, ClassHandler onClass = ClassHandler());
+
+    // A scanner for one file (see lexer.l)
+    void* openScanner(FILE* file, const char* name);
+    void closeScanner(void* scanner);
+    // Reports a lexical or syntax error in the file a scanner reads,
+    // and exits
+    void parseError(const YYLTYPE* location, void* scanner, const char* message);
+}
+
 /* WRITEME: Copy your token and precedence specifiers from Project 5 here. */
 %token T_OPENPAREN T_CLOSEPAREN T_OPENBRACE T_CLOSEBRACE
 %token T_INTEGER T_BOOLEAN T_NEW T_NONE
+%token T_TASK T_SPAWN T_JOIN
 %token T_PERIOD T_COMMA T_SEMICOLON
 %token T_IF T_ELSE T_WHILE T_DO
 %token T_TRUE T_FALSE
@@ -44,7 +78,7 @@
 %left T_GREAT T_GREATEQ T_EQUALS
 %left T_PLUS T_MINUS
 %left T_MULTIPLY T_DIVIDE
-%precedence T_NOT T_UNARYMINUS
+%precedence T_NOT T_UNARYMINUS T_JOIN
 
 /* WRITEME: Copy your type specifiers from Project 5 here. */
 %type <program_ptr> Start
@@ -57,7 +91,7 @@
 %type <method_ptr> MethodsP
 %type <parameter_list_ptr> ParameterList ParametersP
 
-%type <type_ptr> ReturnType Type
+%type <type_ptr> ReturnType Type ValueType
 %type <methodbody_ptr> Body
 %type <statement_list_ptr> Statements Block
 %type <returnstatement_ptr> Return
@@ -84,22 +118,22 @@
 /* WRITEME: This rule is a placeholder. Replace it with your grammar
             rules and actions from Project 5. */
 
-Start : ClassList                                                             { $$ = new ProgramNode($1); astRoot = $$; }
+Start : ClassList                                                             { $$ = new ProgramNode($1); $$->location = LOCATION(@1); *program = $$; }
       ;
 
-ClassList : Class ClassList                                                   { $$ = $2; $$->push_front($1); }
-          | Class                                                             { $$ = new std::list<ClassNode*>(); $$->push_front($1); }
+ClassList : ClassList Class                                                   { $$ = $1; if (*onClass) (*onClass)($2); else $$->push_back($2); }
+          | Class                                                             { $$ = new std::list<ClassNode*>(); if (*onClass) (*onClass)($1); else $$->push_back($1); }
           ;
 
-Class : T_IDENT T_OPENBRACE Members Methods T_CLOSEBRACE                      { $$ = new ClassNode($1, NULL, $3, $4); }
-      | T_IDENT T_EXTENDS T_IDENT T_OPENBRACE Members Methods T_CLOSEBRACE    { $$ = new ClassNode($1, $3, $5, $6); }
+Class : T_IDENT T_OPENBRACE Members Methods T_CLOSEBRACE                      { $$ = new ClassNode($1, NULL, $3, $4); $$->location = LOCATION(@1); }
+      | T_IDENT T_EXTENDS T_IDENT T_OPENBRACE Members Methods T_CLOSEBRACE    { $$ = new ClassNode($1, $3, $5, $6); $$->location = LOCATION(@1); }
       ;
 
 Members : Members MembersP                                                    { $$ = $1; $$->push_back($2); }
         | %empty                                                              { $$ = new std::list<DeclarationNode*>(); }          
         ;
 
-MembersP : Type MembersPP T_SEMICOLON                                         { $$ = new DeclarationNode($1, $2); }                                  
+MembersP : Type MembersPP T_SEMICOLON                                         { $$ = new DeclarationNode($1, $2); $$->location = LOCATION(@1); }                                  
          ;
 
 MembersPP : T_IDENT                                                           { $$ = new std::list<IdentifierNode*>(); $$->push_back($1); }
@@ -109,32 +143,32 @@ Methods : MethodsP Methods                                                    {
         | %empty                                                              { $$ = new std::list<MethodNode*>(); }
         ;
 
-MethodsP : T_IDENT T_OPENPAREN ParameterList T_CLOSEPAREN T_LAMBDA ReturnType T_OPENBRACE Body T_CLOSEBRACE   { $$ = new MethodNode($1, $3, $6, $8); }
+MethodsP : T_IDENT T_OPENPAREN ParameterList T_CLOSEPAREN T_LAMBDA ReturnType T_OPENBRACE Body T_CLOSEBRACE   { $$ = new MethodNode($1, $3, $6, $8); $$->location = LOCATION(@1); }
          ;
 
 ParameterList : Parameters ParametersP                              { $$ = $2; $$->push_front($1); }
               | %empty                                              { $$ = new std::list<ParameterNode*>(); }
               ;
 
-Parameters : Type T_IDENT                                           { $$ = new ParameterNode($1, $2); }
+Parameters : Type T_IDENT                                           { $$ = new ParameterNode($1, $2); $$->location = LOCATION(@1); }
             ;
 
 ParametersP : T_COMMA Parameters ParametersP                        { $$ = $3; $$->push_front($2); } 
            | %empty                                                 { $$ = new std::list<ParameterNode*>(); }
            ;
 
-Body : DeclarationList Statements Return                            { $$ = new MethodBodyNode($1, $2, $3); }
-     | DeclarationList Statements                                   { $$ = new MethodBodyNode($1, $2, NULL); }
+Body : DeclarationList Statements Return                            { $$ = new MethodBodyNode($1, $2, $3); $$->location = LOCATION(@1); }
+     | DeclarationList Statements                                   { $$ = new MethodBodyNode($1, $2, NULL); $$->location = LOCATION(@1); }
      ;
 
-Return : T_RETURN Expr T_SEMICOLON                                  { $$ = new ReturnStatementNode($2); }
+Return : T_RETURN Expr T_SEMICOLON                                  { $$ = new ReturnStatementNode($2); $$->location = LOCATION(@1); }
        ;
 
 DeclarationList : DeclarationList Declarations                      { $$ = $1; $$->push_back($2); }
                 | %empty                                            { $$ = new std::list<DeclarationNode*>(); }
                 ;
 
-Declarations : Type DeclarationsP T_SEMICOLON                       { $$ = new DeclarationNode($1, $2); }
+Declarations : Type DeclarationsP T_SEMICOLON                       { $$ = new DeclarationNode($1, $2); $$->location = LOCATION(@1); }
               ;
 
 DeclarationsP : T_IDENT DeclarationsPP                              { $$ = $2; $$->push_front($1); }
@@ -156,54 +190,56 @@ StatementsP : Assignment        { $$ = $1; }
             | Print             { $$ = $1; }
             ;
 
-Assignment : T_IDENT T_EQ Expr T_SEMICOLON                          { $$ = new AssignmentNode($1, NULL, $3); }
-           | T_IDENT T_PERIOD T_IDENT T_EQ Expr T_SEMICOLON         { $$ = new AssignmentNode($1, $3, $5); }
+Assignment : T_IDENT T_EQ Expr T_SEMICOLON                          { $$ = new AssignmentNode($1, NULL, $3); $$->location = LOCATION(@1); }
+           | T_IDENT T_PERIOD T_IDENT T_EQ Expr T_SEMICOLON         { $$ = new AssignmentNode($1, $3, $5); $$->location = LOCATION(@1); }
            ;
 
-MethodCallExpr : MethodCall T_SEMICOLON                             { $$ = new CallNode($1); }
+MethodCallExpr : MethodCall T_SEMICOLON                             { $$ = new CallNode($1); $$->location = LOCATION(@1); }
                ;
 
-IfElse : T_IF Expr T_OPENBRACE Block T_CLOSEBRACE                                                 { $$ = new IfElseNode($2, $4, NULL); }
-       | T_IF Expr T_OPENBRACE Block T_CLOSEBRACE T_ELSE T_OPENBRACE Block T_CLOSEBRACE           { $$ = new IfElseNode($2, $4, $8); }
+IfElse : T_IF Expr T_OPENBRACE Block T_CLOSEBRACE                                                 { $$ = new IfElseNode($2, $4, NULL); $$->location = LOCATION(@1); }
+       | T_IF Expr T_OPENBRACE Block T_CLOSEBRACE T_ELSE T_OPENBRACE Block T_CLOSEBRACE           { $$ = new IfElseNode($2, $4, $8); $$->location = LOCATION(@1); }
        ;
 
-WhileLoop : T_WHILE Expr T_OPENBRACE Block T_CLOSEBRACE                                           { $$ = new WhileNode($2, $4); }
+WhileLoop : T_WHILE Expr T_OPENBRACE Block T_CLOSEBRACE                                           { $$ = new WhileNode($2, $4); $$->location = LOCATION(@1); }
           ;
 
-DoWhile : T_DO T_OPENBRACE Block T_CLOSEBRACE T_WHILE T_OPENPAREN Expr T_CLOSEPAREN T_SEMICOLON   { $$ = new DoWhileNode($3, $7); }
+DoWhile : T_DO T_OPENBRACE Block T_CLOSEBRACE T_WHILE T_OPENPAREN Expr T_CLOSEPAREN T_SEMICOLON   { $$ = new DoWhileNode($3, $7); $$->location = LOCATION(@1); }
         ;
 
-Print : T_PRINT Expr T_SEMICOLON                  { $$ = new PrintNode($2); }
+Print : T_PRINT Expr T_SEMICOLON                  { $$ = new PrintNode($2); $$->location = LOCATION(@1); }
       ;
 
 Block : StatementsP Block                         { $$ = $2; $$->push_front($1); }
       | StatementsP                               { $$ = new std::list<StatementNode*>(); $$->push_front($1); }
       ;
 
-Expr : Expr T_PLUS Expr                           { $$ = new PlusNode($1, $3); }
-     | Expr T_MINUS Expr                          { $$ = new MinusNode($1, $3); }
-     | Expr T_MULTIPLY Expr                       { $$ = new TimesNode($1, $3); }
-     | Expr T_DIVIDE Expr                         { $$ = new DivideNode($1, $3); }
-     | Expr T_GREAT Expr                          { $$ = new GreaterNode($1, $3); }
-     | Expr T_GREATEQ Expr                        { $$ = new GreaterEqualNode($1, $3); }
-     | Expr T_EQUALS Expr                         { $$ = new EqualNode($1, $3); }
-     | Expr T_AND Expr                            { $$ = new AndNode($1, $3); }
-     | Expr T_OR Expr                             { $$ = new OrNode($1, $3); }
-     | T_NOT Expr                                 { $$ = new NotNode($2); }
-     | T_MINUS Expr %prec T_UNARYMINUS            { $$ = new NegationNode($2); }
-     | T_IDENT                                    { $$ = new VariableNode($1); }
-     | T_IDENT T_PERIOD T_IDENT                   { $$ = new MemberAccessNode($1, $3); }
+Expr : Expr T_PLUS Expr                           { $$ = new PlusNode($1, $3); $$->location = LOCATION(@2); }
+     | Expr T_MINUS Expr                          { $$ = new MinusNode($1, $3); $$->location = LOCATION(@2); }
+     | Expr T_MULTIPLY Expr                       { $$ = new TimesNode($1, $3); $$->location = LOCATION(@2); }
+     | Expr T_DIVIDE Expr                         { $$ = new DivideNode($1, $3); $$->location = LOCATION(@2); }
+     | Expr T_GREAT Expr                          { $$ = new GreaterNode($1, $3); $$->location = LOCATION(@2); }
+     | Expr T_GREATEQ Expr                        { $$ = new GreaterEqualNode($1, $3); $$->location = LOCATION(@2); }
+     | Expr T_EQUALS Expr                         { $$ = new EqualNode($1, $3); $$->location = LOCATION(@2); }
+     | Expr T_AND Expr                            { $$ = new AndNode($1, $3); $$->location = LOCATION(@2); }
+     | Expr T_OR Expr                             { $$ = new OrNode($1, $3); $$->location = LOCATION(@2); }
+     | T_NOT Expr                                 { $$ = new NotNode($2); $$->location = LOCATION(@1); }
+     | T_MINUS Expr %prec T_UNARYMINUS            { $$ = new NegationNode($2); $$->location = LOCATION(@1); }
+     | T_IDENT                                    { $$ = new VariableNode($1); $$->location = LOCATION(@1); }
+     | T_IDENT T_PERIOD T_IDENT                   { $$ = new MemberAccessNode($1, $3); $$->location = LOCATION(@1); }
      | MethodCall                                 { $$ = $1; }
      | T_OPENPAREN Expr T_CLOSEPAREN              { $$ = $2; }
-     | T_LITERAL                                  { $$ = new IntegerLiteralNode($1); }
-     | T_TRUE                                     { $$ = new BooleanLiteralNode($1); }
-     | T_FALSE                                    { $$ = new BooleanLiteralNode($1); }
-     | T_NEW T_IDENT                              { $$ = new NewNode($2, NULL); }            
-     | T_NEW T_IDENT T_OPENPAREN Arguments T_CLOSEPAREN                       { $$ = new NewNode($2, $4); }
+     | T_LITERAL                                  { $$ = new IntegerLiteralNode($1); $$->location = LOCATION(@1); }
+     | T_TRUE                                     { $$ = new BooleanLiteralNode($1); $$->location = LOCATION(@1); }
+     | T_FALSE                                    { $$ = new BooleanLiteralNode($1); $$->location = LOCATION(@1); }
+     | T_NEW T_IDENT                              { $$ = new NewNode($2, NULL); $$->location = LOCATION(@1); }            
+     | T_NEW T_IDENT T_OPENPAREN Arguments T_CLOSEPAREN                       { $$ = new NewNode($2, $4); $$->location = LOCATION(@1); }
+     | T_SPAWN MethodCall                         { $$ = new SpawnNode($2); $$->location = LOCATION(@1); }
+     | T_JOIN Expr                                { $$ = new JoinNode($2); $$->location = LOCATION(@1); }
      ;
 
-MethodCall : T_IDENT T_OPENPAREN Arguments T_CLOSEPAREN                       { $$ = new MethodCallNode($1, NULL, $3); }
-           | T_IDENT T_PERIOD T_IDENT T_OPENPAREN Arguments T_CLOSEPAREN      { $$ = new MethodCallNode($1, $3, $5); }
+MethodCall : T_IDENT T_OPENPAREN Arguments T_CLOSEPAREN                       { $$ = new MethodCallNode($1, NULL, $3); $$->location = LOCATION(@1); }
+           | T_IDENT T_PERIOD T_IDENT T_OPENPAREN Arguments T_CLOSEPAREN      { $$ = new MethodCallNode($1, $3, $5); $$->location = LOCATION(@1); }
            ;
 
 Arguments : ArgumentsP                            { $$ = $1; }
@@ -215,19 +251,28 @@ ArgumentsP : ArgumentsP T_COMMA Expr              { $$ = $1; $$->push_back($3);}
            ;
 
 ReturnType : Type                                 { $$ = $1; }
-           | T_NONE                               { $$ = new NoneNode(); }
+           | T_NONE                               { $$ = new NoneNode(); $$->location = LOCATION(@1); }
            ;
 
-Type : T_INTEGER                                  { $$ = new IntegerTypeNode(); }
-     | T_BOOLEAN                                  { $$ = new BooleanTypeNode(); }
-     | T_IDENT                                    { $$ = new ObjectTypeNode($1); }
+Type : ValueType                                  { $$ = $1; }
+     | T_TASK ValueType                           { $$ = new TaskTypeNode($2); $$->location = LOCATION(@1); }
      ;
 
+ValueType : T_INTEGER                             { $$ = new IntegerTypeNode(); $$->location = LOCATION(@1); }
+          | T_BOOLEAN                             { $$ = new BooleanTypeNode(); $$->location = LOCATION(@1); }
+          | T_IDENT                               { $$ = new ObjectTypeNode($1); $$->location = LOCATION(@1); }
+          ;
+
 %%
 
-extern int yylineno;
+void yyerror(YYLTYPE* location, void* scanner, ProgramNode** program, ClassHandler* onClass, const char* message) {
+  parseError(location, scanner, message);
+}
 
-void yyerror(const char *s) {
-  fprintf(stderr, "%s at line %d\n", s, yylineno);
-  exit(1);
+ProgramNode* parse(FILE* file, const char* name, ClassHandler onClass) {
+  void* scanner = openScanner(file, name);
+  ProgramNode* program = NULL;
+  yyparse(scanner, &program, &onClass);
+  closeScanner(scanner);
+  return program;
 }
\ No newline at end of file
@@ -0,0 +1,247 @@
+#include "partialevaluation.hpp"
+
+#include <climits>
+
+void PartialEvaluation::run(ProgramNode* program, ClassTable* classTable) {
+  this->classTable = classTable;
+  effects = computeEffects(program, classTable);
+  methods.clear();
+  scopes.clear();
+  results.clear();
+  for (std::list<ClassNode*>::iterator c = program->class_list->begin(); c != program->class_list->end(); c++) {
+    for (std::list<MethodNode*>::iterator m = (*c)->method_list->begin(); m != (*c)->method_list->end(); m++) {
+      std::string className = (*c)->identifier_1->name;
+      std::string label = className + "_" + (*m)->identifier->name;
+      methods[label] = std::make_pair(className, *m);
+      scopes[label] = MethodScope(classTable, className, (*m)->identifier->name);
+    }
+  }
+
+  for (std::list<ClassNode*>::iterator c = program->class_list->begin(); c != program->class_list->end(); c++) {
+    for (std::list<MethodNode*>::iterator m = (*c)->method_list->begin(); m != (*c)->method_list->end(); m++) {
+      scope = scopes[(*c)->identifier_1->name + "_" + (*m)->identifier->name];
+      (*m)->methodbody->accept(this);
+    }
+  }
+}
+
+// Constructors are left out: their result is an object
+bool PartialEvaluation::canEvaluate(std::string label) {
+  if (!methods.count(label) || !effects.count(label))
+    return false;
+  std::pair<std::string, MethodNode*>& method = methods[label];
+  if (method.first == method.second->identifier->name)
+    return false;
+  Effects& effect = effects[label];
+  return isPure(effect) && !effect.readsMemory;
+}
+
+// Arguments are evaluated before the call is replaced, so a call
+// whose arguments are constant calls is replaced as a whole
+void PartialEvaluation::visitMethodCallNode(MethodCallNode* node) {
+  ExpressionRewriter::visitMethodCallNode(node);
+  if (node->basetype != bt_integer && node->basetype != bt_boolean)
+    return;
+  if (budget <= 0 || !canEvaluate(scope.callTarget(node)))
+    return;
+
+  Frame frame;
+  int value;
+  fuel = EVALUATION_FUEL;
+  depth = 0;
+  exhausted = false;
+  if (!call(node, &scope, &frame, &value))
+    return;
+
+  if (node->basetype == bt_integer) {
+    result = integerLiteral(value);
+  } else {
+    BooleanLiteralNode* literal = new BooleanLiteralNode(new IntegerNode(value));
+    literal->basetype = bt_boolean;
+    result = literal;
+  }
+}
+
+// Evaluates the arguments of a call in the caller's frame, then the
+// callee. The object a call goes through is not needed: the callee
+// reads no members.
+bool PartialEvaluation::call(MethodCallNode* node, MethodScope* scope, Frame* frame, int* value) {
+  std::vector<int> arguments;
+  for (std::list<ExpressionNode*>::iterator it = node->expression_list->begin(); it != node->expression_list->end(); it++) {
+    int argument;
+    if (!evaluate(*it, scope, frame, &argument))
+      return false;
+    arguments.push_back(argument);
+  }
+  return call(scope->callTarget(node), arguments, value);
+}
+
+bool PartialEvaluation::call(std::string label, std::vector<int>& arguments, int* value) {
+  std::pair<std::string, std::vector<int> > key = std::make_pair(label, arguments);
+  std::map<std::pair<std::string, std::vector<int> >, std::pair<bool, int> >::iterator known = results.find(key);
+  if (known != results.end()) {
+    *value = known->second.second;
+    return known->second.first;
+  }
+  if (!canEvaluate(label))
+    return false;
+  if (depth >= EVALUATION_DEPTH) {
+    exhausted = true;
+    return false;
+  }
+  // A call made from the code being compiled, rather than from
+  // another evaluation, starts with all the fuel
+  bool outermost = depth == 0;
+  if (outermost) {
+    fuel = EVALUATION_FUEL;
+    exhausted = false;
+  }
+
+  MethodNode* method = methods[label].second;
+  MethodScope* callee = &scopes[label];
+  Frame frame;
+  std::vector<int>::iterator argument = arguments.begin();
+  for (std::list<ParameterNode*>::iterator it = method->parameter_list->begin(); it != method->parameter_list->end(); it++)
+    frame[(*it)->identifier->name] = *argument++;
+
+  depth++;
+  bool evaluated = execute(method->methodbody->statement_list, callee, &frame) &&
+                   method->methodbody->returnstatement &&
+                   evaluate(method->methodbody->returnstatement->expression, callee, &frame, value);
+  depth--;
+
+  // Running out of fuel or depth inside another evaluation says
+  // nothing about the call itself, only about where it was evaluated
+  // from, so it is not remembered; with all the fuel, it is
+  if (evaluated)
+    results[key] = std::make_pair(true, *value);
+  else if (!exhausted || outermost)
+    results[key] = std::make_pair(false, 0);
+  return evaluated;
+}
+
+bool PartialEvaluation::execute(std::list<StatementNode*>* statements, MethodScope* scope, Frame* frame) {
+  if (!statements)
+    return true;
+  for (std::list<StatementNode*>::iterator it = statements->begin(); it != statements->end(); it++) {
+    if (!execute(*it, scope, frame))
+      return false;
+  }
+  return true;
+}
+
+bool PartialEvaluation::execute(StatementNode* node, MethodScope* scope, Frame* frame) {
+  if (--fuel <= 0 || --budget <= 0) {
+    exhausted = true;
+    return false;
+  }
+  int value;
+  switch (node->kind) {
+  case kind_assignment: {
+    AssignmentNode* assignment = static_cast<AssignmentNode*>(node);
+    if (assignment->identifier_2 || !scope->isLocal(assignment->identifier_1->name))
+      return false;
+    if (!evaluate(assignment->expression, scope, frame, &value))
+      return false;
+    (*frame)[assignment->identifier_1->name] = value;
+    return true;
+  }
+  case kind_call:
+    return call(static_cast<CallNode*>(node)->methodcall, scope, frame, &value);
+  case kind_ifelse: {
+    IfElseNode* ifElse = static_cast<IfElseNode*>(node);
+    if (!evaluate(ifElse->expression, scope, frame, &value))
+      return false;
+    return execute(value ? ifElse->statement_list_1 : ifElse->statement_list_2, scope, frame);
+  }
+  case kind_while: {
+    WhileNode* loop = static_cast<WhileNode*>(node);
+    while (true) {
+      if (!evaluate(loop->expression, scope, frame, &value))
+        return false;
+      if (!value)
+        return true;
+      if (!execute(loop->statement_list, scope, frame))
+        return false;
+    }
+  }
+  case kind_dowhile: {
+    DoWhileNode* loop = static_cast<DoWhileNode*>(node);
+    while (true) {
+      if (!execute(loop->statement_list, scope, frame))
+        return false;
+      if (!evaluate(loop->expression, scope, frame, &value))
+        return false;
+      if (!value)
+        return true;
+    }
+  }
+  default:
+    return false;
+  }
+}
+
+// Arithmetic is done on unsigned values, as in constant folding, so
+// that overflow wraps the way it does in the generated code
+bool PartialEvaluation::evaluate(ExpressionNode* node, MethodScope* scope, Frame* frame, int* value) {
+  if (--fuel <= 0 || --budget <= 0) {
+    exhausted = true;
+    return false;
+  }
+
+  switch (node->kind) {
+  case kind_integerliteral:
+    *value = static_cast<IntegerLiteralNode*>(node)->integer->value;
+    return true;
+  case kind_booleanliteral:
+    *value = static_cast<BooleanLiteralNode*>(node)->integer->value;
+    return true;
+  case kind_variable: {
+    Frame::iterator local = frame->find(static_cast<VariableNode*>(node)->identifier->name);
+    if (local == frame->end())
+      return false;
+    *value = local->second;
+    return true;
+  }
+  case kind_methodcall:
+    return call(static_cast<MethodCallNode*>(node), scope, frame, value);
+  case kind_not:
+    if (!evaluate(static_cast<NotNode*>(node)->expression, scope, frame, value))
+      return false;
+    *value ^= 1;
+    return true;
+  case kind_negation:
+    if (!evaluate(static_cast<NegationNode*>(node)->expression, scope, frame, value))
+      return false;
+    *value = (int)-(unsigned)*value;
+    return true;
+  default:
+    break;
+  }
+
+  // Both operands of and and or are always evaluated, as in the
+  // generated code
+  std::vector<ExpressionNode**> operands = children(node);
+  if (operands.size() != 2)
+    return false;
+  int a, b;
+  if (!evaluate(*operands[0], scope, frame, &a) || !evaluate(*operands[1], scope, frame, &b))
+    return false;
+
+  switch (node->kind) {
+  case kind_plus: *value = (int)((unsigned)a + (unsigned)b); return true;
+  case kind_minus: *value = (int)((unsigned)a - (unsigned)b); return true;
+  case kind_times: *value = (int)((unsigned)a * (unsigned)b); return true;
+  case kind_divide:
+    if (b == 0 || (a == INT_MIN && b == -1))
+      return false;
+    *value = a / b;
+    return true;
+  case kind_greater: *value = a > b; return true;
+  case kind_greaterequal: *value = a >= b; return true;
+  case kind_equal: *value = a == b; return true;
+  case kind_and: *value = a & b; return true;
+  case kind_or: *value = a | b; return true;
+  default: return false;
+  }
+}
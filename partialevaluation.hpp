@@ -0,0 +1,73 @@
+#ifndef __PARTIALEVALUATION_HPP
+#define __PARTIALEVALUATION_HPP
+
+#include "passmanager.hpp"
+#include "analysis.hpp"
+
+// The most steps (statements and expression nodes) the evaluation of
+// one call may take, and the deepest its calls may nest, before it is
+// given up and the call left to run at run time, and the most steps
+// all the evaluations of a compile may take together
+#define EVALUATION_FUEL 1000000
+#define EVALUATION_DEPTH 200
+#define EVALUATION_BUDGET 10000000
+
+// This pass evaluates calls to pure methods whose arguments are all
+// constant while compiling, and replaces them with their result, an
+// integer or boolean literal. A method can be evaluated if it, and
+// everything it calls, stores nothing, prints nothing, allocates
+// nothing, and reads no members (see computeEffects in analysis.hpp):
+// its result then depends only on its arguments. An argument is
+// constant if it is a literal or can itself be evaluated (an
+// arithmetic expression, or another such call).
+//
+// The typed AST is interpreted directly, with the 32-bit wrapping
+// arithmetic of the generated code. The evaluation is given up, and
+// the call kept, if it runs out of fuel (so a method that does not
+// terminate is still called), if it would trap (division by zero, or
+// INT_MIN / -1), or if it reads a local that was never assigned.
+// Results are remembered by method and arguments, so that recursive
+// methods (fibonacci-style helpers) are evaluated in linear time, and
+// a call that runs out of fuel with all of it is not tried again.
+// Call statements are kept: their result is not used, and dead code
+// elimination removes them if they are pure.
+class PartialEvaluation : public Pass, public ExpressionRewriter {
+private:
+  ClassTable* classTable;
+  MethodScope scope;
+  EffectsTable effects;
+  // Every method, by label, and the class that declares it
+  std::map<std::string, std::pair<std::string, MethodNode*> > methods;
+  std::map<std::string, MethodScope> scopes;
+  // Results of the calls evaluated so far, by label and arguments
+  // (a call that could not be evaluated maps to false)
+  std::map<std::pair<std::string, std::vector<int> >, std::pair<bool, int> > results;
+
+  // The state of the evaluation under way, and the steps left to
+  // all the evaluations still to come
+  int fuel;
+  int depth;
+  long budget;
+  // Set when the evaluation ran out of fuel or depth
+  bool exhausted;
+  // The values of the locals and parameters assigned in the method
+  // being evaluated
+  typedef std::map<std::string, int> Frame;
+
+  bool canEvaluate(std::string label);
+  bool evaluate(ExpressionNode* node, MethodScope* scope, Frame* frame, int* value);
+  bool execute(std::list<StatementNode*>* statements, MethodScope* scope, Frame* frame);
+  bool execute(StatementNode* node, MethodScope* scope, Frame* frame);
+  bool call(MethodCallNode* node, MethodScope* scope, Frame* frame, int* value);
+  bool call(std::string label, std::vector<int>& arguments, int* value);
+
+public:
+  PartialEvaluation() : budget(EVALUATION_BUDGET) {}
+
+  virtual std::string name() { return "partialeval"; }
+  virtual void run(ProgramNode* program, ClassTable* classTable);
+
+  virtual void visitMethodCallNode(MethodCallNode* node);
+};
+
+#endif
@@ -0,0 +1,319 @@
+#include "passmanager.hpp"
+#include "binding.hpp"
+#include "constantfolding.hpp"
+#include "deadcode.hpp"
+#include "inliner.hpp"
+#include "layout.hpp"
+#include "loopoptimization.hpp"
+#include "partialevaluation.hpp"
+#include "profile.hpp"
+#include "valuenumbering.hpp"
+#include "stats.hpp"
+
+// Every pass known to the compiler is registered here, so that it
+// can be named on the command line or by another pass's dependencies.
+PassManager::PassManager() {
+  registerPass(new Inliner());
+  registerPass(new PartialEvaluation());
+  registerPass(new ConstantFolding());
+  registerPass(new ValueNumbering());
+  registerPass(new LoopOptimization());
+  registerPass(new DeadCodeElimination());
+  registerPass(new ObjectLayout());
+}
+
+PassManager::~PassManager() {
+  for (std::map<std::string, Pass*>::iterator it = registry.begin(); it != registry.end(); it++)
+    delete it->second;
+}
+
+void PassManager::registerPass(Pass* pass) {
+  registry[pass->name()] = pass;
+}
+
+bool PassManager::hasPass(std::string name) {
+  return registry.find(name) != registry.end();
+}
+
+std::vector<std::string> PassManager::passNames() {
+  std::vector<std::string> names;
+  for (std::map<std::string, Pass*>::iterator it = registry.begin(); it != registry.end(); it++)
+    names.push_back(it->first);
+  return names;
+}
+
+void PassManager::addPass(std::string name) {
+  std::set<std::string> visiting;
+  addPass(name, visiting);
+}
+
+void PassManager::addPass(std::string name, std::set<std::string>& visiting) {
+  if (!hasPass(name)) {
+    std::cerr << "Unknown pass: " << name << std::endl;
+    exit(1);
+  }
+  Pass* pass = registry[name];
+
+  // Skip passes that are already scheduled
+  for (std::vector<Pass*>::iterator it = pipeline.begin(); it != pipeline.end(); it++) {
+    if (*it == pass)
+      return;
+  }
+
+  if (visiting.count(name)) {
+    std::cerr << "Pass dependency cycle at: " << name << std::endl;
+    exit(1);
+  }
+  visiting.insert(name);
+
+  std::vector<std::string> dependencies = pass->dependencies();
+  for (std::vector<std::string>::iterator it = dependencies.begin(); it != dependencies.end(); it++)
+    addPass(*it, visiting);
+
+  visiting.erase(name);
+  pipeline.push_back(pass);
+}
+
+// Defines the pipeline for each optimization level. Each level
+// runs everything from the level below it, plus its own passes.
+void PassManager::addPassesForLevel(int level) {
+  // Inlining needs a profile to tell which calls are hot, and goes
+  // first, so that the other passes see the inlined code
+  if (level >= 1 && profile.loaded) {
+    addPass("inline");
+  }
+  // Calls evaluated at compile time become literals, which constant
+  // folding and the passes after it build on
+  if (level >= 1) {
+    addPass("partialeval");
+    addPass("constfold");
+    addPass("gvn");
+  }
+  if (level >= 2) {
+    addPass("loopopt");
+  }
+  // Dead code elimination cleans up after the passes above, so it
+  // is always scheduled last
+  if (level >= 1) {
+    addPass("dce");
+  }
+}
+
+void PassManager::run(ProgramNode* program, ClassTable* classTable) {
+  for (std::vector<Pass*>::iterator it = pipeline.begin(); it != pipeline.end(); it++) {
+    Pass* pass = *it;
+    stats.beginPhase("pass:" + pass->name());
+    pass->run(program, classTable);
+    stats.endPhase();
+
+    if (printAfter.count(pass->name()) || printAfter.count("all")) {
+      // The Print visitor writes to std::cout, which is where the
+      // assembly goes, so point it at stderr while printing
+      std::cerr << "*** AST after " << pass->name() << " ***" << std::endl;
+      std::streambuf* out = std::cout.rdbuf(std::cerr.rdbuf());
+      Print* printer = new Print();
+      program->accept(printer);
+      delete printer;
+      std::cout.rdbuf(out);
+    }
+  }
+
+  // The passes move locals and members and add code, so the names
+  // are bound again
+  if (!pipeline.empty())
+    bind(program, classTable);
+}
+
+// ExpressionRewriter Visitor Functions: by default every node is
+// kept, and only its expression children are (possibly) replaced.
+
+ExpressionNode* ExpressionRewriter::rewrite(ExpressionNode* node) {
+  result = node;
+  node->accept(this);
+  return result;
+}
+
+void ExpressionRewriter::rewrite(std::list<ExpressionNode*>* list) {
+  if (list) {
+    for (std::list<ExpressionNode*>::iterator it = list->begin(); it != list->end(); it++)
+      *it = rewrite(*it);
+  }
+}
+
+void ExpressionRewriter::visitStatements(std::list<StatementNode*>* list) {
+  if (list) {
+    for (std::list<StatementNode*>::iterator it = list->begin(); it != list->end(); it++)
+      (*it)->accept(this);
+  }
+}
+
+void ExpressionRewriter::visitProgramNode(ProgramNode* node) {
+  node->visit_children(this);
+}
+
+void ExpressionRewriter::visitClassNode(ClassNode* node) {
+  node->visit_children(this);
+}
+
+void ExpressionRewriter::visitMethodNode(MethodNode* node) {
+  node->visit_children(this);
+}
+
+void ExpressionRewriter::visitMethodBodyNode(MethodBodyNode* node) {
+  visitStatements(node->statement_list);
+  if (node->returnstatement)
+    node->returnstatement->accept(this);
+}
+
+void ExpressionRewriter::visitParameterNode(ParameterNode* node) {}
+
+void ExpressionRewriter::visitDeclarationNode(DeclarationNode* node) {}
+
+void ExpressionRewriter::visitReturnStatementNode(ReturnStatementNode* node) {
+  node->expression = rewrite(node->expression);
+}
+
+void ExpressionRewriter::visitAssignmentNode(AssignmentNode* node) {
+  node->expression = rewrite(node->expression);
+}
+
+void ExpressionRewriter::visitCallNode(CallNode* node) {
+  // The call itself must stay a method call, only its arguments change
+  rewrite(node->methodcall->expression_list);
+}
+
+void ExpressionRewriter::visitIfElseNode(IfElseNode* node) {
+  node->expression = rewrite(node->expression);
+  visitStatements(node->statement_list_1);
+  visitStatements(node->statement_list_2);
+}
+
+void ExpressionRewriter::visitWhileNode(WhileNode* node) {
+  node->expression = rewrite(node->expression);
+  visitStatements(node->statement_list);
+}
+
+void ExpressionRewriter::visitDoWhileNode(DoWhileNode* node) {
+  visitStatements(node->statement_list);
+  node->expression = rewrite(node->expression);
+}
+
+void ExpressionRewriter::visitPrintNode(PrintNode* node) {
+  node->expression = rewrite(node->expression);
+}
+
+void ExpressionRewriter::visitPlusNode(PlusNode* node) {
+  node->expression_1 = rewrite(node->expression_1);
+  node->expression_2 = rewrite(node->expression_2);
+  result = node;
+}
+
+void ExpressionRewriter::visitMinusNode(MinusNode* node) {
+  node->expression_1 = rewrite(node->expression_1);
+  node->expression_2 = rewrite(node->expression_2);
+  result = node;
+}
+
+void ExpressionRewriter::visitTimesNode(TimesNode* node) {
+  node->expression_1 = rewrite(node->expression_1);
+  node->expression_2 = rewrite(node->expression_2);
+  result = node;
+}
+
+void ExpressionRewriter::visitDivideNode(DivideNode* node) {
+  node->expression_1 = rewrite(node->expression_1);
+  node->expression_2 = rewrite(node->expression_2);
+  result = node;
+}
+
+void ExpressionRewriter::visitGreaterNode(GreaterNode* node) {
+  node->expression_1 = rewrite(node->expression_1);
+  node->expression_2 = rewrite(node->expression_2);
+  result = node;
+}
+
+void ExpressionRewriter::visitGreaterEqualNode(GreaterEqualNode* node) {
+  node->expression_1 = rewrite(node->expression_1);
+  node->expression_2 = rewrite(node->expression_2);
+  result = node;
+}
+
+void ExpressionRewriter::visitEqualNode(EqualNode* node) {
+  node->expression_1 = rewrite(node->expression_1);
+  node->expression_2 = rewrite(node->expression_2);
+  result = node;
+}
+
+void ExpressionRewriter::visitAndNode(AndNode* node) {
+  node->expression_1 = rewrite(node->expression_1);
+  node->expression_2 = rewrite(node->expression_2);
+  result = node;
+}
+
+void ExpressionRewriter::visitOrNode(OrNode* node) {
+  node->expression_1 = rewrite(node->expression_1);
+  node->expression_2 = rewrite(node->expression_2);
+  result = node;
+}
+
+void ExpressionRewriter::visitNotNode(NotNode* node) {
+  node->expression = rewrite(node->expression);
+  result = node;
+}
+
+void ExpressionRewriter::visitNegationNode(NegationNode* node) {
+  node->expression = rewrite(node->expression);
+  result = node;
+}
+
+void ExpressionRewriter::visitMethodCallNode(MethodCallNode* node) {
+  rewrite(node->expression_list);
+  result = node;
+}
+
+void ExpressionRewriter::visitMemberAccessNode(MemberAccessNode* node) {
+  result = node;
+}
+
+void ExpressionRewriter::visitVariableNode(VariableNode* node) {
+  result = node;
+}
+
+void ExpressionRewriter::visitIntegerLiteralNode(IntegerLiteralNode* node) {
+  result = node;
+}
+
+void ExpressionRewriter::visitBooleanLiteralNode(BooleanLiteralNode* node) {
+  result = node;
+}
+
+void ExpressionRewriter::visitNewNode(NewNode* node) {
+  rewrite(node->expression_list);
+  result = node;
+}
+
+// The spawned call is visited like any other call, but stays a method
+// call whatever it is rewritten to
+void ExpressionRewriter::visitSpawnNode(SpawnNode* node) {
+  rewrite(node->methodcall);
+  result = node;
+}
+
+void ExpressionRewriter::visitJoinNode(JoinNode* node) {
+  node->expression = rewrite(node->expression);
+  result = node;
+}
+
+void ExpressionRewriter::visitIntegerTypeNode(IntegerTypeNode* node) {}
+
+void ExpressionRewriter::visitBooleanTypeNode(BooleanTypeNode* node) {}
+
+void ExpressionRewriter::visitObjectTypeNode(ObjectTypeNode* node) {}
+
+void ExpressionRewriter::visitTaskTypeNode(TaskTypeNode* node) {}
+
+void ExpressionRewriter::visitNoneNode(NoneNode* node) {}
+
+void ExpressionRewriter::visitIdentifierNode(IdentifierNode* node) {}
+
+void ExpressionRewriter::visitIntegerNode(IntegerNode* node) {}
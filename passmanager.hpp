@@ -0,0 +1,120 @@
+#ifndef __PASSMANAGER_HPP
+#define __PASSMANAGER_HPP
+
+#include "ast.hpp"
+#include "typecheck.hpp"
+
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+// Defines the interface for an optimization pass. A pass runs on
+// the typed AST after the TypeCheck visitor, and may change both
+// the tree and the symbol table, as long as both are left in a
+// state the CodeGenerator can handle.
+class Pass {
+public:
+  virtual ~Pass() {}
+
+  // The name used on the command line (--print-after=<name>)
+  virtual std::string name() = 0;
+
+  // Names of passes that must run before this one. The pass
+  // manager adds them to the pipeline if they are missing.
+  virtual std::vector<std::string> dependencies() { return std::vector<std::string>(); }
+
+  virtual void run(ProgramNode* program, ClassTable* classTable) = 0;
+};
+
+// The pass manager owns every known pass and runs a pipeline of
+// them in order. Each pass is timed as its own --stats phase.
+class PassManager {
+private:
+  std::map<std::string, Pass*> registry;
+  std::vector<Pass*> pipeline;
+
+  void addPass(std::string name, std::set<std::string>& visiting);
+
+public:
+  // Pass names after which the AST is printed to stderr ("all"
+  // prints after every pass)
+  std::set<std::string> printAfter;
+
+  PassManager();
+  ~PassManager();
+
+  void registerPass(Pass* pass);
+  bool hasPass(std::string name);
+
+  // Appends a pass (and, first, any dependencies it is missing)
+  // to the pipeline. Passes already in the pipeline are skipped.
+  void addPass(std::string name);
+
+  // Fills the pipeline with the passes for an optimization level
+  void addPassesForLevel(int level);
+
+  std::vector<std::string> passNames();
+
+  void run(ProgramNode* program, ClassTable* classTable);
+};
+
+// This visitor is a base class for passes that rewrite expressions.
+// Each visit function visits the children of a node, and replaces
+// every expression child with the node that the visit of that child
+// left in "result". Expression visits must always set "result" (the
+// default is the node itself); subclasses override the visits for
+// the nodes they want to replace.
+class ExpressionRewriter : public Visitor {
+protected:
+  ExpressionNode* result;
+
+  ExpressionNode* rewrite(ExpressionNode* node);
+  void rewrite(std::list<ExpressionNode*>* list);
+  void visitStatements(std::list<StatementNode*>* list);
+
+public:
+  ExpressionRewriter() : result(NULL) {}
+
+  virtual void visitProgramNode(ProgramNode* node);
+  virtual void visitClassNode(ClassNode* node);
+  virtual void visitMethodNode(MethodNode* node);
+  virtual void visitMethodBodyNode(MethodBodyNode* node);
+  virtual void visitParameterNode(ParameterNode* node);
+  virtual void visitDeclarationNode(DeclarationNode* node);
+  virtual void visitReturnStatementNode(ReturnStatementNode* node);
+  virtual void visitAssignmentNode(AssignmentNode* node);
+  virtual void visitCallNode(CallNode* node);
+  virtual void visitIfElseNode(IfElseNode* node);
+  virtual void visitWhileNode(WhileNode* node);
+  virtual void visitDoWhileNode(DoWhileNode* node);
+  virtual void visitPrintNode(PrintNode* node);
+  virtual void visitPlusNode(PlusNode* node);
+  virtual void visitMinusNode(MinusNode* node);
+  virtual void visitTimesNode(TimesNode* node);
+  virtual void visitDivideNode(DivideNode* node);
+  virtual void visitGreaterNode(GreaterNode* node);
+  virtual void visitGreaterEqualNode(GreaterEqualNode* node);
+  virtual void visitEqualNode(EqualNode* node);
+  virtual void visitAndNode(AndNode* node);
+  virtual void visitOrNode(OrNode* node);
+  virtual void visitNotNode(NotNode* node);
+  virtual void visitNegationNode(NegationNode* node);
+  virtual void visitMethodCallNode(MethodCallNode* node);
+  virtual void visitMemberAccessNode(MemberAccessNode* node);
+  virtual void visitVariableNode(VariableNode* node);
+  virtual void visitIntegerLiteralNode(IntegerLiteralNode* node);
+  virtual void visitBooleanLiteralNode(BooleanLiteralNode* node);
+  virtual void visitNewNode(NewNode* node);
+  virtual void visitSpawnNode(SpawnNode* node);
+  virtual void visitJoinNode(JoinNode* node);
+  virtual void visitIntegerTypeNode(IntegerTypeNode* node);
+  virtual void visitBooleanTypeNode(BooleanTypeNode* node);
+  virtual void visitObjectTypeNode(ObjectTypeNode* node);
+  virtual void visitTaskTypeNode(TaskTypeNode* node);
+  virtual void visitNoneNode(NoneNode* node);
+  virtual void visitIdentifierNode(IdentifierNode* node);
+  virtual void visitIntegerNode(IntegerNode* node);
+};
+
+#endif
@@ -0,0 +1,116 @@
+#include "profile.hpp"
+
+#include <fstream>
+#include <iterator>
+
+Profile profile;
+
+// The checksum is an FNV-1a hash of the sites in order
+static void mix(unsigned* hash, std::string text) {
+  for (unsigned i = 0; i < text.size(); i++) {
+    *hash ^= (unsigned char)text[i];
+    *hash *= 16777619u;
+  }
+}
+
+void Profile::number(ProgramNode* program) {
+  unsigned hash = 2166136261u;
+  sites.clear();
+  counterCount = 0;
+  for (std::list<ClassNode*>::iterator c = program->class_list->begin(); c != program->class_list->end(); c++) {
+    for (std::list<MethodNode*>::iterator m = (*c)->method_list->begin(); m != (*c)->method_list->end(); m++) {
+      mix(&hash, (*c)->identifier_1->name + "_" + (*m)->identifier->name);
+      addSite(*m, site_method, &hash);
+      numberStatements((*m)->methodbody->statement_list, &hash);
+    }
+  }
+  checksum = hash;
+}
+
+void Profile::numberStatements(std::list<StatementNode*>* statements, unsigned* hash) {
+  if (!statements)
+    return;
+  for (std::list<StatementNode*>::iterator it = statements->begin(); it != statements->end(); it++) {
+    if (IfElseNode* node = dynamic_cast<IfElseNode*>(*it)) {
+      addSite(node, site_ifelse, hash);
+      numberStatements(node->statement_list_1, hash);
+      numberStatements(node->statement_list_2, hash);
+    } else if (WhileNode* node = dynamic_cast<WhileNode*>(*it)) {
+      addSite(node, site_loop, hash);
+      numberStatements(node->statement_list, hash);
+    } else if (DoWhileNode* node = dynamic_cast<DoWhileNode*>(*it)) {
+      addSite(node, site_loop, hash);
+      numberStatements(node->statement_list, hash);
+    }
+  }
+}
+
+int Profile::addSite(ASTNode* node, SiteKind kind, unsigned* hash) {
+  static const char* names[] = { "m", "i", "l" };
+  mix(hash, names[kind]);
+  int first = counterCount;
+  sites[node] = first;
+  counterCount += kind == site_ifelse ? 2 : 1;
+  return first;
+}
+
+static unsigned readWord(std::vector<unsigned char>& data, unsigned offset) {
+  return data[offset] | (data[offset + 1] << 8) | (data[offset + 2] << 16) | ((unsigned)data[offset + 3] << 24);
+}
+
+bool Profile::load(std::string filename, std::string* error) {
+  std::ifstream in(filename.c_str(), std::ios::binary);
+  if (!in) {
+    *error = "cannot open " + filename;
+    return false;
+  }
+  std::vector<unsigned char> data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+  if (data.size() < 16 || std::string(data.begin(), data.begin() + 4) != PROFILE_MAGIC) {
+    *error = filename + " is not a profile";
+    return false;
+  }
+  if (readWord(data, 4) != PROFILE_VERSION) {
+    *error = filename + " has an unsupported version";
+    return false;
+  }
+  unsigned size = readWord(data, 12);
+  if (readWord(data, 8) != checksum || size != (unsigned)counterCount || data.size() != 16 + 4 * size) {
+    *error = filename + " was made for a different program";
+    return false;
+  }
+
+  counts.resize(size);
+  for (unsigned i = 0; i < size; i++)
+    counts[i] = readWord(data, 16 + 4 * i);
+  loaded = true;
+  return true;
+}
+
+int Profile::counter(ASTNode* node) {
+  std::map<ASTNode*, int>::iterator site = sites.find(node);
+  return site == sites.end() ? -1 : site->second;
+}
+
+void Profile::copySite(ASTNode* original, ASTNode* copy) {
+  int first = counter(original);
+  if (first >= 0)
+    sites[copy] = first;
+}
+
+bool Profile::count(ASTNode* node, int which, unsigned* value) {
+  int first = counter(node);
+  if (!loaded || first < 0)
+    return false;
+  *value = counts[first + which];
+  return true;
+}
+
+unsigned Profile::hottest() {
+  unsigned result = 0;
+  for (std::vector<unsigned>::iterator it = counts.begin(); it != counts.end(); it++) {
+    if (*it > result)
+      result = *it;
+  }
+  return result;
+}
@@ -0,0 +1,75 @@
+#ifndef __PROFILE_HPP
+#define __PROFILE_HPP
+
+#include "ast.hpp"
+
+#include <map>
+#include <string>
+#include <vector>
+
+// Defines the places that an instrumented program counts:
+// method entries, the two branches of an if statement and the
+// iterations of a loop body. Each site owns one counter, except
+// if statements, which own two (then, else).
+typedef enum {
+  site_method,
+  site_ifelse,
+  site_loop
+} SiteKind;
+
+// Defines the binary profile written by an instrumented program
+// when it exits: a header of four 32-bit words (the magic
+// "LPRF", the format version, the checksum of the program's sites
+// and the number of counters), followed by the counters as
+// 32-bit little-endian words.
+#define PROFILE_MAGIC "LPRF"
+#define PROFILE_VERSION 1
+
+// Numbers the counters of a program, and holds the counts read
+// from a profile.
+class Profile {
+private:
+  std::map<ASTNode*, int> sites;
+
+  void numberStatements(std::list<StatementNode*>* statements, unsigned* hash);
+  int addSite(ASTNode* node, SiteKind kind, unsigned* hash);
+
+public:
+  // A hash of the kinds and order of the sites, and of the method
+  // labels, so a profile of another program is not used by mistake
+  unsigned checksum;
+  int counterCount;
+  std::vector<unsigned> counts;
+  bool loaded;
+
+  Profile() : checksum(0), counterCount(0), loaded(false) {}
+
+  // Gives every site of the program its counters. This is done
+  // right after type checking, before the optimization passes
+  // change the tree, so an instrumented build and a build that
+  // uses its profile agree at any optimization level.
+  void number(ProgramNode* program);
+
+  // Reads a profile written by an instrumented build of the same
+  // program. Returns false, with a message, if it cannot be used.
+  bool load(std::string filename, std::string* error);
+
+  // The first counter of a site, or -1 if the node is not one
+  int counter(ASTNode* node);
+
+  // Makes a copy of a node (made by a pass) share its counters
+  void copySite(ASTNode* original, ASTNode* copy);
+
+  // Sets *value to a counter of a site (0 for a method or loop,
+  // 0 or 1 for the branches of an if statement), if a profile is
+  // loaded and the node is a site.
+  bool count(ASTNode* node, int which, unsigned* value);
+
+  // The largest count in the profile
+  unsigned hottest();
+};
+
+// The single Profile object for this run of the compiler.
+extern Profile profile;
+
+#endif
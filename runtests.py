@@ -1,7 +1,16 @@
 from subprocess import Popen, PIPE
-from os import listdir, path, remove
+from os import listdir, path, remove, makedirs, cpu_count, replace
 from sys import platform
 from functools import total_ordering
+from concurrent.futures import ThreadPoolExecutor
+import argparse
+import hashlib
+import json
+
+# Compiled test executables are cached here, keyed by a hash of the
+# test source, the `lang` binary, its flags and tester.c. A test whose
+# key is unchanged is run without compiling or assembling it again.
+cachedir = ".testcache"
 
 @total_ordering
 class NameOrder(object):
@@ -19,7 +28,78 @@ class NameOrder(object):
 		else:
 			return int(firstNumber) < int(secondNumber)
 
-def runTests():
+def fileHash(filename):
+	h = hashlib.sha1()
+	with open(filename, "rb") as f:
+		h.update(f.read())
+	return h.hexdigest()
+
+# Compiles one test (or fetches it from the cache) and returns the name
+# of its executable, or None along with the message to print instead.
+# The compiler reports every type error it finds; with collapse, a
+# compile that printed more than one line is reported as "Multiple
+# errors produced." instead.
+def buildTest(f, key, flags, usecache, collapse):
+	entry = path.join(cachedir, key)
+	if (usecache and path.isfile(entry + ".json")):
+		with open(entry + ".json", "r") as cached:
+			result = json.load(cached)
+		if (result["exec"] is None or path.isfile(result["exec"])):
+			return (result["exec"], result["message"])
+
+	asm = f + ".s"
+	with open(f, 'r') as infile, open(asm, 'w') as outfile:
+		p = Popen(["./lang"] + flags, stdin=infile, stdout=outfile, stderr=PIPE)
+		(out, err) = p.communicate()
+
+	exe = None
+	message = None
+	if (err):
+		try:
+			if (collapse and len(err.decode("utf-8").strip().split("\n")) > 1):
+				message = "Multiple errors produced.\n"
+			else:
+				message = err.decode("utf-8")
+		except UnicodeDecodeError:
+			message = "Invalid characters in output.\n"
+	else:
+		args = []
+		if (platform == "darwin"):
+			args = ["-Wl,-no_pie"]
+
+		p = Popen(["gcc"] + args + ["-m32", "-pthread", "-o", entry + ".exec", "tester.c", asm], stdin=PIPE, stdout=PIPE, stderr=PIPE)
+		(out, err) = p.communicate()
+
+		if (p.returncode == 0):
+			exe = entry + ".exec"
+		else:
+			# Not cached: the toolchain may be fixed without the key changing
+			return (None, "Assembling and linking failed.\n")
+
+	# Write the cache entry atomically so an interrupted run cannot leave
+	# a half-written entry behind
+	with open(entry + ".tmp", "w") as cached:
+		json.dump({"exec": exe, "message": message}, cached)
+	replace(entry + ".tmp", entry + ".json")
+	return (exe, message)
+
+def runTest(f, key, flags, usecache, collapse):
+	report = "./lang < " + f + ":\n"
+	(exe, message) = buildTest(f, key, flags, usecache, collapse)
+	if (exe is None):
+		return report + message + "\n"
+
+	p = Popen([exe], stdin=PIPE, stdout=PIPE, stderr=PIPE)
+	(out, err) = p.communicate()
+
+	if (p.returncode != 0):
+		return report + "Exited with an error.\n\n"
+	try:
+		return report + "Output:\n" + out.decode("utf-8") + "\n"
+	except UnicodeDecodeError:
+		return report + "Invalid characters in output.\n\n"
+
+def runTests(jobs, flags, usecache, collapse):
 	if (not path.isdir("tests/")):
 		print("No tests directory.")
 		return
@@ -28,52 +108,35 @@ def runTests():
 		print("No `lang` executable.")
 		return
 
+	makedirs(cachedir, exist_ok=True)
+
 	files = sorted(["tests/" + f for f in listdir('tests') if path.isfile("tests/" + f) and f.endswith(".lang")], key=NameOrder)
 
-	for f in files:
-		infile = open(f, 'r')
-		asm = f + ".s"
-		outfile = open(asm, 'w')
+	# Everything a test's result depends on besides its own source
+	common = hashlib.sha1()
+	common.update(fileHash("./lang").encode("utf-8"))
+	common.update(fileHash("tester.c").encode("utf-8"))
+	common.update(" ".join(flags).encode("utf-8"))
+	common.update(b"collapse" if collapse else b"")
+	common = common.hexdigest()
 
-		print("./lang < " + f + ":")
-		p = Popen(["./lang"], stdin=infile, stdout=outfile, stderr=PIPE)
-		(out, err) = p.communicate()
+	keys = [hashlib.sha1((common + fileHash(f)).encode("utf-8")).hexdigest() for f in files]
 
-		try:
-			if (err):
-				if (len(err.decode("utf-8").strip().split("\n")) > 1):
-					print("Multiple errors produced.\n")
-				else:
-					print(err.decode("utf-8"))
-			else:
-				args = []
-				if (platform == "darwin"):
-					args = ["-Wl,-no_pie"]
-
-				p = Popen(["gcc"] + args + ["-m32", "-o" ,"tests/exec" ,"tester.c", asm], stdin=PIPE, stdout=PIPE, stderr=PIPE)
-				(out, err) = p.communicate()
-
-				compiled = p.returncode
-				if (compiled == 0):
-					p = Popen(["tests/exec"], stdin=PIPE, stdout=PIPE, stderr=PIPE)
-					(out, err) = p.communicate()
-
-					ran = p.returncode
-					if (ran == 0):
-						print("Output:")
-						print(out.decode("utf-8"))
-					else:
-						print("Exited with an error.\n")
-					remove("tests/exec")
-				else:
-					print("Assembling and linking failed.\n")
-
-		
-		except UnicodeDecodeError:
-			print("Invalid characters in output.\n")
+	# Tests run concurrently, but reports are printed in the usual order
+	# so the output can still be compared against output.txt
+	with ThreadPoolExecutor(max_workers=jobs) as pool:
+		reports = pool.map(lambda args: runTest(args[0], args[1], flags, usecache, collapse), zip(files, keys))
+		for report in reports:
+			print(report, end="", flush=True)
 
 def main():
-	runTests()
+	parser = argparse.ArgumentParser(description="Compile, assemble and run every program in tests/.")
+	parser.add_argument("-j", metavar="jobs", type=int, default=cpu_count(), help="Number of tests to run at once (default: all cores)")
+	parser.add_argument("--no-cache", action="store_true", help="Always recompile and reassemble every test")
+	parser.add_argument("--flags", metavar="flags", type=str, default="", help="Extra flags to pass to ./lang")
+	parser.add_argument("--collapse-errors", action="store_true", help="Report a compile with several errors as \"Multiple errors produced.\"")
+	args = parser.parse_args()
+	runTests(max(1, args.j or 1), args.flags.split(), not args.no_cache, args.collapse_errors)
 
 if __name__ == "__main__":
 	main()
@@ -0,0 +1,336 @@
+#include "stats.hpp"
+
+#include <iomanip>
+#include <sys/resource.h>
+#include <sys/time.h>
+
+Stats stats;
+
+// Names used when printing the counters, in the same order as
+// the StatCounter enumeration.
+static const char* counterNames[stat_counter_count] = {
+  "symbol_lookups",
+  "superclass_hops",
+  "instructions_emitted"
+};
+
+double wallTime() {
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+long peakRSS() {
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+  // Darwin reports ru_maxrss in bytes rather than kilobytes
+  return usage.ru_maxrss / 1024;
+#else
+  return usage.ru_maxrss;
+#endif
+}
+
+// This visitor walks the whole tree and counts how many nodes
+// of each type it sees. It is only run when --stats is given.
+class NodeCounter : public Visitor {
+public:
+  std::map<std::string, long>& counts;
+
+  NodeCounter(std::map<std::string, long>& counts) : counts(counts) {}
+
+  virtual void visitProgramNode(ProgramNode* node);
+  virtual void visitClassNode(ClassNode* node);
+  virtual void visitMethodNode(MethodNode* node);
+  virtual void visitMethodBodyNode(MethodBodyNode* node);
+  virtual void visitParameterNode(ParameterNode* node);
+  virtual void visitDeclarationNode(DeclarationNode* node);
+  virtual void visitReturnStatementNode(ReturnStatementNode* node);
+  virtual void visitAssignmentNode(AssignmentNode* node);
+  virtual void visitCallNode(CallNode* node);
+  virtual void visitIfElseNode(IfElseNode* node);
+  virtual void visitWhileNode(WhileNode* node);
+  virtual void visitDoWhileNode(DoWhileNode* node);
+  virtual void visitPrintNode(PrintNode* node);
+  virtual void visitPlusNode(PlusNode* node);
+  virtual void visitMinusNode(MinusNode* node);
+  virtual void visitTimesNode(TimesNode* node);
+  virtual void visitDivideNode(DivideNode* node);
+  virtual void visitGreaterNode(GreaterNode* node);
+  virtual void visitGreaterEqualNode(GreaterEqualNode* node);
+  virtual void visitEqualNode(EqualNode* node);
+  virtual void visitAndNode(AndNode* node);
+  virtual void visitOrNode(OrNode* node);
+  virtual void visitNotNode(NotNode* node);
+  virtual void visitNegationNode(NegationNode* node);
+  virtual void visitMethodCallNode(MethodCallNode* node);
+  virtual void visitMemberAccessNode(MemberAccessNode* node);
+  virtual void visitVariableNode(VariableNode* node);
+  virtual void visitIntegerLiteralNode(IntegerLiteralNode* node);
+  virtual void visitBooleanLiteralNode(BooleanLiteralNode* node);
+  virtual void visitNewNode(NewNode* node);
+  virtual void visitSpawnNode(SpawnNode* node);
+  virtual void visitJoinNode(JoinNode* node);
+  virtual void visitIntegerTypeNode(IntegerTypeNode* node);
+  virtual void visitBooleanTypeNode(BooleanTypeNode* node);
+  virtual void visitObjectTypeNode(ObjectTypeNode* node);
+  virtual void visitTaskTypeNode(TaskTypeNode* node);
+  virtual void visitNoneNode(NoneNode* node);
+  virtual void visitIdentifierNode(IdentifierNode* node);
+  virtual void visitIntegerNode(IntegerNode* node);
+};
+
+void NodeCounter::visitProgramNode(ProgramNode* node) {
+  counts["Program"]++;
+  node->visit_children(this);
+}
+
+void NodeCounter::visitClassNode(ClassNode* node) {
+  counts["Class"]++;
+  node->visit_children(this);
+}
+
+void NodeCounter::visitMethodNode(MethodNode* node) {
+  counts["Method"]++;
+  node->visit_children(this);
+}
+
+void NodeCounter::visitMethodBodyNode(MethodBodyNode* node) {
+  counts["MethodBody"]++;
+  node->visit_children(this);
+}
+
+void NodeCounter::visitParameterNode(ParameterNode* node) {
+  counts["Parameter"]++;
+  node->visit_children(this);
+}
+
+void NodeCounter::visitDeclarationNode(DeclarationNode* node) {
+  counts["Declaration"]++;
+  node->visit_children(this);
+}
+
+void NodeCounter::visitReturnStatementNode(ReturnStatementNode* node) {
+  counts["ReturnStatement"]++;
+  node->visit_children(this);
+}
+
+void NodeCounter::visitAssignmentNode(AssignmentNode* node) {
+  counts["Assignment"]++;
+  node->visit_children(this);
+}
+
+void NodeCounter::visitCallNode(CallNode* node) {
+  counts["Call"]++;
+  node->visit_children(this);
+}
+
+void NodeCounter::visitIfElseNode(IfElseNode* node) {
+  counts["IfElse"]++;
+  node->visit_children(this);
+}
+
+void NodeCounter::visitWhileNode(WhileNode* node) {
+  counts["While"]++;
+  node->visit_children(this);
+}
+
+void NodeCounter::visitDoWhileNode(DoWhileNode* node) {
+  counts["DoWhile"]++;
+  node->visit_children(this);
+}
+
+void NodeCounter::visitPrintNode(PrintNode* node) {
+  counts["Print"]++;
+  node->visit_children(this);
+}
+
+void NodeCounter::visitPlusNode(PlusNode* node) {
+  counts["Plus"]++;
+  node->visit_children(this);
+}
+
+void NodeCounter::visitMinusNode(MinusNode* node) {
+  counts["Minus"]++;
+  node->visit_children(this);
+}
+
+void NodeCounter::visitTimesNode(TimesNode* node) {
+  counts["Times"]++;
+  node->visit_children(this);
+}
+
+void NodeCounter::visitDivideNode(DivideNode* node) {
+  counts["Divide"]++;
+  node->visit_children(this);
+}
+
+void NodeCounter::visitGreaterNode(GreaterNode* node) {
+  counts["Greater"]++;
+  node->visit_children(this);
+}
+
+void NodeCounter::visitGreaterEqualNode(GreaterEqualNode* node) {
+  counts["GreaterEqual"]++;
+  node->visit_children(this);
+}
+
+void NodeCounter::visitEqualNode(EqualNode* node) {
+  counts["Equal"]++;
+  node->visit_children(this);
+}
+
+void NodeCounter::visitAndNode(AndNode* node) {
+  counts["And"]++;
+  node->visit_children(this);
+}
+
+void NodeCounter::visitOrNode(OrNode* node) {
+  counts["Or"]++;
+  node->visit_children(this);
+}
+
+void NodeCounter::visitNotNode(NotNode* node) {
+  counts["Not"]++;
+  node->visit_children(this);
+}
+
+void NodeCounter::visitNegationNode(NegationNode* node) {
+  counts["Negation"]++;
+  node->visit_children(this);
+}
+
+void NodeCounter::visitMethodCallNode(MethodCallNode* node) {
+  counts["MethodCall"]++;
+  node->visit_children(this);
+}
+
+void NodeCounter::visitMemberAccessNode(MemberAccessNode* node) {
+  counts["MemberAccess"]++;
+  node->visit_children(this);
+}
+
+void NodeCounter::visitVariableNode(VariableNode* node) {
+  counts["Variable"]++;
+  node->visit_children(this);
+}
+
+void NodeCounter::visitIntegerLiteralNode(IntegerLiteralNode* node) {
+  counts["IntegerLiteral"]++;
+  node->visit_children(this);
+}
+
+void NodeCounter::visitBooleanLiteralNode(BooleanLiteralNode* node) {
+  counts["BooleanLiteral"]++;
+  node->visit_children(this);
+}
+
+void NodeCounter::visitNewNode(NewNode* node) {
+  counts["New"]++;
+  node->visit_children(this);
+}
+
+void NodeCounter::visitSpawnNode(SpawnNode* node) {
+  counts["Spawn"]++;
+  node->visit_children(this);
+}
+
+void NodeCounter::visitJoinNode(JoinNode* node) {
+  counts["Join"]++;
+  node->visit_children(this);
+}
+
+void NodeCounter::visitIntegerTypeNode(IntegerTypeNode* node) {
+  counts["IntegerType"]++;
+  node->visit_children(this);
+}
+
+void NodeCounter::visitBooleanTypeNode(BooleanTypeNode* node) {
+  counts["BooleanType"]++;
+  node->visit_children(this);
+}
+
+void NodeCounter::visitObjectTypeNode(ObjectTypeNode* node) {
+  counts["ObjectType"]++;
+  node->visit_children(this);
+}
+
+void NodeCounter::visitTaskTypeNode(TaskTypeNode* node) {
+  counts["TaskType"]++;
+  node->visit_children(this);
+}
+
+void NodeCounter::visitNoneNode(NoneNode* node) {
+  counts["None"]++;
+  node->visit_children(this);
+}
+
+void NodeCounter::visitIdentifierNode(IdentifierNode* node) {
+  counts["Identifier"]++;
+  node->visit_children(this);
+}
+
+void NodeCounter::visitIntegerNode(IntegerNode* node) {
+  counts["Integer"]++;
+  node->visit_children(this);
+}
+
+Stats::Stats() : phaseStart(0) {
+  for (int i = 0; i < stat_counter_count; i++)
+    counters[i] = 0;
+}
+
+void Stats::beginPhase(std::string name) {
+  currentPhase = name;
+  phaseStart = wallTime();
+}
+
+void Stats::endPhase() {
+  PhaseInfo phase;
+  phase.name = currentPhase;
+  phase.seconds = wallTime() - phaseStart;
+  phase.peakRSS = peakRSS();
+  phases.push_back(phase);
+}
+
+void Stats::countNodes(ASTNode* root) {
+  NodeCounter counter(nodeCounts);
+  root->accept(&counter);
+}
+
+void Stats::printText(std::ostream& out) {
+  out << "Phase                 Time (ms)   Peak RSS (KB)" << std::endl;
+  for (std::vector<PhaseInfo>::iterator it = phases.begin(); it != phases.end(); it++) {
+    out << std::left << std::setw(20) << it->name << std::right << std::setw(12) << std::fixed << std::setprecision(3)
+        << it->seconds * 1000 << std::setw(16) << it->peakRSS << std::endl;
+  }
+  out << std::endl << "Counters" << std::endl;
+  for (int i = 0; i < stat_counter_count; i++)
+    out << "  " << std::left << std::setw(22) << counterNames[i] << std::right << counters[i] << std::endl;
+  out << std::endl << "AST nodes" << std::endl;
+  for (std::map<std::string, long>::iterator it = nodeCounts.begin(); it != nodeCounts.end(); it++)
+    out << "  " << std::left << std::setw(22) << it->first << std::right << it->second << std::endl;
+}
+
+void Stats::printJSON(std::ostream& out) {
+  out << "{" << std::endl << "  \"phases\": [";
+  for (std::vector<PhaseInfo>::iterator it = phases.begin(); it != phases.end(); it++) {
+    if (it != phases.begin())
+      out << ",";
+    out << std::endl << "    {\"name\": \"" << it->name << "\", \"ms\": " << std::fixed << std::setprecision(3)
+        << it->seconds * 1000 << ", \"peak_rss_kb\": " << it->peakRSS << "}";
+  }
+  out << std::endl << "  ]," << std::endl << "  \"counters\": {";
+  for (int i = 0; i < stat_counter_count; i++) {
+    if (i > 0)
+      out << ",";
+    out << std::endl << "    \"" << counterNames[i] << "\": " << counters[i];
+  }
+  out << std::endl << "  }," << std::endl << "  \"ast_nodes\": {";
+  for (std::map<std::string, long>::iterator it = nodeCounts.begin(); it != nodeCounts.end(); it++) {
+    if (it != nodeCounts.begin())
+      out << ",";
+    out << std::endl << "    \"" << it->first << "\": " << it->second;
+  }
+  out << std::endl << "  }" << std::endl << "}" << std::endl;
+}
@@ -0,0 +1,66 @@
+#ifndef __STATS_HPP
+#define __STATS_HPP
+
+#include "ast.hpp"
+
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+// Defines all the counters kept while compiling. They are
+// cheap integer increments, so they are always collected;
+// only the report at the end is controlled by --stats.
+typedef enum {
+  stat_symbol_lookups,
+  stat_superclass_hops,
+  stat_instructions_emitted,
+  stat_counter_count
+} StatCounter;
+
+// Defines the measurements taken for one compiler phase:
+// its wall time in seconds and the peak resident set size
+// (in kilobytes) of the process when the phase finished.
+typedef struct phaseinfo {
+  std::string name;
+  double seconds;
+  long peakRSS;
+} PhaseInfo;
+
+// Collects per-phase timings, counters and AST node counts,
+// and prints them either as text or as JSON.
+class Stats {
+private:
+  std::string currentPhase;
+  double phaseStart;
+
+public:
+  std::vector<PhaseInfo> phases;
+  long counters[stat_counter_count];
+  std::map<std::string, long> nodeCounts;
+
+  Stats();
+
+  // Phases are timed by bracketing them with these calls.
+  void beginPhase(std::string name);
+  void endPhase();
+
+  // Walks the tree rooted at the given node and records
+  // the number of nodes of each type in nodeCounts. The counts
+  // add up over calls, so a program compiled one class at a
+  // time is counted by class.
+  void countNodes(ASTNode* root);
+
+  void printText(std::ostream& out);
+  void printJSON(std::ostream& out);
+};
+
+// The single Stats object for this run of the compiler.
+extern Stats stats;
+
+// Returns the wall clock time in seconds and the peak resident
+// set size of the process in kilobytes.
+double wallTime();
+long peakRSS();
+
+#endif
@@ -1,6 +1,242 @@
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
 
 int Main_main();
+void* __lang_new(int size);
+
+// The runtime that compiled programs are linked with: the allocator
+// that "new" gets objects from, and the scheduler of the tasks that
+// "spawn" starts and "join" waits for.
+//
+// Tasks are scheduled by work stealing. Every worker thread has a
+// deque of tasks. A spawn pushes the new task at the bottom of the
+// deque of the worker that runs it, and the worker takes its own
+// tasks back from the bottom, the newest first; a worker that has
+// none steals from the top of another's deque, the oldest task, which
+// in a divide and conquer program is the largest piece of work left.
+// A join whose task is not done yet runs other tasks until it is: its
+// own first (most often the very task it waits for), then stolen ones.
+// Each deque has its own lock, taken by its owner and by the workers
+// stealing from it, so workers only contend when they steal.
+//
+// The main thread is worker 0, and runs Main_main. The other workers
+// are started by the first spawn, one per processor (LANG_WORKERS
+// sets how many), and sleep while there is nothing to steal, so a
+// program that spawns nothing runs on the main thread alone.
+
+#define MAX_WORKERS 32
+#define WORKER_STACK_SIZE (16 << 20)
+
+typedef struct task {
+  // The task entry of the spawned method (see codegeneration.cpp),
+  // and the words of the call: "this", then the arguments
+  int (*run)(int* words);
+  int result;
+  int done;
+  int count;
+  int words[];
+} Task;
+
+typedef struct deque {
+  pthread_mutex_t lock;
+  Task** tasks;
+  // The tasks are tasks[top] (the oldest) to tasks[bottom - 1]
+  int top;
+  int bottom;
+  int capacity;
+} Deque;
+
+static Deque deques[MAX_WORKERS];
+static int workers = 1;
+static int started;
+static __thread int self;
+static __thread unsigned seed;
+
+// How many tasks the deques hold, and how many workers sleep until
+// one is spawned
+static int queued;
+static int sleeping;
+static pthread_mutex_t idleLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t idle = PTHREAD_COND_INITIALIZER;
+
+static void fail(const char* message) {
+  fprintf(stderr, "%s\n", message);
+  exit(1);
+}
+
+static void push(Deque* deque, Task* task) {
+  pthread_mutex_lock(&deque->lock);
+  if (deque->bottom == deque->capacity) {
+    if (deque->top > 0) {
+      memmove(deque->tasks, deque->tasks + deque->top, (deque->bottom - deque->top) * sizeof(Task*));
+      deque->bottom -= deque->top;
+      deque->top = 0;
+    } else {
+      deque->capacity = deque->capacity ? 2 * deque->capacity : 256;
+      deque->tasks = realloc(deque->tasks, deque->capacity * sizeof(Task*));
+      if (!deque->tasks)
+        fail("Out of memory for tasks.");
+    }
+  }
+  deque->tasks[deque->bottom++] = task;
+  pthread_mutex_unlock(&deque->lock);
+}
+
+// Takes the newest task (for the owner) or the oldest (for a thief)
+static Task* take(Deque* deque, int newest) {
+  Task* task = NULL;
+  pthread_mutex_lock(&deque->lock);
+  if (deque->top < deque->bottom) {
+    task = newest ? deque->tasks[--deque->bottom] : deque->tasks[deque->top++];
+    if (deque->top == deque->bottom)
+      deque->top = deque->bottom = 0;
+  }
+  pthread_mutex_unlock(&deque->lock);
+  if (task)
+    __atomic_sub_fetch(&queued, 1, __ATOMIC_SEQ_CST);
+  return task;
+}
+
+// Takes one of our own tasks, or steals one, starting from a random
+// worker so that thieves spread over the deques
+static Task* findTask(void) {
+  Task* task = take(&deques[self], 1);
+  if (task || workers == 1 || __atomic_load_n(&queued, __ATOMIC_SEQ_CST) <= 0)
+    return task;
+
+  seed = seed * 1103515245 + 12345;
+  int first = (seed >> 16) % workers;
+  for (int i = 0; i < workers; i++) {
+    int victim = (first + i) % workers;
+    if (victim != self && (task = take(&deques[victim], 0)))
+      return task;
+  }
+  return NULL;
+}
+
+static void execute(Task* task) {
+  task->result = task->run(task->words);
+  __atomic_store_n(&task->done, 1, __ATOMIC_RELEASE);
+}
+
+// A worker counts itself as sleeping before it looks at the tasks
+// queued, and a spawn queues its task before it looks for sleeping
+// workers, so either the worker finds the task or the spawn wakes it
+static void* worker(void* index) {
+  self = (int)(intptr_t)index;
+  seed = self;
+  for (;;) {
+    Task* task = findTask();
+    if (task) {
+      execute(task);
+      continue;
+    }
+    pthread_mutex_lock(&idleLock);
+    __atomic_add_fetch(&sleeping, 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&queued, __ATOMIC_SEQ_CST) <= 0)
+      pthread_cond_wait(&idle, &idleLock);
+    __atomic_sub_fetch(&sleeping, 1, __ATOMIC_SEQ_CST);
+    pthread_mutex_unlock(&idleLock);
+  }
+  return NULL;
+}
+
+// Until the first spawn there is only the main thread, so only it
+// starts the workers
+static void start(void) {
+  const char* setting = getenv("LANG_WORKERS");
+  int count = setting ? atoi(setting) : (int)sysconf(_SC_NPROCESSORS_ONLN);
+  if (count < 1)
+    count = 1;
+  if (count > MAX_WORKERS)
+    count = MAX_WORKERS;
+
+  for (int i = 0; i < count; i++)
+    pthread_mutex_init(&deques[i].lock, NULL);
+  workers = count;
+  started = 1;
+
+  pthread_attr_t attributes;
+  pthread_attr_init(&attributes);
+  pthread_attr_setstacksize(&attributes, WORKER_STACK_SIZE);
+  pthread_attr_setdetachstate(&attributes, PTHREAD_CREATE_DETACHED);
+  for (int i = 1; i < count; i++) {
+    pthread_t thread;
+    // A worker that cannot be started leaves its deque empty, which
+    // the others find nothing to steal from
+    pthread_create(&thread, &attributes, worker, (void*)(intptr_t)i);
+  }
+  pthread_attr_destroy(&attributes);
+}
+
+// Called by a spawn with the task entry of the method and the words
+// of its call, which are copied into the task; returns the task. Tasks
+// are allocated as objects are, and like them never freed, so that a
+// handle can be joined any number of times.
+Task* __lang_spawn(int (*run)(int*), int count, int* words) {
+  Task* task = __lang_new(sizeof(Task) + count * sizeof(int));
+  task->run = run;
+  task->done = 0;
+  task->count = count;
+  memcpy(task->words, words, count * sizeof(int));
+
+  if (!started)
+    start();
+  push(&deques[self], task);
+  __atomic_add_fetch(&queued, 1, __ATOMIC_SEQ_CST);
+  if (__atomic_load_n(&sleeping, __ATOMIC_SEQ_CST) > 0) {
+    pthread_mutex_lock(&idleLock);
+    pthread_cond_signal(&idle);
+    pthread_mutex_unlock(&idleLock);
+  }
+  return task;
+}
+
+// Called by a join: runs tasks until this one is done, and returns
+// what its call returned
+int __lang_join(Task* task) {
+  while (!__atomic_load_n(&task->done, __ATOMIC_ACQUIRE)) {
+    Task* other = findTask();
+    if (other)
+      execute(other);
+    else
+      sched_yield();
+  }
+  return task->result;
+}
+
+// Objects are never freed, so each thread takes them from a chunk of
+// its own by bumping a pointer, without locking, and only goes to
+// malloc for a new chunk (or for an object too large for one)
+#define CHUNK_SIZE (256 << 10)
+
+static __thread char* chunkNext;
+static __thread char* chunkEnd;
+
+void* __lang_new(int size) {
+  // Every object gets an address of its own, even with no members
+  size = size > 0 ? (size + 3) & ~3 : 4;
+  if (size > CHUNK_SIZE / 16) {
+    void* object = malloc(size);
+    if (!object)
+      fail("Out of memory for objects.");
+    return object;
+  }
+  if (chunkEnd - chunkNext < size) {
+    chunkNext = malloc(CHUNK_SIZE);
+    if (!chunkNext)
+      fail("Out of memory for objects.");
+    chunkEnd = chunkNext + CHUNK_SIZE;
+  }
+  void* object = chunkNext;
+  chunkNext += size;
+  return object;
+}
 
 int main() {
   // Call the Main_main function from the linked assembly
@@ -1,9 +1,20 @@
 #include "typecheck.hpp"
+#include "binding.hpp"
+#include "stats.hpp"
 #include "math.h"
 
-// Defines the function used to throw type errors. The possible
+std::string sourceName = "<stdin>";
+int typeErrorLimit = 20;
+int typeErrorCount = 0;
+
+// Defines the function used to report type errors. The possible
 // type errors are defined as an enumeration in the header file.
-void typeError(TypeErrorCode code) {
+// The message starts with where the error is, as file:line:column.
+void typeError(TypeErrorCode code, ASTNode* node) {
+  std::cerr << sourceName << ":";
+  if (node && node->location)
+    std::cerr << locationLine(node->location) << ":" << locationColumn(node->location) << ":";
+  std::cerr << " ";
   switch (code) {
     case undefined_variable: // In progress
       std::cerr << "Undefined variable." << std::endl;
@@ -59,8 +70,67 @@ void typeError(TypeErrorCode code) {
     case main_method_incorrect_signature: // I think this is done...
       std::cerr << "The \"main\" method of the \"Main\" class has an incorrect signature." << std::endl;
       break;
+    case class_redefined:
+      std::cerr << "Class is already defined." << std::endl;
+      break;
+    case spawn_returns_none:
+      std::cerr << "Spawned method does not return a value." << std::endl;
+      break;
+    case join_not_task:
+      std::cerr << "Joined expression is not a task." << std::endl;
+      break;
+  }
+  typeErrorCount++;
+  if (typeErrorLimit > 0 && typeErrorCount >= typeErrorLimit)
+    exit(1);
+}
+
+// True if an expression already had a type error, which its users
+// do not report again
+static bool isError(ExpressionNode* node) {
+  return node->basetype == bt_error;
+}
+
+// Every lookup of a name in the class, method and variable tables
+// goes through one of these, so that --stats can count them.
+// lookup returns the entry as find does, contains tells whether
+// there is one, and entry adds it when there is not, as [] does.
+template <typename Table>
+static typename Table::iterator lookup(Table* table, std::string name) {
+  stats.counters[stat_symbol_lookups]++;
+  return table->find(name);
+}
+
+template <typename Table>
+static bool contains(Table* table, std::string name) {
+  stats.counters[stat_symbol_lookups]++;
+  return table->count(name) != 0;
+}
+
+template <typename Table>
+static typename Table::mapped_type& entry(Table* table, std::string name) {
+  stats.counters[stat_symbol_lookups]++;
+  return (*table)[name];
+}
+
+// The type of the handle of a task that computes a value of the
+// given type, and the other way round (bt_none if there is none)
+static BaseType taskType(BaseType type) {
+  switch (type) {
+    case bt_boolean: return bt_task_boolean;
+    case bt_integer: return bt_task_integer;
+    case bt_object: return bt_task_object;
+    default: return bt_none;
+  }
+}
+
+static BaseType joinedType(BaseType type) {
+  switch (type) {
+    case bt_task_boolean: return bt_boolean;
+    case bt_task_integer: return bt_integer;
+    case bt_task_object: return bt_object;
+    default: return bt_none;
   }
-  exit(1);
 }
 
 // TypeCheck Visitor Functions: These are the functions you will
@@ -70,29 +140,38 @@ void typeError(TypeErrorCode code) {
 void TypeCheck::visitProgramNode(ProgramNode* node) {
   // Create new classTable, visit children
   classTable = new ClassTable;
-  node->visit_children(this);
-  
+  std::string programFile = sourceName;
+  visitChildren(node);
+  sourceName = programFile;
+  checkMain(node);
+
+  // Now that every table is complete, write the bindings of the
+  // names, which the code generator uses instead of the tables
+  if (typeErrorCount == 0)
+    bind(node, classTable);
+}
+
+void TypeCheck::checkMain(ProgramNode* node) {
   // Case where no "Main" class exists
-  if (classTable->find("Main") == classTable->end()) {
-    typeError(no_main_class);
+  if (lookup(classTable, "Main") == classTable->end()) {
+    typeError(no_main_class, node);
   }
   
   // Case where "Main" class exists
   else {
     // Case where "Main" has members
-    if (classTable->find("Main")->second.members->size() > 0) {
-        typeError(main_class_members_present);
+    if (lookup(classTable, "Main")->second.members->size() > 0) {
+        typeError(main_class_members_present, node);
     }
     // Case where "Main" has no main method
-    else if (classTable->find("Main")->second.methods->find("main") == classTable->find("Main")->second.methods->end()) {
-      typeError(no_main_method);
+    else if (lookup(lookup(classTable, "Main")->second.methods, "main") == lookup(classTable, "Main")->second.methods->end()) {
+      typeError(no_main_method, node);
     }
     // Case where main method has incorrect signature
-    else if (classTable->find("Main")->second.methods->find("main")->second.returnType.baseType != bt_none || classTable->find("Main")->second.methods->find("main")->second.parameters->size() > 0) {
-      typeError(main_method_incorrect_signature);
+    else if (lookup(lookup(classTable, "Main")->second.methods, "main")->second.returnType.baseType != bt_none || lookup(lookup(classTable, "Main")->second.methods, "main")->second.parameters->size() > 0) {
+      typeError(main_method_incorrect_signature, node);
     }
   }
-
 }
 
 void TypeCheck::visitClassNode(ClassNode* node) {
@@ -100,13 +179,26 @@ void TypeCheck::visitClassNode(ClassNode* node) {
   ClassInfo newClass;
   currentClassName = node->identifier_1->name;
 
+  std::map<ClassNode*, std::string>::iterator file = classFiles.find(node);
+  if (file != classFiles.end())
+    sourceName = file->second;
+
+  // A class may be defined only once in the whole program (which
+  // may be made of several files); the later definition is ignored
+  if (lookup(classTable, currentClassName) != classTable->end()) {
+    typeError(class_redefined, node->identifier_1);
+    return;
+  }
+
   // Check for superclass
   if (node->identifier_2) {
     newClass.superClassName = node->identifier_2->name;
     
-    // Check if superClass already defined
-    if (classTable->find(newClass.superClassName) == classTable->end()) {
-      typeError(undefined_class);
+    // Check if superClass already defined (if not, check the class
+    // as if it had none)
+    if (lookup(classTable, newClass.superClassName) == classTable->end()) {
+      typeError(undefined_class, node->identifier_2);
+      newClass.superClassName = "";
     }
   }
   else {
@@ -130,8 +222,10 @@ void TypeCheck::visitClassNode(ClassNode* node) {
     visitDeclarationNode(*it);
   }
   
-  // Insert result into classTable
+  // Insert result into classTable (the entry is a copy made before
+  // the members were counted, so update it there too)
   newClass.membersSize = currentMemberOffset;
+  lookup(classTable, currentClassName)->second.membersSize = currentMemberOffset;
   currentParameterOffset = 12;
 
   // Visit class methods and members (Declarations)
@@ -159,17 +253,17 @@ void TypeCheck::visitMethodNode(MethodNode* node) {
 
   currentVariableTable = newMethod.variables;
 
-  //Determines return type of the method idk why it works but it do
-  node->visit_children(this);
+  // Visit the signature first; the body is visited after the method
+  // is in the method table so that it can call itself recursively
+  visit(node->identifier);
+  for (std::list<ParameterNode*>::iterator it = node->parameter_list->begin(); it != node->parameter_list->end(); ++it) {
+    visit(*it);
+  }
+  visit(node->type);
   newMethod.returnType.baseType = node->type->basetype;
  
   if (newMethod.returnType.baseType == bt_object) {
     newMethod.returnType.objectClassName = node->type->objectClassName;
-    
-    // Check if objectClassName already defined
-    if (classTable->find(newMethod.returnType.objectClassName) == classTable->end()) {
-      typeError(undefined_class);
-    }
   }
   else {
     newMethod.returnType.objectClassName = node->identifier->name;
@@ -183,7 +277,7 @@ void TypeCheck::visitMethodNode(MethodNode* node) {
 
   // Check if the method is an invalid class constructor 
   if (node->identifier->name == currentClassName && node->type->basetype != bt_none) {
-    typeError(constructor_returns_type);
+    typeError(constructor_returns_type, node);
   }
 
   //Local offset of 12 + each param is 4
@@ -202,6 +296,10 @@ void TypeCheck::visitMethodNode(MethodNode* node) {
   //Reset currentParam node after visiting all params
   currentParameterOffset = 12;
 
+  // Insert into current methodTable, then check the body
+  currentMethodTable->insert({node->identifier->name, newMethod});
+  visit(node->methodbody);
+
   // Check if return type doesn't match
   
   // Check if return type is none
@@ -209,20 +307,21 @@ void TypeCheck::visitMethodNode(MethodNode* node) {
     // If there's a return here, the types don't match
     if (node->methodbody->returnstatement) {
       //std::cout << "Basetype is none, function has return node\n\n";
-      typeError(return_type_mismatch);
+      typeError(return_type_mismatch, node->methodbody->returnstatement);
     }
   }
-  // Else, the function must return something
-  else {
+  // Else, the function must return something (unless its type
+  // or its return value already had an error)
+  else if (node->type->basetype != bt_error) {
     // If there's no return OR the types don't match...
-    if (!(node->methodbody->returnstatement) || node->methodbody->returnstatement->basetype != node->type->basetype) {
-      typeError(return_type_mismatch);
+    if (!(node->methodbody->returnstatement) ||
+        (node->methodbody->returnstatement->basetype != node->type->basetype && node->methodbody->returnstatement->basetype != bt_error)) {
+      typeError(return_type_mismatch, node->methodbody->returnstatement ? (ASTNode*)node->methodbody->returnstatement : node);
     }
   }
 
-  // Set localsSize, insert into current methodTable
-  newMethod.localsSize = abs(currentLocalOffset);
-  currentMethodTable->insert({node->identifier->name, newMethod});
+  // Set localsSize now that all the locals have been seen
+  lookup(currentMethodTable, node->identifier->name)->second.localsSize = abs(currentLocalOffset);
 
 }
 
@@ -230,7 +329,7 @@ void TypeCheck::visitMethodBodyNode(MethodBodyNode* node) {
   // if (debug)
   //   std::cout << "Visiting methodBody node\n\n";
   // Visit Declaration list, statement list, and return statment
-  node->visit_children(this);
+  visitChildren(node);
 
   // If methodBody has a return... (necessary to have this?)
   if (node->returnstatement) {
@@ -246,7 +345,7 @@ void TypeCheck::visitMethodBodyNode(MethodBodyNode* node) {
 void TypeCheck::visitParameterNode(ParameterNode* node) {
   // if (debug)
   //   std::cout << "Visiting parameter node\n\n";
-  node->visit_children(this);
+  visitChildren(node);
   // Make new variableInfo object
   VariableInfo newVariable;
 
@@ -257,14 +356,6 @@ void TypeCheck::visitParameterNode(ParameterNode* node) {
   variableType.baseType = node->type->basetype;
   if (variableType.baseType == bt_object) {
     variableType.objectClassName = node->type->objectClassName;
-    
-    // Check if objectClassName is in classTable
-    if (classTable->find(variableType.objectClassName) == classTable->end()) {
-      typeError(undefined_class);
-    }
-  }
-  else {
-    variableType.objectClassName = node->identifier->name;
   }
 
   newVariable.type = variableType;
@@ -279,7 +370,7 @@ void TypeCheck::visitParameterNode(ParameterNode* node) {
 void TypeCheck::visitDeclarationNode(DeclarationNode* node) {
   // if (debug)
   //   std::cout << "Visiting declaration node\n\n";
-  node->visit_children(this);
+  visitChildren(node);
 
   for (auto it = node->identifier_list->begin(); it != node->identifier_list->end(); ++it){
     //Make new variable type per declaration ex: int a,b,c,d ... 
@@ -291,11 +382,6 @@ void TypeCheck::visitDeclarationNode(DeclarationNode* node) {
     // Check if basetype is an object
     if (variableType.baseType == bt_object) {
        variableType.objectClassName = node->type->objectClassName;
-       
-       // Check if objectClassName is in classTable
-       if (classTable->find(variableType.objectClassName) == classTable->end()) {
-        typeError(undefined_class);
-      }
     }
 
     //Make new varInfo and set it's type
@@ -323,7 +409,7 @@ void TypeCheck::visitReturnStatementNode(ReturnStatementNode* node) {
   // if (debug)
   //   std::cout << "Visiting return statement node\n\n";
 	//Evaluate expression for basetype
-    node->visit_children(this);
+    visitChildren(node);
     node->basetype = node->expression->basetype;
 
     // Check if basetype is an object
@@ -336,7 +422,7 @@ void TypeCheck::visitReturnStatementNode(ReturnStatementNode* node) {
 void TypeCheck::visitAssignmentNode(AssignmentNode* node) {
   // if (debug)
   //   std::cout << "Visiting assignment node\n\n";
-  node->visit_children(this);
+  visitChildren(node);
 
   bool foundID1 = false;
 
@@ -344,71 +430,79 @@ void TypeCheck::visitAssignmentNode(AssignmentNode* node) {
   std::string ID1Name = node->identifier_1->name;
   CompoundType ID1, ID2;
 
-  if (currentVariableTable->find(ID1Name) != currentVariableTable->end()) {
+  if (lookup(currentVariableTable, ID1Name) != currentVariableTable->end()) {
     foundID1 = true;
-    ID1.baseType = currentVariableTable->find(ID1Name)->second.type.baseType;
+    ID1.baseType = lookup(currentVariableTable, ID1Name)->second.type.baseType;
     if (ID1.baseType == bt_object) {
-      ID1.objectClassName = currentVariableTable->find(ID1Name)->second.type.objectClassName;
+      ID1.objectClassName = lookup(currentVariableTable, ID1Name)->second.type.objectClassName;
     }
   }
 
   else {
 
-    if (classTable->find(currentClassName)->second.members->find(ID1Name) != classTable->find(currentClassName)->second.members->end()) {
+    if (lookup(lookup(classTable, currentClassName)->second.members, ID1Name) != lookup(classTable, currentClassName)->second.members->end()) {
       foundID1 = true;
-      ID1.baseType = classTable->find(currentClassName)->second.members->find(ID1Name)->second.type.baseType;
+      ID1.baseType = lookup(lookup(classTable, currentClassName)->second.members, ID1Name)->second.type.baseType;
       if (ID1.baseType == bt_object) {
-        ID1.objectClassName = classTable->find(currentClassName)->second.members->find(ID1Name)->second.type.objectClassName;
+        ID1.objectClassName = lookup(lookup(classTable, currentClassName)->second.members, ID1Name)->second.type.objectClassName;
       }
     }
 
     else {
 
-      std::string superClass = classTable->find(currentClassName)->second.superClassName;
+      std::string superClass = lookup(classTable, currentClassName)->second.superClassName;
 
       while (superClass != "") {
 
-        if (classTable->find(superClass)->second.members->find(ID1Name) != classTable->find(superClass)->second.members->end()) {
+        if (lookup(lookup(classTable, superClass)->second.members, ID1Name) != lookup(classTable, superClass)->second.members->end()) {
           foundID1 = true;
-          ID1.baseType = classTable->find(superClass)->second.members->find(ID1Name)->second.type.baseType;
+          ID1.baseType = lookup(lookup(classTable, superClass)->second.members, ID1Name)->second.type.baseType;
           if (ID1.baseType == bt_object) {
-            ID1.objectClassName = classTable->find(superClass)->second.members->find(ID1Name)->second.type.objectClassName;
+            ID1.objectClassName = lookup(lookup(classTable, superClass)->second.members, ID1Name)->second.type.objectClassName;
           }
           break;
         }
         else {
-          superClass = classTable->find(superClass)->second.superClassName;
+          superClass = lookup(classTable, superClass)->second.superClassName;
         }
       }
     }
   }
 
   if (!foundID1) {
-    typeError(undefined_variable);
+    typeError(undefined_variable, node->identifier_1);
+    node->basetype = bt_error;
+    return;
   }
 
  
   // Check if Expr is of form (class.member)
   if (node->identifier_2) {
 
-    // Check if identifier_1 is an object
+    // Check if identifier_1 is an object (a variable whose type
+    // had an error was reported already)
     if (ID1.baseType != bt_object) {
-      typeError(not_object);
+      if (ID1.baseType != bt_error)
+        typeError(not_object, node);
+      node->basetype = bt_error;
+      return;
     }
     
     // Check if class does in fact declare the member
-    if (classTable->find(ID1.objectClassName) == classTable->end()) {
-      typeError(undefined_class);
+    if (lookup(classTable, ID1.objectClassName) == classTable->end()) {
+      typeError(undefined_class, node);
+      node->basetype = bt_error;
+      return;
     }
 
-    ClassInfo currClass = classTable->find(ID1.objectClassName)->second;
+    ClassInfo currClass = lookup(classTable, ID1.objectClassName)->second;
 
     // If we CAN find the member in the current class
-    if (currClass.members->find(node->identifier_2->name) != currClass.members->end()){
-      node->basetype = currClass.members->find(node->identifier_2->name)->second.type.baseType;
+    if (lookup(currClass.members, node->identifier_2->name) != currClass.members->end()){
+      node->basetype = lookup(currClass.members, node->identifier_2->name)->second.type.baseType;
       ID2.baseType = node->basetype;
       if (node->basetype == bt_object) {
-        node->objectClassName = currClass.members->find(node->identifier_2->name)->second.type.objectClassName;
+        node->objectClassName = lookup(currClass.members, node->identifier_2->name)->second.type.objectClassName;
         ID2.objectClassName = node->objectClassName;
       }
     }
@@ -419,7 +513,9 @@ void TypeCheck::visitAssignmentNode(AssignmentNode* node) {
       if (currClass.superClassName == "") {
         // if (debug) 
         //   std::cout << "Assignment Node: current class has no superclass\n\n";
-        typeError(undefined_member);
+        typeError(undefined_member, node->identifier_2);
+        node->basetype = bt_error;
+        return;
       }
 
       // Else, there must be a super class...
@@ -429,8 +525,8 @@ void TypeCheck::visitAssignmentNode(AssignmentNode* node) {
         // While we keep getting superclasses...
         while (superClass != "") {
           // If we can't find ID2 in the superClass' members...
-          if (classTable->find(superClass)->second.members->find(node->identifier_2->name) == classTable->find(superClass)->second.members->end()) {
-            superClass = classTable->find(superClass)->second.superClassName;
+          if (lookup(lookup(classTable, superClass)->second.members, node->identifier_2->name) == lookup(classTable, superClass)->second.members->end()) {
+            superClass = lookup(classTable, superClass)->second.superClassName;
           }
           // Else we've found it!
           else {
@@ -442,10 +538,10 @@ void TypeCheck::visitAssignmentNode(AssignmentNode* node) {
         if (found) {
           // if (debug) 
           //   std::cout << "Found member in superclass: " + superClass + "\n\n";
-          node->basetype = classTable->find(superClass)->second.members->find(node->identifier_2->name)->second.type.baseType;
+          node->basetype = lookup(lookup(classTable, superClass)->second.members, node->identifier_2->name)->second.type.baseType;
           ID2.baseType = node->basetype;
           if (node->basetype == bt_object) {
-            node->objectClassName = classTable->find(superClass)->second.members->find(node->identifier_2->name)->second.type.objectClassName;
+            node->objectClassName = lookup(lookup(classTable, superClass)->second.members, node->identifier_2->name)->second.type.objectClassName;
             ID2.objectClassName = node->objectClassName;
           }
         }
@@ -453,30 +549,32 @@ void TypeCheck::visitAssignmentNode(AssignmentNode* node) {
         else {
           // if (debug)
           //   std::cout << "Assignment Node: unable to find class member\n\n";
-          typeError(undefined_member);
+          typeError(undefined_member, node->identifier_2);
+          node->basetype = bt_error;
+          return;
         }
       }
     }
    
     // Check if basetypes are the same
     if (node->identifier_2) {
-      if (ID2.baseType != node->expression->basetype) {
+      if (ID2.baseType != node->expression->basetype && ID2.baseType != bt_error && !isError(node->expression)) {
         // CompoundType expr;
         // expr.baseType = node->expression->basetype;
         //std::cout << "Case where ID2 exists\n\n";
         //std::cout << "Assignment node: " + string(ID2) + " vs. " + string(expr) + "\n\n"; 
-        typeError(assignment_type_mismatch);
+        typeError(assignment_type_mismatch, node);
       }
     }
      
     else {
-      if (ID1.baseType != node->expression->basetype) {
+      if (ID1.baseType != node->expression->basetype && ID1.baseType != bt_error && !isError(node->expression)) {
         // CompoundType expr;
         // expr.baseType = node->expression->basetype;
         //std::cout << "Case where ID2 DOES NOT exist\n\n";  
         //std::cout << "Assignment node: " + string(ID1) + " vs. " + string(expr) + "\n\n"; 
     
-        typeError(assignment_type_mismatch);
+        typeError(assignment_type_mismatch, node);
       }
     }
   }
@@ -484,7 +582,7 @@ void TypeCheck::visitAssignmentNode(AssignmentNode* node) {
   // Expr of form (identifier = expr)
   else {
   // Check if basetypes are the same
-    if (ID1.baseType != node->expression->basetype) {
+    if (ID1.baseType != node->expression->basetype && ID1.baseType != bt_error && !isError(node->expression)) {
     // CompoundType expr;
     // expr.baseType = node->expression->basetype;
     // if (debug) {
@@ -492,7 +590,7 @@ void TypeCheck::visitAssignmentNode(AssignmentNode* node) {
     //   std::cout << "ID1Name: " << ID1Name << "\n\n";
     // }
 
-    typeError(assignment_type_mismatch);
+    typeError(assignment_type_mismatch, node);
     }
   }
   
@@ -505,7 +603,7 @@ void TypeCheck::visitAssignmentNode(AssignmentNode* node) {
 
 void TypeCheck::visitCallNode(CallNode* node) {
   // WRITEME: Replace with code if necessary
-  node->visit_children(this);
+  visitChildren(node);
 
 
 }
@@ -514,11 +612,11 @@ void TypeCheck::visitIfElseNode(IfElseNode* node) {
   // if (debug)
   //   std::cout << "Visiting IfElse node\n\n";
   //   Evaluate expression return type
-  node->visit_children(this);
+  visitChildren(node);
 
 	// Check that return type for condition is a boolean
-	if (node->expression->basetype != bt_boolean){
-		typeError(if_predicate_type_mismatch);
+	if (node->expression->basetype != bt_boolean && !isError(node->expression)){
+		typeError(if_predicate_type_mismatch, node->expression);
 	}
 }
 
@@ -526,38 +624,37 @@ void TypeCheck::visitWhileNode(WhileNode* node) {
   // Evaluate expression return type
   // if (debug)
   //   std::cout << "Visiting While node\n\n";
-  node->visit_children(this);
+  visitChildren(node);
 
 	// Check that return type for condition is a boolean
-	if (node->expression->basetype != bt_boolean){
-		typeError(while_predicate_type_mismatch);
+	if (node->expression->basetype != bt_boolean && !isError(node->expression)){
+		typeError(while_predicate_type_mismatch, node->expression);
 	}
 }
 
 void TypeCheck::visitDoWhileNode(DoWhileNode* node) {
   // Evaluate expression type
-	node->visit_children(this);
+	visitChildren(node);
 
-	if (node->expression->basetype != bt_boolean){
-		typeError(do_while_predicate_type_mismatch);
+	if (node->expression->basetype != bt_boolean && !isError(node->expression)){
+		typeError(do_while_predicate_type_mismatch, node->expression);
 	}
 }
 
 void TypeCheck::visitPrintNode(PrintNode* node) {
   // Just expand the expression here
   //std::cout << "Visiting Print Node\n\n";
-  node->visit_children(this);
-  node->expression->visit_children(this);
+  visitChildren(node);
 }
 
 void TypeCheck::visitPlusNode(PlusNode* node) {
   // if (debug)
   //   std::cout << "Visiting plus node\n\n";
-  node->visit_children(this);
+  visitChildren(node);
   
   // Check if basetypes match && are ints
-  if (node->expression_1->basetype != bt_integer || node->expression_2->basetype != bt_integer) {
-    typeError(expression_type_mismatch);
+  if ((node->expression_1->basetype != bt_integer || node->expression_2->basetype != bt_integer) && !isError(node->expression_1) && !isError(node->expression_2)) {
+    typeError(expression_type_mismatch, node);
   }
   
   node->basetype = bt_integer;
@@ -566,11 +663,11 @@ void TypeCheck::visitPlusNode(PlusNode* node) {
 void TypeCheck::visitMinusNode(MinusNode* node) {
   // if (debug)
   //   std::cout << "Visiting minus node\n\n";
-  node->visit_children(this);
+  visitChildren(node);
   
   // Check if basetypes match && are ints
-  if (node->expression_1->basetype != bt_integer || node->expression_2->basetype != bt_integer) {
-    typeError(expression_type_mismatch);
+  if ((node->expression_1->basetype != bt_integer || node->expression_2->basetype != bt_integer) && !isError(node->expression_1) && !isError(node->expression_2)) {
+    typeError(expression_type_mismatch, node);
   }
   
   node->basetype = bt_integer;
@@ -579,22 +676,22 @@ void TypeCheck::visitMinusNode(MinusNode* node) {
 void TypeCheck::visitTimesNode(TimesNode* node) {
   // if (debug)
   //   std::cout << "Visiting times node\n\n";
-  node->visit_children(this);
+  visitChildren(node);
 
   // Check if basetypes match && are ints
-  if (node->expression_1->basetype != bt_integer || node->expression_2->basetype != bt_integer) {
-    typeError(expression_type_mismatch);
+  if ((node->expression_1->basetype != bt_integer || node->expression_2->basetype != bt_integer) && !isError(node->expression_1) && !isError(node->expression_2)) {
+    typeError(expression_type_mismatch, node);
   }
   
   node->basetype = bt_integer;
 }
 
 void TypeCheck::visitDivideNode(DivideNode* node) {
-  node->visit_children(this);
+  visitChildren(node);
   
   // Check if basetypes match && are ints
-  if (node->expression_1->basetype != bt_integer || node->expression_2->basetype != bt_integer) {
-    typeError(expression_type_mismatch);
+  if ((node->expression_1->basetype != bt_integer || node->expression_2->basetype != bt_integer) && !isError(node->expression_1) && !isError(node->expression_2)) {
+    typeError(expression_type_mismatch, node);
   }
   
   node->basetype = bt_integer;
@@ -603,11 +700,11 @@ void TypeCheck::visitDivideNode(DivideNode* node) {
 void TypeCheck::visitGreaterNode(GreaterNode* node) {
   // if (debug)
   //   std::cout << "Visiting greater node\n\n";
-  node->visit_children(this);
+  visitChildren(node);
   
   // Check if basetypes match && are ints
-  if (node->expression_1->basetype != bt_integer || node->expression_2->basetype != bt_integer) {
-    typeError(expression_type_mismatch);
+  if ((node->expression_1->basetype != bt_integer || node->expression_2->basetype != bt_integer) && !isError(node->expression_1) && !isError(node->expression_2)) {
+    typeError(expression_type_mismatch, node);
   }
   
   node->basetype = bt_boolean;
@@ -616,11 +713,11 @@ void TypeCheck::visitGreaterNode(GreaterNode* node) {
 void TypeCheck::visitGreaterEqualNode(GreaterEqualNode* node) {
   // if (debug)
   //   std::cout << "Visiting greater or equal node\n\n";
-  node->visit_children(this);
+  visitChildren(node);
   
   // Check if basetypes match && are ints
-  if (node->expression_1->basetype != bt_integer || node->expression_2->basetype != bt_integer) {
-    typeError(expression_type_mismatch);
+  if ((node->expression_1->basetype != bt_integer || node->expression_2->basetype != bt_integer) && !isError(node->expression_1) && !isError(node->expression_2)) {
+    typeError(expression_type_mismatch, node);
   }
   
   node->basetype = bt_boolean;
@@ -629,7 +726,7 @@ void TypeCheck::visitGreaterEqualNode(GreaterEqualNode* node) {
 void TypeCheck::visitEqualNode(EqualNode* node) {
   // if (debug)
   //   std::cout << "Visiting equal node\n\n";
-  node->visit_children(this);
+  visitChildren(node);
   
   // Check if expressions are booleans OR ints
   if ((node->expression_1->basetype == bt_integer && node->expression_2->basetype == bt_integer) || (node->expression_1->basetype == bt_boolean && node->expression_2->basetype == bt_boolean)) {
@@ -637,18 +734,21 @@ void TypeCheck::visitEqualNode(EqualNode* node) {
     return;
   }
   else {
-    typeError(expression_type_mismatch);
+    if (!isError(node->expression_1) && !isError(node->expression_2))
+      typeError(expression_type_mismatch, node);
+    // Comparing still gives a boolean
+    node->basetype = bt_boolean;
   }
 }
 
 void TypeCheck::visitAndNode(AndNode* node) {
   // if (debug)
   //   std::cout << "Visiting and node\n\n";
-  node->visit_children(this);
+  visitChildren(node);
   
   // Check if basetypes match && are booleans
-  if (node->expression_1->basetype != bt_boolean || node->expression_2->basetype != bt_boolean) {
-    typeError(expression_type_mismatch);
+  if ((node->expression_1->basetype != bt_boolean || node->expression_2->basetype != bt_boolean) && !isError(node->expression_1) && !isError(node->expression_2)) {
+    typeError(expression_type_mismatch, node);
   }
   
   node->basetype = bt_boolean;
@@ -657,11 +757,11 @@ void TypeCheck::visitAndNode(AndNode* node) {
 void TypeCheck::visitOrNode(OrNode* node) {
   // if (debug)
   //   std::cout << "Visiting or node\n\n";
-  node->visit_children(this);
+  visitChildren(node);
   
   // Check if basetypes match && are booleans
-  if (node->expression_1->basetype != bt_boolean || node->expression_2->basetype != bt_boolean) {
-    typeError(expression_type_mismatch);
+  if ((node->expression_1->basetype != bt_boolean || node->expression_2->basetype != bt_boolean) && !isError(node->expression_1) && !isError(node->expression_2)) {
+    typeError(expression_type_mismatch, node);
   }
   
   node->basetype = bt_boolean;
@@ -670,11 +770,11 @@ void TypeCheck::visitOrNode(OrNode* node) {
 void TypeCheck::visitNotNode(NotNode* node) {
   // if (debug)
   //   std::cout << "Visiting not node\n\n";
-  node->visit_children(this);
+  visitChildren(node);
   
   // Check if basetype is boolean
-  if (node->expression->basetype != bt_boolean) {
-    typeError(expression_type_mismatch);
+  if (node->expression->basetype != bt_boolean && !isError(node->expression)) {
+    typeError(expression_type_mismatch, node);
   }
   
   node->basetype = bt_boolean;
@@ -683,11 +783,11 @@ void TypeCheck::visitNotNode(NotNode* node) {
 void TypeCheck::visitNegationNode(NegationNode* node) {
   // if (debug)
   //   std::cout << "Visiting negation node\n\n";
-  node->visit_children(this);
+  visitChildren(node);
   
   // Check if expression is bt_int
-  if (node->expression->basetype != bt_integer) {
-    typeError(expression_type_mismatch);
+  if (node->expression->basetype != bt_integer && !isError(node->expression)) {
+    typeError(expression_type_mismatch, node);
   }
   
   node->basetype = bt_integer;
@@ -696,7 +796,7 @@ void TypeCheck::visitNegationNode(NegationNode* node) {
 void TypeCheck::visitMethodCallNode(MethodCallNode* node) {
   // if (debug)
   //   std::cout << "Visiting MethodCallNode " << std::endl;
-	node->visit_children(this);
+	visitChildren(node);
 
 	//Init some values to be used throughout checking process
 	std::string methodName;
@@ -723,38 +823,39 @@ void TypeCheck::visitMethodCallNode(MethodCallNode* node) {
     CompoundType ID1;
 
     //Check local vars
-    if (currentVariableTable->find(callingClassName) != currentVariableTable->end()) {
-      ID1.baseType = currentVariableTable->find(callingClassName)->second.type.baseType;
-      objectCName  = currentVariableTable->find(callingClassName)->second.type.objectClassName;
+    if (lookup(currentVariableTable, callingClassName) != currentVariableTable->end()) {
+      ID1.baseType = lookup(currentVariableTable, callingClassName)->second.type.baseType;
+      objectCName  = lookup(currentVariableTable, callingClassName)->second.type.objectClassName;
       classFound = true;
     }
 
     //Check current members
-    VariableTable *currentMemberTable = (*classTable)[currentClassName].members;
+    VariableTable *currentMemberTable = entry(classTable, currentClassName).members;
 
-    if (currentMemberTable->count(callingClassName) != 0){
-      ID1.baseType = currentMemberTable->find(callingClassName)->second.type.baseType;
-      objectCName  = currentMemberTable->find(callingClassName)->second.type.objectClassName;
+    if (contains(currentMemberTable, callingClassName)){
+      ID1.baseType = lookup(currentMemberTable, callingClassName)->second.type.baseType;
+      objectCName  = lookup(currentMemberTable, callingClassName)->second.type.objectClassName;
       classFound   = true;
     }
 
 
     //We didn't find it, need to start searching superClasses
-    if (currentVariableTable->count(callingClassName) == 0){
-      std::string superClass = (*classTable)[currentClassName].superClassName;
+    if (!contains(currentVariableTable, callingClassName)){
+      std::string superClass = entry(classTable, currentClassName).superClassName;
 
       while (superClass != ""){
 
-        VariableTable *vi = (*classTable)[superClass].members;
+        VariableTable *vi = entry(classTable, superClass).members;
 
-        if (vi->count(callingClassName) != 0){
-          ID1.baseType = vi->find(callingClassName)->second.type.baseType;
-          objectCName  = vi->find(callingClassName)->second.type.objectClassName;
+        if (contains(vi, callingClassName)){
+          ID1.baseType = lookup(vi, callingClassName)->second.type.baseType;
+          objectCName  = lookup(vi, callingClassName)->second.type.objectClassName;
           classFound = true;
           break; 
         }
 
-        superClass = (*classTable)[superClass].superClassName;
+        superClass = entry(classTable, superClass).superClassName;
+        stats.counters[stat_superclass_hops]++;
 
         
       }
@@ -762,41 +863,51 @@ void TypeCheck::visitMethodCallNode(MethodCallNode* node) {
     }
 
     if (!classFound) {
-      typeError(undefined_variable);
+      typeError(undefined_variable, node);
+      node->basetype = bt_error;
+      return;
     }
     //Check that callingClassName is an actual variable of type class
-    if (ID1.baseType != bt_object)
-      typeError(not_object);
+    //(a variable whose type had an error was reported already)
+    if (ID1.baseType != bt_object) {
+      if (ID1.baseType != bt_error)
+        typeError(not_object, node);
+      node->basetype = bt_error;
+      return;
+    }
 
 		//Might need to check if method is inherrited 
-    MethodTable *mTable = (*classTable)[objectCName].methods;
+    MethodTable *mTable = entry(classTable, objectCName).methods;
 
     //Check current object methods
-    if (mTable->count(methodName) != 0){
+    if (contains(mTable, methodName)){
       methodFound = true;
     }
 
     //Check if inherrited
     if (!methodFound){
-      std::string superClassName = (*classTable)[objectCName].superClassName;
+      std::string superClassName = entry(classTable, objectCName).superClassName;
 
       while(superClassName != ""){
 
         //std::cout << "Now looking for method " + methodName + " in class " + superClassName << std::endl;
         
-        if ( (*classTable)[superClassName].methods->count(methodName) != 0 ){
+        if ( contains(entry(classTable, superClassName).methods, methodName) ){
           methodFound = true;
           objectCName = superClassName;
           break;
         }
 
-        superClassName = (*classTable)[superClassName].superClassName;
+        superClassName = entry(classTable, superClassName).superClassName;
+        stats.counters[stat_superclass_hops]++;
       }
 
     }
 
     if (!methodFound){
-      typeError(undefined_method);
+      typeError(undefined_method, node);
+      node->basetype = bt_error;
+      return;
     }
 		
   }
@@ -815,21 +926,21 @@ void TypeCheck::visitMethodCallNode(MethodCallNode* node) {
 		std::map<std::string, MethodInfo>* methods = currentMethodTable;
 
 		//We found our method in our current methodTable
-		if (methods->count(methodName) != 0){
+		if (contains(methods, methodName)){
       methodFound = true;
       objectCName = currentClassName;
 		}
 
 		//If we didn't find the method, we need to see if it's inherrited from a superclass
 		else {
-      std::string superClassName = (*classTable)[currentClassName].superClassName;
+      std::string superClassName = entry(classTable, currentClassName).superClassName;
 
       //For each super class, check if the method is defined
       while (superClassName != ""){
-        MethodTable* superClassMethods = (*classTable)[superClassName].methods;
+        MethodTable* superClassMethods = entry(classTable, superClassName).methods;
 
         //We found the className and everthing is fine
-        if (superClassMethods->count(methodName) != 0){
+        if (contains(superClassMethods, methodName)){
           //std::cout << "found method : " + methodName + " in class " + superClassName << std::endl;
           methodFound = true;
           objectCName = superClassName;
@@ -838,13 +949,16 @@ void TypeCheck::visitMethodCallNode(MethodCallNode* node) {
         }
 
         //Else we didn't find the method so we update the superclass and keep looking
-        superClassName = (*classTable)[superClassName].superClassName;
+        superClassName = entry(classTable, superClassName).superClassName;
+        stats.counters[stat_superclass_hops]++;
       }
     }
 
 		//After checking all the superclasses we didn't find the method so throw an error
 		if (!methodFound){
-			typeError(undefined_method);
+			typeError(undefined_method, node);
+			node->basetype = bt_error;
+			return;
 		}
 
 	}
@@ -855,16 +969,7 @@ void TypeCheck::visitMethodCallNode(MethodCallNode* node) {
 
   //std::cout << "class - " + objectCName + " | method - " + methodName << std::endl;
 
-  //This line segfaults --> we don't find the method
-  if ( (*classTable)[objectCName].methods->find(methodName) == (*classTable)[objectCName].methods->end() ){
-    std::cout << "looking for method - " + methodName + " | class - " + objectCName << std::endl; 
-    for (auto it = (*classTable)[objectCName].methods->begin(); it != (*classTable)[objectCName].methods->end(); ++it){
-      std::cout << "method - " + it->first << std::endl;  
-    } 
-  }
-
-
-  MethodInfo mi = (*classTable)[objectCName].methods->find(methodName)->second;
+  MethodInfo mi = lookup(entry(classTable, objectCName).methods, methodName)->second;
 
   //Set the return type
   node->basetype = mi.returnType.baseType;
@@ -877,8 +982,8 @@ void TypeCheck::visitMethodCallNode(MethodCallNode* node) {
 		argType   = (*args)->basetype;
 		paramType = params->baseType;
 
-		if (argType != paramType){
-			typeError(argument_type_mismatch);			
+		if (argType != paramType && argType != bt_error && paramType != bt_error){
+			typeError(argument_type_mismatch, *args);			
 		}
 
 		++args;
@@ -887,14 +992,14 @@ void TypeCheck::visitMethodCallNode(MethodCallNode* node) {
 
 	//If both iterators do not equal end, then we have an unequal number of params
 	if (args != node->expression_list->end() || params != mi.parameters->end()){
-		typeError(argument_number_mismatch);
+		typeError(argument_number_mismatch, node);
 	}
 
 }
 
 void TypeCheck::visitMemberAccessNode(MemberAccessNode* node) {
   // // WRITEME: Replace with code if necessary
-  node->visit_children(this);
+  visitChildren(node);
 
   // Determine ID1 baseType
   std::string ID1Name = node->identifier_1->name;
@@ -903,81 +1008,96 @@ void TypeCheck::visitMemberAccessNode(MemberAccessNode* node) {
 
   bool foundMember = false;
 
-  if (node->identifier_1->basetype != bt_object){
-    // if (debug)
-    //   std::cout << ID1Name << " is not an object" << std::endl;
-    typeError(not_object);
+  // Determine ID1 type
+  bool foundID1 = false;
+  CompoundType ID1;
+
+  if (lookup(currentVariableTable, ID1Name) != currentVariableTable->end()) {
+    foundID1 = true;
+    ID1 = lookup(currentVariableTable, ID1Name)->second.type;
+  }
+
+  else if (lookup(lookup(classTable, currentClassName)->second.members, ID1Name) != lookup(classTable, currentClassName)->second.members->end()) {
+    foundID1 = true;
+    ID1 = lookup(lookup(classTable, currentClassName)->second.members, ID1Name)->second.type;
+  }
+
+  else {
+    std::string superClass = lookup(classTable, currentClassName)->second.superClassName;
+    while (superClass != "") {
+      if (lookup(lookup(classTable, superClass)->second.members, ID1Name) != lookup(classTable, superClass)->second.members->end()) {
+        foundID1 = true;
+        ID1 = lookup(lookup(classTable, superClass)->second.members, ID1Name)->second.type;
+        break;
+      }
+      else {
+        superClass = lookup(classTable, superClass)->second.superClassName;
+      }
+    }
+  }
+
+  if (!foundID1) {
+    typeError(undefined_variable, node->identifier_1);
+    node->basetype = bt_error;
+    return;
+  }
+
+  // Check if identifier_1 is an object (a variable whose type had an
+  // error was reported already)
+  if (ID1.baseType != bt_object) {
+    if (ID1.baseType != bt_error)
+      typeError(not_object, node);
+    node->basetype = bt_error;
+    return;
   }
 
   //Check current class
-  if (currentVariableTable->find(ID2Name) != currentVariableTable->end()) {
-    ID2.baseType = currentVariableTable->find(ID2Name)->second.type.baseType;
+  if (lookup(currentVariableTable, ID2Name) != currentVariableTable->end()) {
+    ID2.baseType = lookup(currentVariableTable, ID2Name)->second.type.baseType;
     if (ID2.baseType == bt_object) {
-      ID2.objectClassName = currentVariableTable->find(ID2Name)->second.type.objectClassName;
+      ID2.objectClassName = lookup(currentVariableTable, ID2Name)->second.type.objectClassName;
     }
     foundMember = true;
   }
 
   //Check super classes
   else {
-    std::string superClassName = classTable->find(currentClassName)->second.superClassName;
+    std::string superClassName = lookup(classTable, currentClassName)->second.superClassName;
 
     while (superClassName != ""){
 
       //Look in the members of the super class for our thing
-      VariableTable *members = (*classTable)[superClassName].members;
+      VariableTable *members = entry(classTable, superClassName).members;
 
-      if (members->count(ID2Name) != 0){
-        ID2.baseType = members->find(ID2Name)->second.type.baseType;
+      if (contains(members, ID2Name)){
+        ID2.baseType = lookup(members, ID2Name)->second.type.baseType;
         foundMember = true;
 
         if (ID2.baseType == bt_object) {
-          ID2.objectClassName = members->find(ID2Name)->second.type.baseType;
+          ID2.objectClassName = lookup(members, ID2Name)->second.type.baseType;
         }
         break;
       }
       // superClassName = (*classTable)[superClassName].superClassName;
       else {
-        superClassName = classTable->find(superClassName)->second.superClassName;
+        superClassName = lookup(classTable, superClassName)->second.superClassName;
       }
     }
 
-    // Check if objectClassName of ID1 contains member
-    std::string objectClassName1;
-    if (currentVariableTable->find(ID1Name) != currentVariableTable->end()) {
-      objectClassName1 = currentVariableTable->find(ID1Name)->second.type.objectClassName;
-    }
-
-    else if (classTable->find(currentClassName)->second.members->find(ID1Name) != classTable->find(currentClassName)->second.members->end()) {
-      objectClassName1 = classTable->find(currentClassName)->second.members->find(ID1Name)->second.type.objectClassName;
-    }
-
-    else {
-      std::string superClass = classTable->find(currentClassName)->second.superClassName;
-      while (superClass != "") {
-        if (classTable->find(superClass)->second.members->find(ID1Name) != classTable->find(superClass)->second.members->end()) {
-          objectClassName1 = classTable->find(superClass)->second.members->find(ID1Name)->second.type.objectClassName;
-          break;
-        }
-        else {
-          superClass = classTable->find(superClass)->second.superClassName;
+    // Check if the class of ID1 contains member; a class that is not
+    // in the table was reported where it was named
+    std::string objectClassName1 = ID1.objectClassName;
+    while (objectClassName1 != "" && lookup(classTable, objectClassName1) != classTable->end()) {
+      if (lookup(lookup(classTable, objectClassName1)->second.members, ID2Name) != lookup(classTable, objectClassName1)->second.members->end()) {
+        ID2.baseType = lookup(lookup(classTable, objectClassName1)->second.members, ID2Name)->second.type.baseType;
+        if (ID2.baseType == bt_object) {
+          ID2.objectClassName = lookup(lookup(classTable, objectClassName1)->second.members, ID2Name)->second.type.baseType;
         }
+        foundMember = true;
+        break;
       }
-    } 
-    
-    while (objectClassName1 != "") {
-      if (classTable->find(objectClassName1) != classTable->end()) {
-        if (classTable->find(objectClassName1)->second.members->find(ID2Name) != classTable->find(objectClassName1)->second.members->end()) {
-          ID2.baseType = classTable->find(objectClassName1)->second.members->find(ID2Name)->second.type.baseType;
-          if (ID2.baseType == bt_object) {
-            ID2.objectClassName = classTable->find(objectClassName1)->second.members->find(ID2Name)->second.type.baseType;
-          }
-          foundMember = true;
-          break;
-        }
-        else {
-          objectClassName1 = classTable->find(objectClassName1)->second.superClassName;
-        }
+      else {
+        objectClassName1 = lookup(classTable, objectClassName1)->second.superClassName;
       }
     }
   }
@@ -988,7 +1108,9 @@ void TypeCheck::visitMemberAccessNode(MemberAccessNode* node) {
     //   std::cout << "Object: " << ID1Name << "\n\n";
     //   std::cout << "MemberAccess Node: member not found\n\n";
     // }
-    typeError(undefined_member);
+    typeError(undefined_member, node);
+    node->basetype = bt_error;
+    return;
   }
 
   node->basetype = ID2.baseType;
@@ -1001,28 +1123,28 @@ void TypeCheck::visitMemberAccessNode(MemberAccessNode* node) {
 void TypeCheck::visitVariableNode(VariableNode* node) {
   // if (debug)
   //   std::cout << "Visiting variable node\n\n";
-  node->visit_children(this);
+  visitChildren(node);
 
   std::string varName = node->identifier->name;
   //std::cout << "varName is: " << varName << "\n\n";
   // Check if variable is undefined
   
   // If variable in current variable table
-  if (currentVariableTable->find(varName) != currentVariableTable->end()) {
-    node->basetype = currentVariableTable->find(node->identifier->name)->second.type.baseType;
+  if (lookup(currentVariableTable, varName) != currentVariableTable->end()) {
+    node->basetype = lookup(currentVariableTable, node->identifier->name)->second.type.baseType;
      // Check if variable is an object
     if (node->basetype == bt_object) {
-      node->objectClassName = currentVariableTable->find(varName)->second.type.objectClassName;
+      node->objectClassName = lookup(currentVariableTable, varName)->second.type.objectClassName;
     }
   } 
 
   // Else, if variable is a class member
-  else if (classTable->find(currentClassName)->second.members->find(varName) != classTable->find(currentClassName)->second.members->end()) {
-    node->basetype = classTable->find(currentClassName)->second.members->find(varName)->second.type.baseType;
+  else if (lookup(lookup(classTable, currentClassName)->second.members, varName) != lookup(classTable, currentClassName)->second.members->end()) {
+    node->basetype = lookup(lookup(classTable, currentClassName)->second.members, varName)->second.type.baseType;
 
     // Check if variable is an object
     if (node->basetype == bt_object) {
-      node->objectClassName = classTable->find(currentClassName)->second.members->find(varName)->second.type.objectClassName;
+      node->objectClassName = lookup(lookup(classTable, currentClassName)->second.members, varName)->second.type.objectClassName;
     }
   }
 
@@ -1030,34 +1152,36 @@ void TypeCheck::visitVariableNode(VariableNode* node) {
 
 
   // Else, variable may be in superclass(es)
-  else if (classTable->find(currentClassName)->second.members->find(varName) == classTable->find(currentClassName)->second.members->end()) {
-    std::string superClass = classTable->find(currentClassName)->second.superClassName;
+  else if (lookup(lookup(classTable, currentClassName)->second.members, varName) == lookup(classTable, currentClassName)->second.members->end()) {
+    std::string superClass = lookup(classTable, currentClassName)->second.superClassName;
     bool inSuperClass = false;
 
     while (superClass != "") {
-      if (classTable->find(superClass)->second.members->find(varName) != classTable->find(superClass)->second.members->end()) {
+      if (lookup(lookup(classTable, superClass)->second.members, varName) != lookup(classTable, superClass)->second.members->end()) {
         inSuperClass = true;
         break;
       }
-      superClass = (*classTable)[superClass].superClassName;
+      superClass = entry(classTable, superClass).superClassName;
     }
 
     if (inSuperClass) {
-      node->basetype = classTable->find(superClass)->second.members->find(varName)->second.type.baseType;
+      node->basetype = lookup(lookup(classTable, superClass)->second.members, varName)->second.type.baseType;
       // Check if basetype is object
       if (node->basetype == bt_object) {
-        node->objectClassName = classTable->find(superClass)->second.members->find(varName)->second.type.objectClassName;
+        node->objectClassName = lookup(lookup(classTable, superClass)->second.members, varName)->second.type.objectClassName;
       }
     }
 
     else {
-      typeError(undefined_variable);
+      typeError(undefined_variable, node);
+      node->basetype = bt_error;
     }
   }
   
   else {
 
-    typeError(undefined_variable);
+    typeError(undefined_variable, node);
+    node->basetype = bt_error;
   }
 
   CompoundType var;
@@ -1078,25 +1202,29 @@ void TypeCheck::visitBooleanLiteralNode(BooleanLiteralNode* node) {
 }
 
 void TypeCheck::visitNewNode(NewNode* node) {
-  node->visit_children(this);
+  visitChildren(node);
 
   // See if "new" class exists
-  if (classTable->find(node->identifier->name) == classTable->end()) {
-    typeError(undefined_class);
+  if (lookup(classTable, node->identifier->name) == classTable->end()) {
+    typeError(undefined_class, node);
+    node->basetype = bt_error;
+    return;
   }
+  node->basetype = bt_object;
 
   //Check that the constructor expects arguments
   if (node->expression_list){
     std::string objectCName = node->identifier->name;
-    MethodTable *constructor = (*classTable)[objectCName].methods;
+    MethodTable *constructor = entry(classTable, objectCName).methods;
 
     //Check constructor exists
-    if (constructor->count(objectCName) == 0)
-      typeError(undefined_method);
-
+    if (!contains(constructor, objectCName)) {
+      typeError(undefined_method, node);
+      return;
+    }
 
     //Else check the variable types match and have same args
-    MethodInfo mi = constructor->find(objectCName)->second;
+    MethodInfo mi = lookup(constructor, objectCName)->second;
 
     std::list<ExpressionNode*>::iterator args = node->expression_list->begin();
     std::list<CompoundType>::iterator  params = mi.parameters->begin();
@@ -1108,8 +1236,8 @@ void TypeCheck::visitNewNode(NewNode* node) {
       argType   = (*args)->basetype;
       paramType = params->baseType;
 
-      if (argType != paramType){
-        typeError(argument_type_mismatch);			
+      if (argType != paramType && argType != bt_error && paramType != bt_error){
+        typeError(argument_type_mismatch, *args);			
       }
 
       ++args;
@@ -1118,15 +1246,38 @@ void TypeCheck::visitNewNode(NewNode* node) {
 
     //If both iterators do not equal end, then we have an unequal number of params
     if (args != node->expression_list->end() || params != mi.parameters->end()){
-      typeError(argument_number_mismatch);
+      typeError(argument_number_mismatch, node);
     }
 
   }
+}
 
+// The call is checked as any other; what it returns is the type of
+// the task
+void TypeCheck::visitSpawnNode(SpawnNode* node) {
+  visitChildren(node);
+  if (isError(node->methodcall)) {
+    node->basetype = bt_error;
+    return;
+  }
+  node->basetype = taskType(node->methodcall->basetype);
+  if (node->basetype == bt_none) {
+    typeError(spawn_returns_none, node);
+    node->basetype = bt_error;
+  }
+}
 
-
-
-  node->basetype = bt_object;
+void TypeCheck::visitJoinNode(JoinNode* node) {
+  visitChildren(node);
+  if (isError(node->expression)) {
+    node->basetype = bt_error;
+    return;
+  }
+  node->basetype = joinedType(node->expression->basetype);
+  if (node->basetype == bt_none) {
+    typeError(join_not_task, node);
+    node->basetype = bt_error;
+  }
 }
 
 void TypeCheck::visitIntegerTypeNode(IntegerTypeNode* node) {
@@ -1138,10 +1289,23 @@ void TypeCheck::visitBooleanTypeNode(BooleanTypeNode* node) {
 }
 
 void TypeCheck::visitObjectTypeNode(ObjectTypeNode* node) {
+  // Check if the class is in classTable (declared before this use)
+  if (lookup(classTable, node->identifier->name) == classTable->end()) {
+    typeError(undefined_class, node);
+    node->basetype = bt_error;
+    return;
+  }
   node->basetype = bt_object;
   node->objectClassName = node->identifier->name;
 }
 
+// Tasks are typed by the base type of their value, as objects are
+// not told apart by class
+void TypeCheck::visitTaskTypeNode(TaskTypeNode* node) {
+  visitChildren(node);
+  node->basetype = node->type->basetype == bt_error ? bt_error : taskType(node->type->basetype);
+}
+
 void TypeCheck::visitNoneNode(NoneNode* node) {
   node->basetype = bt_none;
 }
@@ -1161,6 +1325,57 @@ void TypeCheck::visitIntegerNode(IntegerNode* node) {
   // WRITEME: Replace with code if necessary
 }
 
+// The following functions look up members and methods through the
+// superclass chain. They are shared by the passes that run after
+// the TypeCheck visitor.
+
+int objectSize(ClassTable* classTable, std::string className) {
+  int size = 0;
+  while (className != "") {
+    ClassInfo& info = lookup(classTable, className)->second;
+    size += info.membersSize;
+    className = info.superClassName;
+  }
+  return size;
+}
+
+bool findMember(ClassTable* classTable, std::string className, std::string memberName,
+                VariableInfo* info, std::string* declaringClass, int* offset) {
+  while (className != "" && lookup(classTable, className) != classTable->end()) {
+    ClassInfo& classInfo = lookup(classTable, className)->second;
+    VariableTable::iterator member = lookup(classInfo.members, memberName);
+    if (member != classInfo.members->end()) {
+      if (info)
+        *info = member->second;
+      if (declaringClass)
+        *declaringClass = className;
+      // Superclass members come first in an object
+      if (offset)
+        *offset = objectSize(classTable, classInfo.superClassName) + member->second.offset;
+      return true;
+    }
+    className = classInfo.superClassName;
+  }
+  return false;
+}
+
+bool findMethod(ClassTable* classTable, std::string className, std::string methodName,
+                MethodInfo* info, std::string* declaringClass) {
+  while (className != "" && lookup(classTable, className) != classTable->end()) {
+    ClassInfo& classInfo = lookup(classTable, className)->second;
+    MethodTable::iterator method = lookup(classInfo.methods, methodName);
+    if (method != classInfo.methods->end()) {
+      if (info)
+        *info = method->second;
+      if (declaringClass)
+        *declaringClass = className;
+      return true;
+    }
+    className = classInfo.superClassName;
+  }
+  return false;
+}
+
 // The following functions are used to print the Symbol Table.
 // They do not need to be modified at all.
 
@@ -1181,6 +1396,14 @@ std::string string(CompoundType type) {
       return std::string("None");
     case bt_object:
       return std::string("Object(") + type.objectClassName + std::string(")");
+    case bt_task_integer:
+      return std::string("Task(Integer)");
+    case bt_task_boolean:
+      return std::string("Task(Boolean)");
+    case bt_task_object:
+      return std::string("Task(Object)");
+    case bt_error:
+      return std::string("Error");
     default:
       return std::string("");
   }
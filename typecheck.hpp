@@ -88,19 +88,35 @@ typedef enum {
   no_main_class,
   main_class_members_present,
   no_main_method,
-  main_method_incorrect_signature
+  main_method_incorrect_signature,
+  class_redefined,
+  spawn_returns_none,
+  join_not_task
 } TypeErrorCode;
 
-// Declares a a function which will display type errors, then
-// terminate the program with an error status code. The
-// possible type errors are defined as an enumeration above.
-void typeError(TypeErrorCode code);
+// The name of the file being compiled, which diagnostics start with
+// ("<stdin>" when the program is read from standard input).
+extern std::string sourceName;
+
+// The number of type errors after which type checking stops (0 for
+// no limit), and the number reported so far. The checker recovers
+// from an error by giving the offending expression the type bt_error,
+// and the compiler stops after type checking if any were reported.
+extern int typeErrorLimit;
+extern int typeErrorCount;
+
+// Declares a a function which will display type errors at the
+// position of the given node, and terminate the program with an
+// error status code once typeErrorLimit errors have been reported.
+// The possible type errors are defined as an enumeration above.
+void typeError(TypeErrorCode code, ASTNode* node);
 
 // This defines the TypeCheck visitor, which will visit the AST
 // and construct the symbol table. You will do all your
 // implementation of the symbol table construction in the
-// visitor functions for this visitor.
-class TypeCheck : public Visitor {
+// visitor functions for this visitor. Within the tree it is
+// dispatched statically (see StaticVisitor in ast.hpp).
+class TypeCheck : public Visitor, public StaticVisitor<TypeCheck> {
 public:
   // This member represents the main class table. You can
   // think of this as the "root" of the symbol table.
@@ -109,6 +125,10 @@ public:
   // and set this pointer at the beginning of the TypeCheck
   // visitor pass over the AST.
   ClassTable* classTable;
+
+  // The file each class comes from, when a program is made of
+  // several files: errors in a class start with the name of its file
+  std::map<ClassNode*, std::string> classFiles;
   
   // These members allow you to keep track of the current
   // method table and and current variable table. This allows
@@ -146,6 +166,13 @@ public:
   // This member allows you to keep track of the name of the
   // current class. This is necessary for type checking.
   std::string currentClassName;
+
+  // Checks that the program has a Main class with a proper main
+  // method, once all its classes have been visited. A class is
+  // checked by visitClassNode on its own, using only the classes
+  // visited before it, so a program may also be checked one class
+  // at a time, starting with a new classTable.
+  void checkMain(ProgramNode* node);
   
   // All the visitor functions. You will need to write
   // appropriate implementation in the typecheck.cpp file.
@@ -179,14 +206,34 @@ public:
   virtual void visitIntegerLiteralNode(IntegerLiteralNode* node);
   virtual void visitBooleanLiteralNode(BooleanLiteralNode* node);
   virtual void visitNewNode(NewNode* node);
+  virtual void visitSpawnNode(SpawnNode* node);
+  virtual void visitJoinNode(JoinNode* node);
   virtual void visitIntegerTypeNode(IntegerTypeNode* node);
   virtual void visitBooleanTypeNode(BooleanTypeNode* node);
   virtual void visitObjectTypeNode(ObjectTypeNode* node);
+  virtual void visitTaskTypeNode(TaskTypeNode* node);
   virtual void visitNoneNode(NoneNode* node);
   virtual void visitIdentifierNode(IdentifierNode* node);
   virtual void visitIntegerNode(IntegerNode* node);
 };
 
+// Returns the size in bytes of an object of the given class,
+// including the members of all its superclasses.
+int objectSize(ClassTable* classTable, std::string className);
+
+// Looks up a member in a class, then in its superclasses. When it
+// is found, sets (if not NULL) the member's info, the name of the
+// class that declares it, and its offset from the start of the
+// object, where superclass members come first.
+bool findMember(ClassTable* classTable, std::string className, std::string memberName,
+                VariableInfo* info, std::string* declaringClass, int* offset);
+
+// Looks up a method in a class, then in its superclasses. When it
+// is found, sets (if not NULL) the method's info and the name of
+// the class that declares it.
+bool findMethod(ClassTable* classTable, std::string className, std::string methodName,
+                MethodInfo* info, std::string* declaringClass);
+
 // The following functions are used to print the Symbol Table.
 // They do not need to be modified at all.
 
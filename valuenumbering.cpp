@@ -0,0 +1,292 @@
+#include "valuenumbering.hpp"
+#include "constantfolding.hpp"
+
+#include <sstream>
+#include <typeinfo>
+
+void ValueNumbering::run(ProgramNode* program, ClassTable* classTable) {
+  effects = computeEffects(program, classTable);
+  for (std::list<ClassNode*>::iterator c = program->class_list->begin(); c != program->class_list->end(); c++) {
+    for (std::list<MethodNode*>::iterator m = (*c)->method_list->begin(); m != (*c)->method_list->end(); m++) {
+      scope = MethodScope(classTable, (*c)->identifier_1->name, (*m)->identifier->name);
+      MethodBodyNode* body = (*m)->methodbody;
+      numberStatements(body->statement_list);
+
+      if (body->returnstatement) {
+        EffectsCollector statement(&scope, &effects);
+        statement.collect(body->returnstatement->expression);
+        number(&body->returnstatement->expression, NULL, NULL, std::list<StatementNode*>::iterator(), false, statement);
+      }
+
+      for (std::vector<Available*>::iterator it = entries.begin(); it != entries.end(); it++)
+        delete *it;
+      entries.clear();
+      buckets.clear();
+      byLocal.clear();
+      byOffset.clear();
+      changes.clear();
+      definitions.clear();
+    }
+  }
+}
+
+// Worth keeping in a local: anything but literals and locals, as
+// long as it calls nothing and allocates nothing
+bool ValueNumbering::isCandidate(ExpressionNode* node) {
+  int value;
+  if (isLiteral(node, &value))
+    return false;
+  if (VariableNode* n = dynamic_cast<VariableNode*>(node))
+    return !scope.isLocal(n->identifier->name);
+
+  std::vector<ExpressionNode*> work(1, node);
+  while (!work.empty()) {
+    ExpressionNode* current = work.back();
+    work.pop_back();
+    if (dynamic_cast<MethodCallNode*>(current) || dynamic_cast<NewNode*>(current) ||
+        dynamic_cast<SpawnNode*>(current) || dynamic_cast<JoinNode*>(current))
+      return false;
+    std::vector<ExpressionNode**> slots = children(current);
+    for (std::vector<ExpressionNode**>::iterator it = slots.begin(); it != slots.end(); it++)
+      work.push_back(**it);
+  }
+  return true;
+}
+
+void ValueNumbering::reads(ExpressionNode* node, std::set<std::string>& locals, std::set<int>& offsets) {
+  if (VariableNode* n = dynamic_cast<VariableNode*>(node)) {
+    std::string name = n->identifier->name;
+    if (scope.isLocal(name))
+      locals.insert(name);
+    else
+      offsets.insert(scope.memberOffset(name));
+    return;
+  }
+  if (MemberAccessNode* n = dynamic_cast<MemberAccessNode*>(node)) {
+    std::string name = n->identifier_1->name;
+    if (scope.isLocal(name))
+      locals.insert(name);
+    else
+      offsets.insert(scope.memberOffset(name));
+    offsets.insert(scope.memberOffset(scope.typeOf(name).objectClassName, n->identifier_2->name));
+    return;
+  }
+  std::vector<ExpressionNode**> slots = children(node);
+  for (std::vector<ExpressionNode**>::iterator it = slots.begin(); it != slots.end(); it++)
+    reads(**it, locals, offsets);
+}
+
+// A structural hash, where the new locals hash like the expression
+// they hold (matching sameExpression with the definitions map)
+unsigned ValueNumbering::hash(ExpressionNode* node) {
+  if (VariableNode* n = dynamic_cast<VariableNode*>(node)) {
+    std::map<std::string, ExpressionNode*>::iterator definition = definitions.find(n->identifier->name);
+    if (definition != definitions.end())
+      return hash(definition->second);
+  }
+
+  unsigned h = 0;
+  const char* kind = typeid(*node).name();
+  for (const char* c = kind; *c; c++)
+    h = h * 31 + *c;
+
+  std::string name;
+  if (VariableNode* n = dynamic_cast<VariableNode*>(node)) {
+    name = n->identifier->name;
+  } else if (MemberAccessNode* n = dynamic_cast<MemberAccessNode*>(node)) {
+    name = n->identifier_1->name + "." + n->identifier_2->name;
+  } else {
+    int value;
+    if (isLiteral(node, &value))
+      h = h * 31 + value;
+  }
+  for (unsigned i = 0; i < name.size(); i++)
+    h = h * 31 + name[i];
+
+  std::vector<ExpressionNode**> slots = children(node);
+  for (std::vector<ExpressionNode**>::iterator it = slots.begin(); it != slots.end(); it++)
+    h = h * 31 + hash(**it);
+  return h;
+}
+
+Available* ValueNumbering::lookup(ExpressionNode* node) {
+  std::map<unsigned, std::vector<Available*> >::iterator bucket = buckets.find(hash(node));
+  if (bucket == buckets.end())
+    return NULL;
+  for (std::vector<Available*>::iterator it = bucket->second.begin(); it != bucket->second.end(); it++) {
+    if ((*it)->alive && sameExpression((*it)->expression, node, &definitions))
+      return *it;
+  }
+  return NULL;
+}
+
+void ValueNumbering::add(Available* entry, std::set<std::string>& locals, std::set<int>& offsets) {
+  entries.push_back(entry);
+  buckets[hash(entry->expression)].push_back(entry);
+  for (std::set<std::string>::iterator it = locals.begin(); it != locals.end(); it++)
+    byLocal[*it].push_back(entry);
+  for (std::set<int>::iterator it = offsets.begin(); it != offsets.end(); it++)
+    byOffset[*it].push_back(entry);
+  entry->alive = false;
+  setAlive(entry, true);
+}
+
+void ValueNumbering::setAlive(Available* entry, bool alive) {
+  if (entry->alive != alive) {
+    changes.push_back(std::make_pair(entry, entry->alive));
+    entry->alive = alive;
+  }
+}
+
+void ValueNumbering::undo(unsigned mark) {
+  while (changes.size() > mark) {
+    changes.back().first->alive = changes.back().second;
+    changes.pop_back();
+  }
+}
+
+void ValueNumbering::kill(EffectsCollector& code) {
+  for (std::set<std::string>::iterator name = code.assignedLocals.begin(); name != code.assignedLocals.end(); name++) {
+    std::vector<Available*>& readers = byLocal[*name];
+    for (std::vector<Available*>::iterator it = readers.begin(); it != readers.end(); it++)
+      setAlive(*it, false);
+  }
+  for (std::set<int>::iterator offset = code.effects.writes.begin(); offset != code.effects.writes.end(); offset++) {
+    std::vector<Available*>& readers = byOffset[*offset];
+    for (std::vector<Available*>::iterator it = readers.begin(); it != readers.end(); it++)
+      setAlive(*it, false);
+  }
+}
+
+// The new locals are named with a leading underscore, which the
+// lexer does not allow, so they cannot clash with program names.
+std::string ValueNumbering::useTemporary(Available* entry) {
+  if (entry->temporary.empty()) {
+    std::stringstream name;
+    name << "_cse" << nextTemporary++;
+    CompoundType type;
+    type.baseType = entry->expression->basetype;
+    type.objectClassName = entry->expression->objectClassName;
+    scope.addLocal(name.str(), type);
+
+    std::list<StatementNode*>::iterator position =
+      entry->statements->insert(entry->position, assignment(name.str(), entry->expression));
+    *entry->slot = variable(name.str(), type);
+    definitions[name.str()] = entry->expression;
+    entry->temporary = name.str();
+
+    // The expressions inside this one now run in the new assignment
+    for (std::vector<Available*>::iterator it = entry->inner.begin(); it != entry->inner.end(); it++)
+      moveInto(*it, entry->statements, position);
+  }
+  return entry->temporary;
+}
+
+void ValueNumbering::moveInto(Available* entry, std::list<StatementNode*>* statements,
+                              std::list<StatementNode*>::iterator position) {
+  entry->statements = statements;
+  entry->position = position;
+  for (std::vector<Available*>::iterator it = entry->inner.begin(); it != entry->inner.end(); it++)
+    moveInto(*it, statements, position);
+}
+
+// Numbers the expression in a slot, top down so that the largest
+// redundant expression is replaced. "statement" has the effects of
+// the code the expression is part of: an expression is only reused
+// or recorded if nothing in it can store to what the expression
+// reads (since the value is computed before the statement runs).
+// Recording an expression that may trap (and so moving it before
+// the statement) is only allowed if the statement calls nothing.
+void ValueNumbering::number(ExpressionNode** slot, Available* outer, std::list<StatementNode*>* statements,
+                            std::list<StatementNode*>::iterator position, bool record, EffectsCollector& statement) {
+  ExpressionNode* node = *slot;
+  if (isCandidate(node)) {
+    std::set<std::string> locals;
+    std::set<int> offsets;
+    reads(node, locals, offsets);
+    bool safe = true;
+    for (std::set<int>::iterator it = offsets.begin(); it != offsets.end(); it++) {
+      if (statement.effects.writes.count(*it))
+        safe = false;
+    }
+
+    if (safe) {
+      if (Available* entry = lookup(node)) {
+        CompoundType type;
+        type.baseType = node->basetype;
+        type.objectClassName = node->objectClassName;
+        *slot = variable(useTemporary(entry), type);
+        return;
+      }
+      if (record && (!canTrap(node) || statement.callees.empty())) {
+        Available* entry = new Available();
+        entry->expression = node;
+        entry->slot = slot;
+        entry->statements = statements;
+        entry->position = position;
+        add(entry, locals, offsets);
+        if (outer)
+          outer->inner.push_back(entry);
+        outer = entry;
+      }
+    }
+  }
+
+  std::vector<ExpressionNode**> slots = children(node);
+  for (std::vector<ExpressionNode**>::iterator it = slots.begin(); it != slots.end(); it++)
+    number(*it, outer, statements, position, record, statement);
+}
+
+void ValueNumbering::numberStatements(std::list<StatementNode*>* statements) {
+  if (!statements)
+    return;
+  for (std::list<StatementNode*>::iterator it = statements->begin(); it != statements->end(); it++) {
+    EffectsCollector own(&scope, &effects);
+    if (AssignmentNode* node = dynamic_cast<AssignmentNode*>(*it)) {
+      own.collect(node->expression);
+      number(&node->expression, NULL, statements, it, true, own);
+    } else if (CallNode* node = dynamic_cast<CallNode*>(*it)) {
+      own.collect(node->methodcall);
+      std::vector<ExpressionNode**> slots = children(node->methodcall);
+      for (std::vector<ExpressionNode**>::iterator slot = slots.begin(); slot != slots.end(); slot++)
+        number(*slot, NULL, statements, it, true, own);
+    } else if (PrintNode* node = dynamic_cast<PrintNode*>(*it)) {
+      own.collect(node->expression);
+      number(&node->expression, NULL, statements, it, true, own);
+    } else if (IfElseNode* node = dynamic_cast<IfElseNode*>(*it)) {
+      own.collect(node->expression);
+      number(&node->expression, NULL, statements, it, true, own);
+      unsigned mark = changes.size();
+      numberStatements(node->statement_list_1);
+      undo(mark);
+      numberStatements(node->statement_list_2);
+      undo(mark);
+    } else if (WhileNode* node = dynamic_cast<WhileNode*>(*it)) {
+      // The condition runs on every iteration, so nothing first
+      // computed there can be moved before the loop
+      EffectsCollector loop(&scope, &effects);
+      loop.collect(node->statement_list);
+      loop.collect(node->expression);
+      kill(loop);
+      own.collect(node->expression);
+      unsigned mark = changes.size();
+      number(&node->expression, NULL, statements, it, false, own);
+      numberStatements(node->statement_list);
+      undo(mark);
+    } else if (DoWhileNode* node = dynamic_cast<DoWhileNode*>(*it)) {
+      EffectsCollector loop(&scope, &effects);
+      loop.collect(node->statement_list);
+      loop.collect(node->expression);
+      kill(loop);
+      own.collect(node->expression);
+      unsigned mark = changes.size();
+      numberStatements(node->statement_list);
+      number(&node->expression, NULL, statements, it, false, own);
+      undo(mark);
+    }
+
+    EffectsCollector all(&scope, &effects);
+    (*it)->accept(&all);
+    kill(all);
+  }
+}
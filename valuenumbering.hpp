@@ -0,0 +1,76 @@
+#ifndef __VALUENUMBERING_HPP
+#define __VALUENUMBERING_HPP
+
+#include "passmanager.hpp"
+#include "analysis.hpp"
+
+// An expression that has been computed, and that is still known to
+// have the same value. The first time it is computed again, it is
+// moved into a new local (assigned right before the statement that
+// first computed it), and both places use the local instead.
+typedef struct available {
+  ExpressionNode* expression;
+  // Where the expression is: the slot holding it, and the statement
+  // it runs in (which is where the new local is assigned)
+  ExpressionNode** slot;
+  std::list<StatementNode*>* statements;
+  std::list<StatementNode*>::iterator position;
+  // The local holding the value, once it is used twice
+  std::string temporary;
+  bool alive;
+  // Available expressions inside this one
+  std::vector<struct available*> inner;
+} Available;
+
+// This pass removes redundant computations of pure expressions
+// (arithmetic, comparisons, boolean operators and member reads)
+// within a method, with a scoped hash table of the available
+// expressions. An expression computed before an if statement is
+// available in both branches, but what is computed in a branch is
+// forgotten after it, and an expression is only available in a loop
+// if nothing in the loop changes it.
+//
+// An expression stops being available once a local it reads is
+// assigned, or once anything (including a method that is called)
+// stores to a member at the same offset as a member it reads.
+class ValueNumbering : public Pass {
+private:
+  MethodScope scope;
+  EffectsTable effects;
+  int nextTemporary;
+
+  std::vector<Available*> entries;
+  std::map<unsigned, std::vector<Available*> > buckets;
+  // Available expressions by the locals and member offsets they read
+  std::map<std::string, std::vector<Available*> > byLocal;
+  std::map<int, std::vector<Available*> > byOffset;
+  // Changes to the "alive" flags, so that they can be undone when
+  // leaving a branch or a loop body
+  std::vector<std::pair<Available*, bool> > changes;
+  // The expression each new local holds
+  std::map<std::string, ExpressionNode*> definitions;
+
+  unsigned hash(ExpressionNode* node);
+  bool isCandidate(ExpressionNode* node);
+  void reads(ExpressionNode* node, std::set<std::string>& locals, std::set<int>& offsets);
+
+  Available* lookup(ExpressionNode* node);
+  void add(Available* entry, std::set<std::string>& locals, std::set<int>& offsets);
+  void setAlive(Available* entry, bool alive);
+  void undo(unsigned mark);
+  void kill(EffectsCollector& effects);
+  std::string useTemporary(Available* entry);
+  void moveInto(Available* entry, std::list<StatementNode*>* statements, std::list<StatementNode*>::iterator position);
+
+  void number(ExpressionNode** slot, Available* outer, std::list<StatementNode*>* statements,
+              std::list<StatementNode*>::iterator position, bool record, EffectsCollector& statement);
+  void numberStatements(std::list<StatementNode*>* statements);
+
+public:
+  ValueNumbering() : nextTemporary(0) {}
+
+  virtual std::string name() { return "gvn"; }
+  virtual void run(ProgramNode* program, ClassTable* classTable);
+};
+
+#endif